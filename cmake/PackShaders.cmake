@@ -0,0 +1,27 @@
+# compiles every shader in CoreShaders into one archive at build time, the
+# executables map it at startup instead of compiling at runtime
+set(FLARE_SHADER_ROOT ${CMAKE_SOURCE_DIR}/src/Flare/FlareGraphics)
+set(FLARE_SHADER_ARCHIVE ${CMAKE_BINARY_DIR}/CoreShaders.pack)
+
+function(add_shader_archive_target)
+    file(GLOB shader_sources CONFIGURE_DEPENDS ${FLARE_SHADER_ROOT}/CoreShaders/*)
+
+    add_custom_command(
+            OUTPUT ${FLARE_SHADER_ARCHIVE}
+            COMMAND $<TARGET_FILE:flare-shaderpack> ${FLARE_SHADER_ROOT} ${FLARE_SHADER_ARCHIVE} CoreShaders
+            DEPENDS flare-shaderpack ${shader_sources}
+            COMMENT "packing CoreShaders"
+    )
+    add_custom_target(flare-shader-archive ALL
+            DEPENDS ${FLARE_SHADER_ARCHIVE}
+    )
+endfunction(add_shader_archive_target)
+
+function(copy_shader_archive TargetName)
+    add_custom_command(TARGET ${TargetName} POST_BUILD
+            COMMAND ${CMAKE_COMMAND} -E copy_if_different
+            ${FLARE_SHADER_ARCHIVE}
+            $<TARGET_FILE_DIR:${TargetName}>
+    )
+    add_dependencies(${TargetName} flare-shader-archive)
+endfunction(copy_shader_archive)
@@ -14,6 +14,7 @@
 #include "FlareGraphics/Passes/ShadowPass.h"
 #include "FlareGraphics/Passes/SkyboxPass.h"
 #include "FlareGraphics/Passes/DrawBoundsPass.h"
+#include "FlareGraphics/RenderGraph.h"
 #include "imgui.h"
 
 using namespace Flare;
@@ -52,14 +53,19 @@ struct TriangleApp : Application {
     };
     cameraDataRingBuffer.init(&gpu, FRAMES_IN_FLIGHT, cameraCI);
 
-    shadowPass.init(&gpu);
+    shadowPass.init(&gpu, modelManager);
     frustumCullPass.init(&gpu);
     skyboxPass.init(&gpu);
-    skyboxPass.loadImage("assets/AllSkyFree_Sky_EpicBlueSunset_Equirect.png");
-    //        skyboxPass.loadImage("assets/free_hdri_sky_816.jpg");
-    gBufferPass.init(&gpu);
+    gBufferPass.init(&gpu, modelManager);
     lightingPass.init(&gpu);
     drawBoundsPass.init(&gpu);
+    // builds the pipelines of every pass above together
+    gpu.endPipelineBatch();
+
+    skyboxPass.loadImage("assets/AllSkyFree_Sky_EpicBlueSunset_Equirect.png");
+    //        skyboxPass.loadImage("assets/free_hdri_sky_816.jpg");
+
+    renderGraph.init(&gpu);
 
     glfwSetWindowUserPointer(window.glfwWindow, &camera);
     glfwSetCursorPosCallback(window.glfwWindow, Camera::mouseCallback);
@@ -72,14 +78,14 @@ struct TriangleApp : Application {
   void loop() override {
     while (!window.shouldClose()) {
       window.newFrame();
-      modelManager.newFrame();
 
       if (!window.isMinimized()) {
         if (window.shouldResize) {
           window.shouldResize = false;
 
           gpu.resizeSwapchain();
-          gBufferPass.generateRenderTargets();
+          // the draw texture was recreated, its image handle may be reused
+          renderGraph.resetStates();
         }
 
         camera.update();
@@ -88,22 +94,27 @@ struct TriangleApp : Application {
         gpu.newFrame();
         imgui.newFrame();
 
+        // after gpu.newFrame so the ring buffer slots written here are no
+        // longer in flight
+        modelManager.newFrame();
+
         glm::mat4 view = camera.getViewMatrix();
         glm::mat4 projection = camera.getProjectionMatrix();
 
         // light
         lightData.updateViewProjection();
-        gpu.uploadBufferData(lightDataRingBuffer.buffer(), &lightData);
+        gpu.queueBufferUpload(lightDataRingBuffer.buffer(), &lightData);
 
         // camera
         cameraData.setMatrices(view, projection);
-        gpu.uploadBufferData(cameraDataRingBuffer.buffer(), &cameraData);
+        gpu.queueBufferUpload(cameraDataRingBuffer.buffer(), &cameraData);
 
         // todo: frustum cull for shadows
         // shadows
         ShadowInputs shadowPassInputs = {
             .positionBuffer = modelManager.positionBufferHandle,
             .transformBuffer = modelManager.transformRingBuffer.buffer(),
+            .boundsBuffer = modelManager.boundsRingBuffer.buffer(),
             .lightBuffer = lightDataRingBuffer.buffer(),
 
             .indexBuffer = modelManager.indexBufferHandle,
@@ -131,13 +142,14 @@ struct TriangleApp : Application {
 
         Handle<Buffer> chosenIndirectDrawBufferHandle =
             modelManager.indirectDrawDataRingBuffer.buffer();
+        Handle<Buffer> chosenCountBufferHandle =
+            modelManager.countRingBuffer.buffer();
 
         FrustumCullInputs frustumCullInputs = {
             .viewProjection = projection * view,
             .inputIndirectDrawBuffer =
                 modelManager.indirectDrawDataRingBuffer.buffer(),
             .outputIndirectDrawBuffer = culledIndirectDrawRingBuffer.buffer(),
-            .countBuffer = modelManager.countRingBuffer.buffer(),
             .boundsBuffer = modelManager.boundsRingBuffer.buffer(),
             .transformBuffer = modelManager.transformRingBuffer.buffer(),
             .maxDrawCount = modelManager.count,
@@ -145,7 +157,19 @@ struct TriangleApp : Application {
         if (shouldFrustumCull) {
           chosenIndirectDrawBufferHandle =
               culledIndirectDrawRingBuffer.buffer();
+          chosenCountBufferHandle = frustumCullPass.countRingBuffer.buffer();
           frustumCullPass.setInputs(frustumCullInputs);
+
+          // culled on the compute queue, this overlaps the previous frame's
+          // rasterization since only its indirect draws wait on it
+          VkCommandBuffer computeCmd = gpu.getComputeCommandBuffer();
+          frustumCullPass.cull(computeCmd);
+          frustumCullPass.releaseOutputs(computeCmd);
+          if (gpu.tracyComputeContext) {
+            TracyVkCollect(gpu.tracyComputeContext, computeCmd);
+          }
+          vkEndCommandBuffer(computeCmd);
+          gpu.submitCompute();
         }
 
         // gbuffer
@@ -159,15 +183,158 @@ struct TriangleApp : Application {
                     .normals = modelManager.normalBufferHandle,
                     .tangents = modelManager.tangentBufferHandle,
                     .transforms = modelManager.transformRingBuffer.buffer(),
+                    .bounds = modelManager.boundsRingBuffer.buffer(),
                     .materials = modelManager.materialBufferHandle,
                     .textures = modelManager.textureIndexBufferHandle,
                     .indirectDraws = chosenIndirectDrawBufferHandle,
-                    .count = modelManager.countRingBuffer.buffer(),
+                    .count = chosenCountBufferHandle,
                     .drawCount = modelManager.count,
                 },
         };
         gBufferPass.setInputs(gBufferInputs);
 
+        DrawBoundsInputs drawBoundsInputs = {
+          .viewProjection = projection * view,
+          .boundsBuffer = modelManager.boundsRingBuffer.buffer(),
+          .transformBuffer = modelManager.transformRingBuffer.buffer(),
+          .count = modelManager.count,
+        };
+        drawBoundsPass.setInputs(drawBoundsInputs);
+
+        modelManager.drawImguiMenu();
+
+        ImGui::Begin("Options");
+
+        ImGui::Checkbox("Shadows", &shadowPass.enable);
+        ImGui::Checkbox("Frustum cull", &shouldFrustumCull);
+        ImGui::Checkbox("Fixed frustum", &frustumCullPass.fixedFrustum);
+        ImGui::Checkbox("Skybox", &shouldRenderSkybox);
+        ImGui::Checkbox("Bounds", &shouldDrawBounds);
+        ImGui::SliderFloat3("Light position",
+                            reinterpret_cast<float *>(&lightData.lightPos),
+                            -50.f, 50.f);
+        //                ImGui::SliderFloat("Light intensity",
+        //                reinterpret_cast<float *>(&globals.light.intensity),
+        //                0.f, 100.f);
+        ImGui::End();
+
+        gpu.profiler.drawImguiWindow();
+
+        ImGui::Render();
+
+        // passes declare what they read and write, the graph places the
+        // barriers between them and drops passes nothing consumes. they are
+        // recorded on the thread pool into secondary command buffers and
+        // executed in this order
+        renderGraph.reset();
+        gBufferPass.declareTargets(renderGraph);
+
+        Handle<RenderGraphResource> shadowMap = renderGraph.importTexture(
+            "shadow map", shadowPass.depthTextureHandle);
+        Handle<RenderGraphResource> drawTexture =
+            renderGraph.importTexture("draw texture", gpu.drawTexture);
+        Handle<RenderGraphResource> indirectDraws = renderGraph.importBuffer(
+            "indirect draws", chosenIndirectDrawBufferHandle);
+        // the acquire semaphore is waited on at color attachment output
+        Handle<RenderGraphResource> swapchainImage = renderGraph.importImage(
+            "swapchain", gpu.swapchainImages[gpu.swapchainImageIndex],
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+        // todo: separate frustum cull for shadows
+        // shadows
+        renderGraph
+            .addPass("shadow",
+                     [&](VkCommandBuffer passCmd) {
+                       shadowPass.render(passCmd);
+                     })
+            .write(shadowMap, RenderGraphAccess::eDepthAttachment);
+
+        // gbuffer pass, after acquiring the frustum cull outputs
+        renderGraph
+            .addPass("gbuffer",
+                     [&](VkCommandBuffer passCmd) {
+                       if (shouldFrustumCull) {
+                         frustumCullPass.acquireOutputs(passCmd);
+                       }
+                       gBufferPass.render(passCmd);
+                     })
+            .read(indirectDraws, RenderGraphAccess::eIndirectRead)
+            .write(gBufferPass.depthTarget,
+                   RenderGraphAccess::eDepthAttachment)
+            .write(gBufferPass.albedoTarget,
+                   RenderGraphAccess::eColorAttachment)
+            .write(gBufferPass.normalTarget,
+                   RenderGraphAccess::eColorAttachment)
+            .write(gBufferPass.occlusionMetallicRoughnessTarget,
+                   RenderGraphAccess::eColorAttachment)
+            .write(gBufferPass.emissiveTarget,
+                   RenderGraphAccess::eColorAttachment);
+
+        if (modelManager.count > 0) {
+          // lighting pass
+          renderGraph
+              .addPass("lighting",
+                       [&](VkCommandBuffer passCmd) {
+                         lightingPass.render(passCmd);
+                       })
+              .read(gBufferPass.albedoTarget,
+                    RenderGraphAccess::eFragmentSampled)
+              .read(gBufferPass.normalTarget,
+                    RenderGraphAccess::eFragmentSampled)
+              .read(gBufferPass.occlusionMetallicRoughnessTarget,
+                    RenderGraphAccess::eFragmentSampled)
+              .read(gBufferPass.emissiveTarget,
+                    RenderGraphAccess::eFragmentSampled)
+              .read(gBufferPass.depthTarget,
+                    RenderGraphAccess::eFragmentSampled)
+              .read(shadowMap, RenderGraphAccess::eFragmentSampled)
+              .write(drawTexture, RenderGraphAccess::eColorAttachment);
+        }
+
+        // skybox pass
+        if (shouldRenderSkybox) {
+          renderGraph
+              .addPass("skybox",
+                       [&](VkCommandBuffer passCmd) {
+                         skyboxPass.render(passCmd);
+                       })
+              .write(drawTexture, RenderGraphAccess::eColorAttachment)
+              .write(gBufferPass.depthTarget,
+                     RenderGraphAccess::eDepthAttachment);
+        }
+
+        if (shouldDrawBounds) {
+          renderGraph
+              .addPass("bounds",
+                       [&](VkCommandBuffer passCmd) {
+                         drawBoundsPass.render(passCmd);
+                       })
+              .write(drawTexture, RenderGraphAccess::eColorAttachment);
+        }
+
+        renderGraph
+            .addPass("imgui",
+                     [&](VkCommandBuffer passCmd) {
+                       gpu.profiler.beginScope(passCmd, "ImGui");
+                       imgui.draw(passCmd,
+                                  gpu.getTexture(gpu.drawTexture)->imageView);
+                       gpu.profiler.endScope(passCmd);
+                     })
+            .write(drawTexture, RenderGraphAccess::eColorAttachment);
+
+        renderGraph
+            .addPass("copy to swapchain",
+                     [&](VkCommandBuffer passCmd) {
+                       gpu.copyDrawTextureToSwapchain(passCmd);
+                     })
+            .read(drawTexture, RenderGraphAccess::eTransferSrc)
+            .write(swapchainImage, RenderGraphAccess::eTransferDst);
+
+        renderGraph.markOutput(swapchainImage, RenderGraphAccess::ePresent);
+
+        renderGraph.compile();
+        gBufferPass.resolveTargets(renderGraph);
+
         // lighting
         LightingPassInputs lightingPassInputs = {
             .drawTexture = gpu.drawTexture,
@@ -187,6 +354,8 @@ struct TriangleApp : Application {
             .irradianceMap = skyboxPass.irradianceMapHandle,
             .prefilteredCube = skyboxPass.prefilteredCubeHandle,
             .brdfLut = skyboxPass.brdfLutHandle,
+
+            .shadows = shadowPass.enable,
         };
         lightingPass.setInputs(lightingPassInputs);
 
@@ -198,86 +367,18 @@ struct TriangleApp : Application {
         };
         skyboxPass.setInputs(skyboxInputs);
 
-        DrawBoundsInputs drawBoundsInputs = {
-          .viewProjection = projection * view,
-          .boundsBuffer = modelManager.boundsRingBuffer.buffer(),
-          .transformBuffer = modelManager.transformRingBuffer.buffer(),
-          .count = modelManager.count,
-        };
-        drawBoundsPass.setInputs(drawBoundsInputs);
-
         VkCommandBuffer cmd = gpu.getCommandBuffer();
-        gpu.transitionDrawTextureToColorAttachment(cmd);
-
-        // todo: separate frustum cull for shadows
-        // shadows
-        shadowPass.render(cmd);
-
-        // frustum cull
-        if (shouldFrustumCull) {
-          // todo: implement compute queue, currently using the main queue
-          frustumCullPass.cull(cmd);
-          frustumCullPass.addBarriers(cmd, gpu.mainFamily, gpu.mainFamily);
-        }
-
-        // gbuffer pass
-        gBufferPass.render(cmd);
-
-        if (modelManager.count > 0) {
-          // lighting pass
-          lightingPass.render(cmd);
-        }
-
-        // skybox pass
-        if (shouldRenderSkybox) {
-          skyboxPass.render(cmd);
-        }
-
-        if (shouldDrawBounds) {
-          drawBoundsPass.render(cmd);
-        }
-
-        modelManager.drawImguiMenu();
-
-        ImGui::Begin("Options");
-
-        ImGui::Checkbox("Shadows", &shadowPass.enable);
-        ImGui::Checkbox("Frustum cull", &shouldFrustumCull);
-        ImGui::Checkbox("Fixed frustum", &frustumCullPass.fixedFrustum);
-        ImGui::Checkbox("Skybox", &shouldRenderSkybox);
-        ImGui::Checkbox("Bounds", &shouldDrawBounds);
-        ImGui::SliderFloat3("Light position",
-                            reinterpret_cast<float *>(&lightData.lightPos),
-                            -50.f, 50.f);
-        //                ImGui::SliderFloat("Light intensity",
-        //                reinterpret_cast<float *>(&globals.light.intensity),
-        //                0.f, 100.f);
-        if (ImGui::Button("Reload pipeline")) {
-          shouldReloadPipeline = true;
-        }
-        ImGui::End();
-
-        ImGui::Render();
-        imgui.draw(cmd, gpu.getTexture(gpu.drawTexture)->imageView);
-
-        gpu.transitionDrawTextureToTransferSrc(cmd);
-        gpu.transitionSwapchainTextureToTransferDst(cmd);
-        gpu.copyDrawTextureToSwapchain(cmd);
-        gpu.transitionSwapchainTextureToPresentSrc(cmd);
+        renderGraph.execute(cmd);
 
+        TracyVkCollect(gpu.tracyMainContext, cmd);
         vkEndCommandBuffer(cmd);
 
         culledIndirectDrawRingBuffer.moveToNextBuffer();
+        frustumCullPass.countRingBuffer.moveToNextBuffer();
         lightDataRingBuffer.moveToNextBuffer();
         cameraDataRingBuffer.moveToNextBuffer();
 
         gpu.present();
-
-        if (shouldReloadPipeline) {
-          gpu.recreatePipeline(lightingPass.pipelineHandle,
-                               lightingPass.pipelineCI);
-          shouldReloadPipeline = false;
-        }
       }
     }
   }
@@ -295,6 +396,8 @@ struct TriangleApp : Application {
     lightingPass.shutdown();
     drawBoundsPass.shutdown();
 
+    renderGraph.shutdown();
+
     imgui.shutdown();
 
     lightDataRingBuffer.shutdown();
@@ -307,7 +410,6 @@ struct TriangleApp : Application {
   Flare::GpuDevice gpu;
   Flare::Window window;
 
-  bool shouldReloadPipeline = false;
   bool shouldFrustumCull = true;
   bool shouldRenderSkybox = true;
   bool shouldDrawBounds = false;
@@ -332,6 +434,8 @@ struct TriangleApp : Application {
   GBufferPass gBufferPass;
   LightingPass lightingPass;
   DrawBoundsPass drawBoundsPass;
+
+  RenderGraph renderGraph;
 };
 
 int main() {
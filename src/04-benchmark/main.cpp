@@ -0,0 +1,653 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "FlareApp/Application.h"
+#include "FlareApp/Camera.h"
+#include "FlareGraphics/GltfScene.h"
+#include "FlareGraphics/GpuDevice.h"
+#include "FlareGraphics/LightData.h"
+#include "FlareGraphics/ModelManager.h"
+#include "FlareGraphics/Passes/FrustumCullPass.h"
+#include "FlareGraphics/Passes/GBufferPass.h"
+#include "FlareGraphics/Passes/LightingPass.h"
+#include "FlareGraphics/Passes/ShadowPass.h"
+#include "FlareGraphics/Passes/SkyboxPass.h"
+#include "FlareGraphics/RenderGraph.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Flare;
+
+// renders a fixed number of frames without a window and writes the timings
+// to json, everything depends on the frame index only so runs are comparable
+struct BenchmarkConfig {
+  std::vector<std::filesystem::path> prefabPaths;
+  uint32_t instanceCount = 100;
+  float spacing = 10.f;
+  uint32_t frameCount = 500;
+  // rendered before the recorded frames to warm up caches and allocations
+  uint32_t warmupFrameCount = 16;
+  bool frustumCull = true;
+  // uploads QuantizedVertices and decodes them in the passes
+  bool quantizedVertices = false;
+  // keyframes of "x y z pitch yaw" per line, orbits the grid if empty
+  std::filesystem::path cameraPathFile;
+  std::filesystem::path outputPath = "benchmark.json";
+};
+
+struct CameraKeyframe {
+  glm::vec3 position;
+  float pitch;
+  float yaw;
+};
+
+struct FrameRecord {
+  double cpuMs = 0.0;
+  uint32_t drawCount = 0;
+  int64_t visibleCount = -1;
+  bool culled = false;
+  std::vector<GpuScopeTiming> gpuScopes;
+};
+
+static std::string escapeJson(const std::string &str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(c);
+  }
+  return escaped;
+}
+
+struct BenchmarkApp : Application {
+  void init(const ApplicationConfig &appConfig) override {
+    GpuDeviceCreateInfo gpuDeviceCI{
+        .headless = true,
+        .headlessExtent = {appConfig.width, appConfig.height},
+        .shaderHotReload = false,
+    };
+
+    gpu.init(gpuDeviceCI);
+
+    modelManager.quantizedVertices = config.quantizedVertices;
+
+    modelManager.init(&gpu, config.prefabPaths.size(), config.instanceCount);
+    culledIndirectDrawRingBuffer.init(&gpu, FRAMES_IN_FLIGHT);
+
+    BufferCI lightCI = {
+        .size = sizeof(LightData),
+        .usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .name = "lightData",
+        .bufferType = BufferType::eUniform,
+    };
+    lightDataRingBuffer.init(&gpu, FRAMES_IN_FLIGHT, lightCI);
+
+    BufferCI cameraCI = {
+        .size = sizeof(CameraData),
+        .usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .name = "camera",
+        .bufferType = BufferType::eUniform,
+    };
+    cameraDataRingBuffer.init(&gpu, FRAMES_IN_FLIGHT, cameraCI);
+
+    shadowPass.init(&gpu, modelManager);
+    frustumCullPass.init(&gpu);
+    skyboxPass.init(&gpu);
+    gBufferPass.init(&gpu, modelManager);
+    lightingPass.init(&gpu);
+    // builds the pipelines of every pass above together
+    gpu.endPipelineBatch();
+
+    skyboxPass.loadImage("assets/free_hdri_sky_816.jpg");
+
+    renderGraph.init(&gpu);
+
+    camera.setAspectRatio(static_cast<float>(appConfig.width) /
+                          static_cast<float>(appConfig.height));
+
+    spawnInstances();
+    loadCameraPath();
+  }
+
+  void spawnInstances() {
+    std::vector<Handle<ModelPrefab>> prefabs;
+    for (const auto &path : config.prefabPaths) {
+      Handle<ModelPrefab> prefab = modelManager.loadPrefab(path);
+      if (prefab.isValid()) {
+        prefabs.push_back(prefab);
+      }
+    }
+    if (prefabs.empty()) {
+      spdlog::error("Benchmark: No prefabs loaded");
+      return;
+    }
+
+    // textures stream in asynchronously, wait so warmup and recorded frames
+    // sample the final images
+    gpu.asyncLoader.flush();
+
+    gridSize = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<float>(config.instanceCount))));
+    for (uint32_t i = 0; i < config.instanceCount; i++) {
+      Handle<ModelInstance> handle =
+          modelManager.addInstance(prefabs[i % prefabs.size()]);
+      ModelInstance *instance = modelManager.getInstance(handle);
+      if (!instance) {
+        break;
+      }
+      instance->translation = {
+          static_cast<float>(i % gridSize) * config.spacing, 0.f,
+          static_cast<float>(i / gridSize) * config.spacing};
+    }
+  }
+
+  void loadCameraPath() {
+    if (config.cameraPathFile.empty()) {
+      return;
+    }
+
+    std::ifstream file(config.cameraPathFile);
+    if (!file.is_open()) {
+      spdlog::error("Benchmark: Failed to open camera path {}",
+                    config.cameraPathFile.string());
+      return;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      std::istringstream stream(line);
+      CameraKeyframe keyframe;
+      if (stream >> keyframe.position.x >> keyframe.position.y >>
+          keyframe.position.z >> keyframe.pitch >> keyframe.yaw) {
+        cameraPath.push_back(keyframe);
+      }
+    }
+    spdlog::info("Benchmark: Loaded {} camera keyframes", cameraPath.size());
+  }
+
+  // keyframes are spread evenly over the recorded frames, without any the
+  // camera orbits the grid once while looking at its center
+  void placeCamera(uint32_t frame) {
+    float t = static_cast<float>(frame) /
+              static_cast<float>(std::max(config.frameCount, 1u));
+
+    if (cameraPath.size() == 1) {
+      camera.position = cameraPath[0].position;
+      camera.pitch = cameraPath[0].pitch;
+      camera.yaw = cameraPath[0].yaw;
+      return;
+    }
+
+    if (!cameraPath.empty()) {
+      float position = std::min(t, 1.f) * (cameraPath.size() - 1);
+      size_t index = std::min(static_cast<size_t>(position),
+                              cameraPath.size() - 2);
+      float alpha = position - static_cast<float>(index);
+      const CameraKeyframe &a = cameraPath[index];
+      const CameraKeyframe &b = cameraPath[index + 1];
+      camera.position = glm::mix(a.position, b.position, alpha);
+      camera.pitch = glm::mix(a.pitch, b.pitch, alpha);
+      camera.yaw = glm::mix(a.yaw, b.yaw, alpha);
+      return;
+    }
+
+    float extent = static_cast<float>(gridSize - 1) * config.spacing;
+    glm::vec3 center = {extent * 0.5f, 0.f, extent * 0.5f};
+    float radius = std::max(extent * 0.75f, 10.f);
+    float angle = t * 2.f * glm::pi<float>();
+
+    camera.position = center + glm::vec3(radius * std::cos(angle),
+                                         radius * 0.5f,
+                                         radius * std::sin(angle));
+    glm::vec3 direction = glm::normalize(center - camera.position);
+    camera.pitch = std::asin(direction.y);
+    camera.yaw = std::atan2(direction.x, -direction.z);
+  }
+
+  void loop() override {
+    uint32_t totalFrames = config.warmupFrameCount + config.frameCount;
+    frameRecords.resize(totalFrames);
+
+    // the last frames in flight only exist to read back the recorded ones
+    for (uint32_t frame = 0; frame < totalFrames + FRAMES_IN_FLIGHT; frame++) {
+      auto frameStart = std::chrono::steady_clock::now();
+
+      uint32_t pathFrame = frame > config.warmupFrameCount
+                               ? frame - config.warmupFrameCount
+                               : 0;
+      placeCamera(pathFrame);
+
+      gpu.newFrame();
+      readBackResults();
+
+      modelManager.newFrame();
+
+      glm::mat4 view = camera.getViewMatrix();
+      glm::mat4 projection = camera.getProjectionMatrix();
+
+      lightData.updateViewProjection();
+      gpu.queueBufferUpload(lightDataRingBuffer.buffer(), &lightData);
+
+      cameraData.setMatrices(view, projection);
+      gpu.queueBufferUpload(cameraDataRingBuffer.buffer(), &cameraData);
+
+      ShadowInputs shadowPassInputs = {
+          .positionBuffer = modelManager.positionBufferHandle,
+          .transformBuffer = modelManager.transformRingBuffer.buffer(),
+          .boundsBuffer = modelManager.boundsRingBuffer.buffer(),
+          .lightBuffer = lightDataRingBuffer.buffer(),
+
+          .indexBuffer = modelManager.indexBufferHandle,
+          .indirectDrawBuffer = modelManager.indirectDrawDataRingBuffer.buffer(),
+          .countBuffer = modelManager.countRingBuffer.buffer(),
+          .maxDrawCount = modelManager.count,
+      };
+      shadowPass.setInputs(shadowPassInputs);
+
+      if (modelManager.shouldDraw() &&
+          (!culledIndirectDrawRingBuffer.buffer().isValid() ||
+           gpu.getBuffer(culledIndirectDrawRingBuffer.buffer())->size <
+               gpu.getBuffer(modelManager.indirectDrawDataRingBuffer.buffer())
+                   ->size)) {
+        BufferCI indirectDrawsCI = {
+            .size = sizeof(IndirectDrawData) * modelManager.count,
+            .usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                          VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            .name = "culled indirect draws",
+        };
+        culledIndirectDrawRingBuffer.createBuffer(indirectDrawsCI);
+      }
+
+      Handle<Buffer> chosenIndirectDrawBufferHandle =
+          modelManager.indirectDrawDataRingBuffer.buffer();
+      Handle<Buffer> chosenCountBufferHandle =
+          modelManager.countRingBuffer.buffer();
+
+      bool culled = config.frustumCull && modelManager.shouldDraw();
+      if (culled) {
+        FrustumCullInputs frustumCullInputs = {
+            .viewProjection = projection * view,
+            .inputIndirectDrawBuffer =
+                modelManager.indirectDrawDataRingBuffer.buffer(),
+            .outputIndirectDrawBuffer = culledIndirectDrawRingBuffer.buffer(),
+            .boundsBuffer = modelManager.boundsRingBuffer.buffer(),
+            .transformBuffer = modelManager.transformRingBuffer.buffer(),
+            .maxDrawCount = modelManager.count,
+        };
+        chosenIndirectDrawBufferHandle = culledIndirectDrawRingBuffer.buffer();
+        chosenCountBufferHandle = frustumCullPass.countRingBuffer.buffer();
+        frustumCullPass.setInputs(frustumCullInputs);
+
+        VkCommandBuffer computeCmd = gpu.getComputeCommandBuffer();
+        frustumCullPass.cull(computeCmd);
+        frustumCullPass.releaseOutputs(computeCmd);
+        if (gpu.tracyComputeContext) {
+          TracyVkCollect(gpu.tracyComputeContext, computeCmd);
+        }
+        vkEndCommandBuffer(computeCmd);
+        gpu.submitCompute();
+      }
+
+      GBufferInputs gBufferInputs = {
+          .viewProjection = projection * view,
+          .meshDrawBuffers =
+              {
+                  .indices = modelManager.indexBufferHandle,
+                  .positions = modelManager.positionBufferHandle,
+                  .uvs = modelManager.uvBufferHandle,
+                  .normals = modelManager.normalBufferHandle,
+                  .tangents = modelManager.tangentBufferHandle,
+                  .transforms = modelManager.transformRingBuffer.buffer(),
+                  .bounds = modelManager.boundsRingBuffer.buffer(),
+                  .materials = modelManager.materialBufferHandle,
+                  .textures = modelManager.textureIndexBufferHandle,
+                  .indirectDraws = chosenIndirectDrawBufferHandle,
+                  .count = chosenCountBufferHandle,
+                  .drawCount = modelManager.count,
+              },
+      };
+      gBufferPass.setInputs(gBufferInputs);
+
+      renderGraph.reset();
+      gBufferPass.declareTargets(renderGraph);
+
+      Handle<RenderGraphResource> shadowMap = renderGraph.importTexture(
+          "shadow map", shadowPass.depthTextureHandle);
+      Handle<RenderGraphResource> drawTexture =
+          renderGraph.importTexture("draw texture", gpu.drawTexture);
+      Handle<RenderGraphResource> indirectDraws = renderGraph.importBuffer(
+          "indirect draws", chosenIndirectDrawBufferHandle);
+
+      renderGraph
+          .addPass("shadow",
+                   [&](VkCommandBuffer passCmd) {
+                     shadowPass.render(passCmd);
+                   })
+          .write(shadowMap, RenderGraphAccess::eDepthAttachment);
+
+      renderGraph
+          .addPass("gbuffer",
+                   [&](VkCommandBuffer passCmd) {
+                     if (culled) {
+                       frustumCullPass.acquireOutputs(passCmd);
+                     }
+                     gBufferPass.render(passCmd);
+                   })
+          .read(indirectDraws, RenderGraphAccess::eIndirectRead)
+          .write(gBufferPass.depthTarget, RenderGraphAccess::eDepthAttachment)
+          .write(gBufferPass.albedoTarget, RenderGraphAccess::eColorAttachment)
+          .write(gBufferPass.normalTarget, RenderGraphAccess::eColorAttachment)
+          .write(gBufferPass.occlusionMetallicRoughnessTarget,
+                 RenderGraphAccess::eColorAttachment)
+          .write(gBufferPass.emissiveTarget,
+                 RenderGraphAccess::eColorAttachment);
+
+      if (modelManager.count > 0) {
+        renderGraph
+            .addPass("lighting",
+                     [&](VkCommandBuffer passCmd) {
+                       lightingPass.render(passCmd);
+                     })
+            .read(gBufferPass.albedoTarget,
+                  RenderGraphAccess::eFragmentSampled)
+            .read(gBufferPass.normalTarget,
+                  RenderGraphAccess::eFragmentSampled)
+            .read(gBufferPass.occlusionMetallicRoughnessTarget,
+                  RenderGraphAccess::eFragmentSampled)
+            .read(gBufferPass.emissiveTarget,
+                  RenderGraphAccess::eFragmentSampled)
+            .read(gBufferPass.depthTarget, RenderGraphAccess::eFragmentSampled)
+            .read(shadowMap, RenderGraphAccess::eFragmentSampled)
+            .write(drawTexture, RenderGraphAccess::eColorAttachment);
+      }
+
+      renderGraph
+          .addPass("skybox",
+                   [&](VkCommandBuffer passCmd) {
+                     skyboxPass.render(passCmd);
+                   })
+          .write(drawTexture, RenderGraphAccess::eColorAttachment)
+          .write(gBufferPass.depthTarget, RenderGraphAccess::eDepthAttachment);
+
+      renderGraph.markOutput(drawTexture);
+
+      renderGraph.compile();
+      gBufferPass.resolveTargets(renderGraph);
+
+      LightingPassInputs lightingPassInputs = {
+          .drawTexture = gpu.drawTexture,
+          .cameraBuffer = cameraDataRingBuffer.buffer(),
+          .lightBuffer = lightDataRingBuffer.buffer(),
+
+          .gBufferAlbedo = gBufferPass.albedoTargetHandle,
+          .gBufferNormal = gBufferPass.normalTargetHandle,
+          .gBufferOcclusionMetallicRoughness =
+              gBufferPass.occlusionMetallicRoughnessTargetHandle,
+          .gBufferEmissive = gBufferPass.emissiveTargetHandle,
+          .gBufferDepth = gBufferPass.depthTargetHandle,
+
+          .shadowMap = shadowPass.depthTextureHandle,
+          .shadowSampler = shadowPass.samplerHandle,
+
+          .irradianceMap = skyboxPass.irradianceMapHandle,
+          .prefilteredCube = skyboxPass.prefilteredCubeHandle,
+          .brdfLut = skyboxPass.brdfLutHandle,
+      };
+      lightingPass.setInputs(lightingPassInputs);
+
+      SkyboxInputs skyboxInputs = {
+          .projection = projection,
+          .view = view,
+          .colorAttachment = gpu.drawTexture,
+          .depthAttachment = gBufferPass.depthTargetHandle,
+      };
+      skyboxPass.setInputs(skyboxInputs);
+
+      VkCommandBuffer cmd = gpu.getCommandBuffer();
+      renderGraph.execute(cmd);
+
+      TracyVkCollect(gpu.tracyMainContext, cmd);
+      vkEndCommandBuffer(cmd);
+
+      culledIndirectDrawRingBuffer.moveToNextBuffer();
+      frustumCullPass.countRingBuffer.moveToNextBuffer();
+      lightDataRingBuffer.moveToNextBuffer();
+      cameraDataRingBuffer.moveToNextBuffer();
+
+      gpu.present();
+
+      auto frameEnd = std::chrono::steady_clock::now();
+      if (frame < totalFrames) {
+        FrameRecord &record = frameRecords[frame];
+        record.cpuMs =
+            std::chrono::duration<double, std::milli>(frameEnd - frameStart)
+                .count();
+        record.drawCount = modelManager.count;
+        record.culled = culled;
+      }
+    }
+
+    writeResults();
+  }
+
+  // after the timeline wait in newFrame, the frame that last used the
+  // current slot has completed and its timestamps and count are readable
+  void readBackResults() {
+    if (gpu.profiler.resolvedFrame < frameRecords.size()) {
+      frameRecords[gpu.profiler.resolvedFrame].gpuScopes =
+          gpu.profiler.resolvedScopes;
+    }
+
+    if (gpu.absoluteFrame < FRAMES_IN_FLIGHT) {
+      return;
+    }
+    uint64_t completedFrame = gpu.absoluteFrame - FRAMES_IN_FLIGHT;
+    if (completedFrame >= frameRecords.size() ||
+        !frameRecords[completedFrame].culled) {
+      return;
+    }
+
+    // the cull's count ring advances once per frame, its current slot was
+    // last written by the completed frame
+    Buffer *countBuffer =
+        gpu.getBuffer(frustumCullPass.countRingBuffer.buffer());
+    vmaInvalidateAllocation(gpu.allocator, countBuffer->allocation, 0,
+                            sizeof(uint32_t));
+    frameRecords[completedFrame].visibleCount =
+        *static_cast<uint32_t *>(countBuffer->allocationInfo.pMappedData);
+  }
+
+  void writeResults() {
+    std::ofstream file(config.outputPath, std::ios::trunc);
+    if (!file.is_open()) {
+      spdlog::error("Benchmark: Failed to open {}",
+                    config.outputPath.string());
+      return;
+    }
+
+    double cpuMsTotal = 0.0;
+    std::map<std::string, std::pair<double, uint32_t>> gpuTotals;
+    for (uint32_t i = config.warmupFrameCount; i < frameRecords.size(); i++) {
+      cpuMsTotal += frameRecords[i].cpuMs;
+      for (const auto &scope : frameRecords[i].gpuScopes) {
+        auto &[total, count] = gpuTotals[scope.name];
+        total += scope.ms;
+        count++;
+      }
+    }
+
+    file << "{\n";
+    file << "  \"device\": \""
+         << escapeJson(gpu.physicalDeviceProperties.deviceName) << "\",\n";
+    file << "  \"width\": " << gpu.swapchainExtent.width << ",\n";
+    file << "  \"height\": " << gpu.swapchainExtent.height << ",\n";
+    file << "  \"instances\": " << modelManager.loadedInstances.size()
+         << ",\n";
+    file << "  \"prefabs\": [";
+    for (size_t i = 0; i < config.prefabPaths.size(); i++) {
+      file << (i ? ", " : "") << "\""
+           << escapeJson(config.prefabPaths[i].string()) << "\"";
+    }
+    file << "],\n";
+    file << "  \"frustumCull\": " << (config.frustumCull ? "true" : "false")
+         << ",\n";
+    file << "  \"quantizedVertices\": "
+         << (config.quantizedVertices ? "true" : "false") << ",\n";
+    file << "  \"warmupFrames\": " << config.warmupFrameCount << ",\n";
+    file << "  \"frames\": " << config.frameCount << ",\n";
+
+    file << "  \"summary\": {\n";
+    file << "    \"cpuMsAvg\": "
+         << cpuMsTotal / std::max(config.frameCount, 1u) << ",\n";
+    file << "    \"gpuMsAvg\": {";
+    bool first = true;
+    for (const auto &[name, totals] : gpuTotals) {
+      file << (first ? "" : ", ") << "\"" << escapeJson(name)
+           << "\": " << totals.first / totals.second;
+      first = false;
+    }
+    file << "}\n";
+    file << "  },\n";
+
+    file << "  \"perFrame\": [\n";
+    for (uint32_t i = config.warmupFrameCount; i < frameRecords.size(); i++) {
+      const FrameRecord &record = frameRecords[i];
+      file << "    {\"frame\": " << i - config.warmupFrameCount
+           << ", \"cpuMs\": " << record.cpuMs
+           << ", \"drawCount\": " << record.drawCount
+           << ", \"visibleCount\": " << record.visibleCount
+           << ", \"gpuMs\": {";
+      for (size_t j = 0; j < record.gpuScopes.size(); j++) {
+        file << (j ? ", " : "") << "\""
+             << escapeJson(record.gpuScopes[j].name)
+             << "\": " << record.gpuScopes[j].ms;
+      }
+      file << "}}" << (i + 1 < frameRecords.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n";
+    file << "}\n";
+
+    spdlog::info("Benchmark: Wrote {} frames to {}", config.frameCount,
+                 config.outputPath.string());
+  }
+
+  void shutdown() override {
+    vkDeviceWaitIdle(gpu.device);
+
+    modelManager.shutdown();
+    culledIndirectDrawRingBuffer.shutdown();
+
+    shadowPass.shutdown();
+    frustumCullPass.shutdown();
+    skyboxPass.shutdown();
+    gBufferPass.shutdown();
+    lightingPass.shutdown();
+
+    renderGraph.shutdown();
+
+    lightDataRingBuffer.shutdown();
+    cameraDataRingBuffer.shutdown();
+
+    gpu.shutdown();
+  }
+
+  BenchmarkConfig config;
+
+  Flare::GpuDevice gpu;
+
+  LightData lightData;
+  RingBuffer lightDataRingBuffer;
+
+  CameraData cameraData;
+  RingBuffer cameraDataRingBuffer;
+
+  ModelManager modelManager;
+
+  RingBuffer culledIndirectDrawRingBuffer;
+
+  Camera camera;
+  uint32_t gridSize = 1;
+  std::vector<CameraKeyframe> cameraPath;
+
+  ShadowPass shadowPass;
+  FrustumCullPass frustumCullPass;
+  SkyboxPass skyboxPass;
+  GBufferPass gBufferPass;
+  LightingPass lightingPass;
+
+  RenderGraph renderGraph;
+
+  std::vector<FrameRecord> frameRecords;
+};
+
+static void printUsage() {
+  spdlog::info("usage: flare-benchmark [options] [prefab.gltf ...]\n"
+               "  --instances N     instances spawned in a grid (100)\n"
+               "  --spacing F       grid spacing (10)\n"
+               "  --frames N        recorded frames (500)\n"
+               "  --warmup N        frames rendered before recording (16)\n"
+               "  --width N         render width (1280)\n"
+               "  --height N        render height (720)\n"
+               "  --camera-path F   keyframes of \"x y z pitch yaw\" per line\n"
+               "  --no-cull         disable frustum culling\n"
+               "  --quantize        use the quantized vertex format\n"
+               "  --output F        json output (benchmark.json)");
+}
+
+int main(int argc, char **argv) {
+  Flare::ApplicationConfig appConfig{};
+  appConfig.setWidth(1280).setHeight(720).setName("Benchmark");
+
+  BenchmarkApp app;
+  BenchmarkConfig &config = app.config;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (arg == "--instances" && hasValue) {
+      config.instanceCount = std::stoul(argv[++i]);
+    } else if (arg == "--spacing" && hasValue) {
+      config.spacing = std::stof(argv[++i]);
+    } else if (arg == "--frames" && hasValue) {
+      config.frameCount = std::stoul(argv[++i]);
+    } else if (arg == "--warmup" && hasValue) {
+      config.warmupFrameCount = std::stoul(argv[++i]);
+    } else if (arg == "--width" && hasValue) {
+      appConfig.setWidth(std::stoul(argv[++i]));
+    } else if (arg == "--height" && hasValue) {
+      appConfig.setHeight(std::stoul(argv[++i]));
+    } else if (arg == "--camera-path" && hasValue) {
+      config.cameraPathFile = argv[++i];
+    } else if (arg == "--no-cull") {
+      config.frustumCull = false;
+    } else if (arg == "--quantize") {
+      config.quantizedVertices = true;
+    } else if (arg == "--output" && hasValue) {
+      config.outputPath = argv[++i];
+    } else if (arg.starts_with("--")) {
+      printUsage();
+      return 1;
+    } else {
+      config.prefabPaths.emplace_back(arg);
+    }
+  }
+
+  if (config.prefabPaths.empty()) {
+    config.prefabPaths.emplace_back("assets/CesiumMilkTruck.gltf");
+  }
+
+  app.run(appConfig);
+}
@@ -0,0 +1,413 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FlareGraphics/CalcTangent.h"
+#include "FlareGraphics/CookedMesh.h"
+#include "FlareGraphics/GltfScene.h"
+#include "FlareGraphics/GpuDevice.h"
+#include "FlareGraphics/ModelManager.h"
+#include "FlareGraphics/Passes/FrustumCullPass.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+using namespace Flare;
+
+// counts allocations made through operator new while a benchmark body runs,
+// malloc calls from c libraries (cgltf, stb) are not included
+static std::atomic<bool> countAllocations = false;
+static std::atomic<uint64_t> allocationCount = 0;
+static std::atomic<uint64_t> allocationBytes = 0;
+
+void *operator new(std::size_t size) {
+  if (countAllocations.load(std::memory_order_relaxed)) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  void *ptr = std::malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+// keeps results of otherwise unused calls alive
+static volatile float sink;
+
+struct Microbench {
+  // setup and teardown run around every iteration and are not measured, the
+  // first warmupIterations are run but not recorded
+  void run(const std::string &name, uint64_t opsPerIteration,
+           const std::function<void()> &setup,
+           const std::function<void()> &body,
+           const std::function<void()> &teardown = {}) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) {
+      return;
+    }
+
+    uint64_t iterations = 0;
+    double elapsedNs = 0.0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+
+    for (uint32_t i = 0; i < warmupIterations; i++) {
+      if (setup) {
+        setup();
+      }
+      body();
+      if (teardown) {
+        teardown();
+      }
+    }
+
+    while (iterations < minIterations || elapsedNs < minSeconds * 1e9) {
+      if (setup) {
+        setup();
+      }
+
+      allocationCount = 0;
+      allocationBytes = 0;
+      countAllocations = true;
+      auto start = std::chrono::steady_clock::now();
+
+      body();
+
+      auto end = std::chrono::steady_clock::now();
+      countAllocations = false;
+
+      elapsedNs += std::chrono::duration<double, std::nano>(end - start).count();
+      allocations += allocationCount;
+      bytes += allocationBytes;
+      iterations++;
+
+      if (teardown) {
+        teardown();
+      }
+    }
+
+    double ops = static_cast<double>(iterations * opsPerIteration);
+    std::printf("%-48s %10llu %14.1f %12.1f %14.1f\n", name.c_str(),
+                static_cast<unsigned long long>(iterations), elapsedNs / ops,
+                allocations / ops, bytes / ops);
+    std::fflush(stdout);
+  }
+
+  std::string filter;
+  double minSeconds = 0.5;
+  uint64_t minIterations = 3;
+  uint32_t warmupIterations = 2;
+};
+
+// a flat grid of (n + 1)^2 vertices and 2n^2 triangles
+static void generateGrid(uint32_t n, std::vector<uint32_t> &indices,
+                         std::vector<glm::vec4> &positions,
+                         std::vector<glm::vec4> &normals,
+                         std::vector<glm::vec2> &uvs) {
+  uint32_t rowSize = n + 1;
+  positions.reserve(rowSize * rowSize);
+  normals.reserve(rowSize * rowSize);
+  uvs.reserve(rowSize * rowSize);
+  for (uint32_t z = 0; z < rowSize; z++) {
+    for (uint32_t x = 0; x < rowSize; x++) {
+      glm::vec2 uv = glm::vec2(x, z) / static_cast<float>(n);
+      positions.emplace_back(uv.x, 0.f, uv.y, 1.f);
+      normals.emplace_back(0.f, 1.f, 0.f, 0.f);
+      uvs.push_back(uv);
+    }
+  }
+
+  indices.reserve(n * n * 6);
+  for (uint32_t z = 0; z < n; z++) {
+    for (uint32_t x = 0; x < n; x++) {
+      uint32_t i = z * rowSize + x;
+      indices.insert(indices.end(), {i, i + rowSize, i + 1, i + 1,
+                                     i + rowSize, i + rowSize + 1});
+    }
+  }
+}
+
+static void benchGltfSceneInit(Microbench &bench, GpuDevice &gpu) {
+  for (const char *name : {"CesiumMilkTruck", "BoxTextured"}) {
+    std::filesystem::path path =
+        std::filesystem::path("assets") / (std::string(name) + ".gltf");
+
+    // the same scene cooked, loading it skips parsing and tangent generation
+    std::filesystem::path cookedPath =
+        std::filesystem::path(path).replace_extension(COOKED_MESH_EXTENSION);
+    GltfScene cookScene;
+    if (cookScene.loadGltf(path, &gpu.threadPool)) {
+      writeCookedMesh(cookScene, cookedPath);
+    }
+    cookScene.shutdown();
+
+    for (const auto &scenePath : {path, cookedPath}) {
+      GltfScene scene;
+      bench.run(
+          "GltfScene::init/" + std::string(name) +
+              (scenePath == cookedPath ? COOKED_MESH_EXTENSION : ""),
+          1, {},
+          [&] {
+            // includes decoding and uploading the images
+            scene.init(scenePath, &gpu);
+            gpu.asyncLoader.flush();
+          },
+          [&] {
+            scene.shutdown();
+            scene = GltfScene{};
+          });
+    }
+  }
+}
+
+static void benchCalcTangent(Microbench &bench, GpuDevice &gpu) {
+  for (uint32_t n : {256u, 1024u}) {
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec4> positions;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec2> uvs;
+    generateGrid(n, indices, positions, normals, uvs);
+    std::vector<glm::vec4> tangents(positions.size());
+
+    bench.run(
+        "CalcTangent::calculate/" + std::to_string(indices.size() / 3) +
+            " tris",
+        1, {}, [&] {
+          CalcTangent mikktspace;
+          CalcTangentData calcTangentData = {
+              .indices = indices,
+              .positions = positions,
+              .normals = normals,
+              .uvs = uvs,
+              .tangents = tangents,
+          };
+          mikktspace.calculate(&calcTangentData);
+        });
+
+    bench.run(
+        "CalcTangent::calculateChunked/" + std::to_string(indices.size() / 3) +
+            " tris",
+        1, {}, [&] {
+          CalcTangentData calcTangentData = {
+              .indices = indices,
+              .positions = positions,
+              .normals = normals,
+              .uvs = uvs,
+              .tangents = tangents,
+          };
+          CalcTangent::calculateChunked(calcTangentData, gpu.threadPool);
+        });
+  }
+}
+
+// appends a displaced grid of 2n^2 triangles starting at x = offsetX, its
+// tangents vary across the surface
+static void appendWavyGrid(uint32_t n, float offsetX,
+                           std::vector<uint32_t> &indices,
+                           std::vector<glm::vec4> &positions,
+                           std::vector<glm::vec4> &normals,
+                           std::vector<glm::vec2> &uvs) {
+  uint32_t firstVertex = positions.size();
+  uint32_t rowSize = n + 1;
+  for (uint32_t z = 0; z < rowSize; z++) {
+    for (uint32_t x = 0; x < rowSize; x++) {
+      glm::vec2 uv = glm::vec2(x, z) / static_cast<float>(n);
+      float height = std::sin(uv.x * 7.f) * std::cos(uv.y * 5.f);
+      positions.emplace_back(offsetX + uv.x, height, uv.y, 1.f);
+      normals.emplace_back(0.f, 1.f, 0.f, 0.f);
+      uvs.emplace_back(uv.x * uv.x, uv.y);
+    }
+  }
+
+  for (uint32_t z = 0; z < n; z++) {
+    for (uint32_t x = 0; x < n; x++) {
+      uint32_t i = firstVertex + z * rowSize + x;
+      indices.insert(indices.end(), {i, i + rowSize, i + 1, i + 1,
+                                     i + rowSize, i + rowSize + 1});
+    }
+  }
+}
+
+// calculateChunked must match calculate exactly. the mesh has one component
+// above the chunk size, many small ones that get packed into chunks, and a
+// copy of the first small grid at the end whose vertices mikktspace welds
+// with the original even though no index is shared
+static bool checkCalcTangentChunked(GpuDevice &gpu) {
+  std::vector<uint32_t> indices;
+  std::vector<glm::vec4> positions;
+  std::vector<glm::vec4> normals;
+  std::vector<glm::vec2> uvs;
+  appendWavyGrid(128, 0.f, indices, positions, normals, uvs);
+  for (uint32_t i = 0; i < 96; i++) {
+    appendWavyGrid(16, 2.f + i * 2.f, indices, positions, normals, uvs);
+  }
+  appendWavyGrid(16, 2.f, indices, positions, normals, uvs);
+
+  std::vector<glm::vec4> tangents(positions.size());
+  CalcTangentData calcTangentData = {
+      .indices = indices,
+      .positions = positions,
+      .normals = normals,
+      .uvs = uvs,
+      .tangents = tangents,
+  };
+  CalcTangent mikktspace;
+  mikktspace.calculate(&calcTangentData);
+
+  std::vector<glm::vec4> chunkedTangents(positions.size());
+  CalcTangentData chunkedData = {
+      .indices = indices,
+      .positions = positions,
+      .normals = normals,
+      .uvs = uvs,
+      .tangents = chunkedTangents,
+  };
+  CalcTangent::calculateChunked(chunkedData, gpu.threadPool);
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < tangents.size(); i++) {
+    if (tangents[i] != chunkedTangents[i]) {
+      mismatches++;
+    }
+  }
+  if (mismatches > 0) {
+    spdlog::error("CalcTangent::calculateChunked differs from calculate for "
+                  "{} of {} vertices",
+                  mismatches, tangents.size());
+    return false;
+  }
+  return true;
+}
+
+static void benchModelManagerNewFrame(Microbench &bench, GpuDevice &gpu) {
+  static constexpr uint32_t MAX_INSTANCES = 100000;
+
+  ModelManager modelManager;
+  modelManager.init(&gpu, 1, MAX_INSTANCES);
+  Handle<ModelPrefab> prefab =
+      modelManager.loadPrefab("assets/BoxTextured.gltf");
+  if (!prefab.isValid()) {
+    modelManager.shutdown();
+    return;
+  }
+
+  // instances are only added, so each size builds on the previous one
+  for (uint32_t instanceCount : {1000u, 10000u, MAX_INSTANCES}) {
+    while (modelManager.loadedInstances.size() < instanceCount) {
+      uint32_t i = modelManager.loadedInstances.size();
+      ModelInstance *instance =
+          modelManager.getInstance(modelManager.addInstance(prefab));
+      instance->translation = {static_cast<float>(i % 316), 0.f,
+                               static_cast<float>(i / 316)};
+    }
+
+    bench.run("ModelManager::newFrame/" + std::to_string(instanceCount) +
+                  " instances",
+              1, {}, [&] { modelManager.newFrame(); });
+  }
+
+  modelManager.shutdown();
+}
+
+static void benchGetFrustumPlanes(Microbench &bench) {
+  static constexpr uint32_t OPS = 10000;
+
+  glm::mat4 projection =
+      glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 1000.f);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.f, 5.f, 10.f), glm::vec3(0.f),
+                               glm::vec3(0.f, 1.f, 0.f));
+  glm::mat4 viewProjection = projection * view;
+
+  bench.run("FrustumCullPass::getFrustumPlanes", OPS, {}, [&] {
+    float acc = 0.f;
+    for (uint32_t i = 0; i < OPS; i++) {
+      FrustumPlanes planes = FrustumCullPass::getFrustumPlanes(viewProjection);
+      acc += planes.left.x;
+    }
+    sink = acc;
+  });
+}
+
+static void benchGenerateMeshDraws(Microbench &bench, GpuDevice &gpu) {
+  GltfScene scene;
+  scene.init("assets/CesiumMilkTruck.gltf", &gpu);
+
+  // generateMeshDraws appends the mesh data, so clear what the previous
+  // iteration added
+  std::vector<MeshDraw> meshDraws;
+  bench.run(
+      "GltfScene::generateMeshDraws/CesiumMilkTruck", 1,
+      [&] {
+        scene.indices.clear();
+        scene.positions.clear();
+        scene.normals.clear();
+        scene.uvs.clear();
+        scene.tangents.clear();
+        scene.transforms.clear();
+      },
+      [&] { meshDraws = scene.generateMeshDraws(); });
+
+  scene.shutdown();
+}
+
+int main(int argc, char **argv) {
+  Microbench bench;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--filter" && i + 1 < argc) {
+      bench.filter = argv[++i];
+    } else if (arg == "--min-time" && i + 1 < argc) {
+      bench.minSeconds = std::stod(argv[++i]);
+    } else {
+      spdlog::info("usage: flare-microbench [--filter substring] "
+                   "[--min-time seconds]");
+      return 1;
+    }
+  }
+
+  spdlog::set_level(spdlog::level::warn);
+
+  // loading uploads textures and ModelManager writes to mapped buffers, so
+  // these need a device, but nothing is rendered
+  GpuDeviceCreateInfo gpuDeviceCI{
+      .headless = true,
+      .headlessExtent = {64, 64},
+      .shaderHotReload = false,
+  };
+  GpuDevice gpu;
+  gpu.init(gpuDeviceCI);
+
+  bool tangentsMatch = checkCalcTangentChunked(gpu);
+
+  std::printf("%-48s %10s %14s %12s %14s\n", "benchmark", "iterations",
+              "ns/op", "allocs/op", "bytes/op");
+
+  benchGltfSceneInit(bench, gpu);
+  benchCalcTangent(bench, gpu);
+  benchModelManagerNewFrame(bench, gpu);
+  benchGetFrustumPlanes(bench);
+  benchGenerateMeshDraws(bench, gpu);
+
+  vkDeviceWaitIdle(gpu.device);
+  gpu.shutdown();
+
+  return tangentsMatch ? 0 : 1;
+}
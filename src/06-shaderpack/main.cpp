@@ -0,0 +1,64 @@
+#include "FlareGraphics/ShaderArchive.h"
+#include "FlareGraphics/ShaderCompiler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+using namespace Flare;
+
+// compiles every glsl shader in the given directories into one archive.
+// shaders are named relative to root, the same way PipelineCI refers to them
+// usage: flare-shaderpack <root> <output> <directory>...
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    spdlog::error("usage: flare-shaderpack <root> <output> <directory>...");
+    return 1;
+  }
+
+  fs::path outputPath = fs::absolute(argv[2]);
+
+  // includes are resolved relative to the working directory, like at runtime
+  fs::current_path(argv[1]);
+
+  ShaderCompiler shaderCompiler;
+  shaderCompiler.init(outputPath.parent_path() / "shader_cache", {});
+
+  std::vector<fs::path> shaderPaths;
+  for (int i = 3; i < argc; i++) {
+    for (const auto &entry : fs::directory_iterator(argv[i])) {
+      fs::path extension = entry.path().extension();
+      if (extension == ".vert" || extension == ".frag" ||
+          extension == ".comp") {
+        shaderPaths.push_back(fs::path(argv[i]) / entry.path().filename());
+      }
+    }
+  }
+  // stable archive contents regardless of directory order
+  std::sort(shaderPaths.begin(), shaderPaths.end());
+
+  std::vector<ShaderArchiveInput> shaders;
+  shaders.reserve(shaderPaths.size());
+  for (const auto &shaderPath : shaderPaths) {
+    std::vector<uint32_t> spirv = shaderCompiler.compileGLSL(shaderPath);
+    if (spirv.empty()) {
+      spdlog::error("Failed to compile {}", shaderPath.string());
+      return 1;
+    }
+    shaders.push_back({
+        .name = shaderPath.generic_string(),
+        .spirv = std::move(spirv),
+    });
+  }
+
+  shaderCompiler.shutdown();
+
+  if (!writeShaderArchive(outputPath, shaders)) {
+    return 1;
+  }
+
+  spdlog::info("Packed {} shaders into {}", shaders.size(),
+               outputPath.string());
+  return 0;
+}
@@ -0,0 +1,43 @@
+#include "FlareGraphics/CookedMesh.h"
+#include "FlareGraphics/GltfScene.h"
+
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+using namespace Flare;
+
+// converts a gltf into a .flaremesh with the final vertex data, materials and
+// mesh draws, so loading it skips parsing and tangent generation. images are
+// referenced, not copied, unless they're embedded in the gltf
+// usage: flare-meshcook <input> [output]
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    spdlog::error("usage: flare-meshcook <input> [output]");
+    return 1;
+  }
+
+  std::filesystem::path inputPath = argv[1];
+  std::filesystem::path outputPath =
+      argc == 3 ? std::filesystem::path(argv[2])
+                : std::filesystem::path(inputPath).replace_extension(
+                      COOKED_MESH_EXTENSION);
+
+  ThreadPool threadPool;
+  threadPool.init();
+
+  GltfScene scene;
+  bool loaded = scene.loadGltf(inputPath, &threadPool);
+  threadPool.shutdown();
+  if (!loaded) {
+    return 1;
+  }
+
+  bool written = writeCookedMesh(scene, outputPath);
+  scene.shutdown();
+  if (!written) {
+    return 1;
+  }
+
+  spdlog::info("Cooked {} into {}", inputPath.string(), outputPath.string());
+  return 0;
+}
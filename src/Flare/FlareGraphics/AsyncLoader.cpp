@@ -1,381 +1,568 @@
 #include "AsyncLoader.h"
+#include "GpuDevice.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 
 #include "VkHelper.h"
+#include <algorithm>
 #include <stb_image.h>
+#include <thread>
+#include <tracy/Tracy.hpp>
 
 namespace Flare {
-void AsyncLoader::init(GpuDevice &gpuDevice) {
+void AsyncLoader::init(GpuDevice &gpuDevice, uint32_t threadCount) {
   gpu = &gpuDevice;
 
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency() / 2, 1u);
+  }
+  stopping = false;
+  decodePool.init(threadCount);
+
+  VkCommandPoolCreateInfo commandPoolCI = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = gpu->transferFamily,
+  };
+  vkCreateCommandPool(gpu->device, &commandPoolCI, nullptr,
+                      &transferCommandPool);
+
+  commandPoolCI.queueFamilyIndex = gpu->mainFamily;
+  acquireCommandPools.resize(FRAMES_IN_FLIGHT);
+  acquireCommandBuffers.resize(FRAMES_IN_FLIGHT);
   for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-    VkCommandPoolCreateInfo commandPoolCI = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = gpu->transferFamily,
-    };
-    vkCreateCommandPool(gpu->device, &commandPoolCI, nullptr, &commandPools[i]);
+    vkCreateCommandPool(gpu->device, &commandPoolCI, nullptr,
+                        &acquireCommandPools[i]);
 
     VkCommandBufferAllocateInfo cmd = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .pNext = nullptr,
-        .commandPool = commandPools[i],
+        .commandPool = acquireCommandPools[i],
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = 1,
     };
-    vkAllocateCommandBuffers(gpu->device, &cmd, &commandBuffers[i]);
+    vkAllocateCommandBuffers(gpu->device, &cmd, &acquireCommandBuffers[i]);
   }
 
-  VkFenceCreateInfo fenceCI = {
-      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+  VkSemaphoreTypeCreateInfo timelineCI = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
       .pNext = nullptr,
-      .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0,
+  };
+  VkSemaphoreCreateInfo semaphoreCI = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &timelineCI,
+      .flags = 0,
   };
-  vkCreateFence(gpu->device, &fenceCI, nullptr, &transferFence);
+  vkCreateSemaphore(gpu->device, &semaphoreCI, nullptr, &timelineSemaphore);
 
+  stagingSize = STAGING_BUFFER_SIZE_MB * 1024 * 1024;
+  maxChunkSize = stagingSize / 2 - ASYNC_LOADER_STAGING_ALIGNMENT;
   BufferCI stagingBufferCI = {
-      .size = STAGING_BUFFER_SIZE_MB * 1024 * 1024,
+      .size = stagingSize,
       .usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
       .mapped = true,
+      .name = "async loader staging",
   };
 
   stagingBufferHandle = gpu->createBuffer(stagingBufferCI);
 }
 
 void AsyncLoader::shutdown() {
+  // queued decodes return early, running ones finish before the join
+  stopping = true;
+  decodePool.shutdown();
+
   vkDeviceWaitIdle(gpu->device);
 
-  vkDestroyFence(gpu->device, transferFence, nullptr);
+  for (auto &decoded : decodedTextures) {
+    stbi_image_free(decoded.data);
+    if (decoded.texture.isValid()) {
+      gpu->destroyTexture(decoded.texture);
+    }
+  }
+  decodedTextures.clear();
+  inFlightBatches.clear();
+
+  vkDestroySemaphore(gpu->device, timelineSemaphore, nullptr);
 
   gpu->destroyBuffer(stagingBufferHandle);
-  for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-    vkDestroyCommandPool(gpu->device, commandPools[i], nullptr);
+  vkDestroyCommandPool(gpu->device, transferCommandPool, nullptr);
+  for (auto &commandPool : acquireCommandPools) {
+    vkDestroyCommandPool(gpu->device, commandPool, nullptr);
   }
 }
 
-void AsyncLoader::update() {
-  if (!fileRequests.empty()) {
-    FileRequest fileRequest = fileRequests.back();
-    fileRequests.pop_back();
-
-    spdlog::info("loading {}", fileRequest.path.string());
-
-    int width, height, component;
-    unsigned char *stbData =
-        stbi_load(fileRequest.path.string().c_str(), &width, &height,
-                  &component, STBI_rgb_alpha);
-    uploadRequests.emplace_back(UploadRequest{
-        .texture = fileRequest.texture,
-        .data = stbData,
-    });
-  }
+void AsyncLoader::requestTexture(TextureRequest request) {
+  pendingDecodes++;
 
-  if (!uploadRequests.empty()) {
-    if (vkGetFenceStatus(gpu->device, transferFence) != VK_SUCCESS) {
+  decodePool.enqueue([this, request = std::move(request)]() mutable {
+    if (stopping) {
+      pendingDecodes--;
       return;
     }
-    vkResetFences(gpu->device, 1, &transferFence);
 
-    UploadRequest request = uploadRequests.back();
-    uploadRequests.pop_back();
+    ZoneScopedN("AsyncLoader decode");
+
+    int width, height, channelCount;
+    unsigned char *stbData = nullptr;
+    if (!request.encodedData.empty()) {
+      stbData = stbi_load_from_memory(
+          request.encodedData.data(),
+          static_cast<int>(request.encodedData.size()), &width, &height,
+          &channelCount, STBI_rgb_alpha);
+    } else {
+      stbData = stbi_load(request.path.string().c_str(), &width, &height,
+                          &channelCount, STBI_rgb_alpha);
+    }
 
-    VkCommandBuffer cmd = commandBuffers[gpu->currentFrame];
+    if (!stbData) {
+      spdlog::error("AsyncLoader: Failed to decode {}",
+                    request.path.empty() ? request.ci.name
+                                         : request.path.string());
+      pendingDecodes--;
+      return;
+    }
 
-    VkCommandBufferBeginInfo beginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    request.ci.initialData = nullptr;
+    request.ci.width = static_cast<uint32_t>(width);
+    request.ci.height = static_cast<uint32_t>(height);
+    request.ci.depth = 1;
+
+    {
+      std::lock_guard<std::mutex> lock(requestMutex);
+      decodedTextures.push_back({
+          .ci = std::move(request.ci),
+          .data = stbData,
+          .onLoaded = std::move(request.onLoaded),
+      });
+    }
+    pendingDecodes--;
+  });
+}
+
+void AsyncLoader::update() {
+  ZoneScoped;
+
+  retireBatches();
+  submitBatch();
+}
+
+void AsyncLoader::flush() {
+  ZoneScoped;
+
+  while (!idle()) {
+    update();
+
+    if (inFlightBatches.empty()) {
+      // still decoding
+      std::this_thread::yield();
+      continue;
+    }
+
+    uint64_t waitValue = inFlightBatches.back().timelineValue;
+    VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
         .pNext = nullptr,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        .pInheritanceInfo = nullptr,
+        .flags = 0,
+        .semaphoreCount = 1,
+        .pSemaphores = &timelineSemaphore,
+        .pValues = &waitValue,
     };
 
-    vkBeginCommandBuffer(cmd, &beginInfo);
+    vkWaitSemaphores(gpu->device, &waitInfo, UINT64_MAX);
+  }
+}
 
-    if (request.texture && request.data) {
-      constexpr size_t channelCount = 4;
-      const size_t imageSize =
-          request.texture->width * request.texture->height * channelCount;
+bool AsyncLoader::idle() {
+  std::lock_guard<std::mutex> lock(requestMutex);
+  return pendingDecodes == 0 && decodedTextures.empty() &&
+         inFlightBatches.empty();
+}
 
-      const size_t alignedImageSize = VkHelper::memoryAlign(imageSize, 4);
-      size_t offset =
-          std::atomic_fetch_add(&stagingBufferOffset, alignedImageSize);
+void AsyncLoader::retireBatches() {
+  uint64_t completedValue = 0;
+  vkGetSemaphoreCounterValue(gpu->device, timelineSemaphore, &completedValue);
+
+  while (!inFlightBatches.empty() &&
+         inFlightBatches.front().timelineValue <= completedValue) {
+    TransferBatch &batch = inFlightBatches.front();
+
+    stagingTail = batch.stagingEnd;
+    vkResetCommandBuffer(batch.cmd, 0);
+    freeCommandBuffers.push_back(batch.cmd);
+
+    // acquired before anything recorded this frame, so the callbacks can
+    // already hand the resources out
+    for (auto &loaded : batch.textures) {
+      acquireTextures.push_back(loaded.texture);
+      if (loaded.onLoaded) {
+        loaded.onLoaded(loaded.texture);
+      }
+    }
+    acquireWaitValue = batch.timelineValue;
 
-      Buffer *stagingBuffer = gpu->getBuffer(stagingBufferHandle);
-      memcpy(
-          static_cast<std::byte *>(stagingBuffer->allocationInfo.pMappedData) +
-              offset,
-          request.data, imageSize);
+    inFlightBatches.pop_front();
+  }
 
-      VkImageMemoryBarrier2 preCopyBarrier = {
-          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-          .pNext = nullptr,
-          .srcStageMask = 0,
-          .srcAccessMask = 0,
-          .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-          .dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-          .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-          .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-          .image = request.texture->image,
-          .subresourceRange = {
-              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-              .baseMipLevel = 0,
-              .levelCount = VK_REMAINING_MIP_LEVELS,
-              .baseArrayLayer = 0,
-              .layerCount = VK_REMAINING_ARRAY_LAYERS,
-          }};
+  if (inFlightBatches.empty()) {
+    stagingHead = 0;
+    stagingTail = 0;
+  }
+}
 
-      VkDependencyInfo preCopyDep = {
-          .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-          .pNext = nullptr,
-          .dependencyFlags = 0,
-          .imageMemoryBarrierCount = 1,
-          .pImageMemoryBarriers = &preCopyBarrier,
-      };
+bool AsyncLoader::allocateStaging(size_t size, size_t &offset) {
+  size_t alignedHead =
+      VkHelper::memoryAlign(stagingHead, ASYNC_LOADER_STAGING_ALIGNMENT);
+
+  // an allocation never ends exactly on the tail, so head == tail always
+  // means the ring is empty
+  if (stagingHead >= stagingTail) {
+    if (alignedHead + size <= stagingSize) {
+      offset = alignedHead;
+      stagingHead = alignedHead + size;
+      return true;
+    }
+    if (size < stagingTail) {
+      offset = 0;
+      stagingHead = size;
+      return true;
+    }
+    return false;
+  }
 
-      vkCmdPipelineBarrier2(cmd, &preCopyDep);
+  if (alignedHead + size < stagingTail) {
+    offset = alignedHead;
+    stagingHead = alignedHead + size;
+    return true;
+  }
+  return false;
+}
 
-      VkBufferImageCopy2 region = {
-          .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
-          .pNext = nullptr,
-          .bufferOffset = offset,
-          .bufferRowLength = 0,
-          .bufferImageHeight = 0,
-          .imageSubresource =
-              {
-                  .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                  .mipLevel = 0,
-                  .baseArrayLayer = 0,
-                  .layerCount = 1,
-              },
-          .imageOffset = {0, 0, 0},
-          .imageExtent =
-              {
-                  .width = request.texture->width,
-                  .height = request.texture->height,
-                  .depth = request.texture->depth,
-              },
-      };
+VkCommandBuffer AsyncLoader::beginBatch() {
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  if (!freeCommandBuffers.empty()) {
+    cmd = freeCommandBuffers.back();
+    freeCommandBuffers.pop_back();
+  } else {
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .commandPool = transferCommandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    vkAllocateCommandBuffers(gpu->device, &allocInfo, &cmd);
+  }
 
-      VkCopyBufferToImageInfo2 copyInfo = {
-          .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2,
-          .pNext = nullptr,
-          .srcBuffer = stagingBuffer->buffer,
-          .dstImage = request.texture->image,
-          .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-          .regionCount = 1,
-          .pRegions = &region,
-      };
+  VkCommandBufferBeginInfo beginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
 
-      vkCmdCopyBufferToImage2(cmd, &copyInfo);
+  vkBeginCommandBuffer(cmd, &beginInfo);
 
-      VkImageMemoryBarrier2 postCopyBarrier = {
-          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-          .pNext = nullptr,
-          .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-          .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-          .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-          .dstAccessMask = 0,
-          .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-          .newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-          .srcQueueFamilyIndex = gpu->transferFamily,
-          .dstQueueFamilyIndex = gpu->mainFamily,
-          .image = request.texture->image,
-          .subresourceRange = {
-              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-              .baseMipLevel = 0,
-              .levelCount = VK_REMAINING_MIP_LEVELS,
-              .baseArrayLayer = 0,
-              .layerCount = VK_REMAINING_ARRAY_LAYERS,
-          }};
+  // the transfer context is null when the queue has no timestamp support
+  if (gpu->tracyTransferContext) {
+    TracyVkCollect(gpu->tracyTransferContext, cmd);
+  }
 
-      VkDependencyInfo postCopyDep = {
-          .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-          .pNext = nullptr,
-          .dependencyFlags = 0,
-          .imageMemoryBarrierCount = 1,
-          .pImageMemoryBarriers = &postCopyBarrier,
-      };
-
-      vkCmdPipelineBarrier2(cmd, &postCopyDep);
-
-      free(request.data);
-    } else if (request.srcBuffer && request.dstBuffer) {
-      VkBufferCopy region = {
-          .srcOffset = 0,
-          .dstOffset = 0,
-          .size = request.srcBuffer->size,
-      };
-
-      vkCmdCopyBuffer(cmd, request.srcBuffer->buffer, request.dstBuffer->buffer,
-                      1, &region);
-    } else if (request.dstBuffer) {
-      const size_t alignedBufferSize =
-          VkHelper::memoryAlign(request.dstBuffer->size, 64);
-      size_t offset =
-          std::atomic_fetch_add(&stagingBufferOffset, alignedBufferSize);
-
-      Buffer *stagingBuffer = gpu->getBuffer(stagingBufferHandle);
-      memcpy(
-          static_cast<std::byte *>(stagingBuffer->allocationInfo.pMappedData) +
-              offset,
-          request.data, request.dstBuffer->size);
-
-      VkBufferCopy2 region = {
-          .sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2,
-          .pNext = nullptr,
-          .srcOffset = offset,
-          .dstOffset = 0,
-          .size = request.dstBuffer->size,
-      };
+  return cmd;
+}
 
-      VkCopyBufferInfo2 copyInfo = {
-          .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
-          .pNext = nullptr,
-          .srcBuffer = stagingBuffer->buffer,
-          .dstBuffer = request.dstBuffer->buffer,
-          .regionCount = 1,
-          .pRegions = &region,
-      };
+void AsyncLoader::submitBatch() {
+  TransferBatch batch;
+  Buffer *stagingBuffer = gpu->getBuffer(stagingBufferHandle);
+  auto *stagingData =
+      static_cast<std::byte *>(stagingBuffer->allocationInfo.pMappedData);
+
+  std::lock_guard<std::mutex> lock(requestMutex);
+
+  // requests are taken in order until one doesn't fit, it goes first next
+  // frame once earlier batches have released their staging space
+  while (!decodedTextures.empty()) {
+    DecodedTexture &decoded = decodedTextures.front();
+
+    // whole rows per chunk
+    constexpr size_t channelCount = 4;
+    size_t rowSize = static_cast<size_t>(decoded.ci.width) * channelCount;
+    uint32_t chunkRows =
+        static_cast<uint32_t>(std::max<size_t>(1, maxChunkSize / rowSize));
+    uint32_t rowCount =
+        std::min(chunkRows, decoded.ci.height - decoded.uploadedRows);
+    size_t size = rowCount * rowSize;
+
+    size_t offset = 0;
+    if (!allocateStaging(size, offset)) {
+      break;
+    }
+    if (batch.cmd == VK_NULL_HANDLE) {
+      batch.cmd = beginBatch();
+    }
+    if (!decoded.texture.isValid()) {
+      decoded.texture = gpu->createTexture(decoded.ci);
+    }
 
-      vkCmdCopyBuffer2(cmd, &copyInfo);
+    memcpy(stagingData + offset, decoded.data + decoded.uploadedRows * rowSize,
+           size);
+    recordTextureUpload(batch.cmd, decoded.texture, offset,
+                        decoded.uploadedRows, rowCount);
+    decoded.uploadedRows += rowCount;
+
+    if (decoded.uploadedRows < decoded.ci.height) {
+      // submitted right away so it transfers while the next chunk is copied
+      endBatch(batch);
+      batch = {};
+      continue;
+    }
 
-      VkBufferMemoryBarrier2 barrier = {
-          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-          .pNext = nullptr,
-          .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-          .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
-          .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-          .dstAccessMask = 0,
-          .srcQueueFamilyIndex = gpu->transferFamily,
-          .dstQueueFamilyIndex = gpu->mainFamily,
-          .buffer = request.dstBuffer->buffer,
-          .offset = 0,
-          .size = request.dstBuffer->size,
-      };
+    stbi_image_free(decoded.data);
+    batch.textures.push_back({
+        .texture = decoded.texture,
+        .onLoaded = std::move(decoded.onLoaded),
+    });
 
-      VkDependencyInfo depInfo = {
-          .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-          .pNext = nullptr,
-          .dependencyFlags = 0,
-          .bufferMemoryBarrierCount = 1,
-          .pBufferMemoryBarriers = &barrier,
-      };
+    decodedTextures.pop_front();
+  }
 
-      vkCmdPipelineBarrier2(cmd, &depInfo);
-    }
+  if (batch.cmd != VK_NULL_HANDLE) {
+    endBatch(batch);
+  }
+}
 
-    vkEndCommandBuffer(cmd);
+void AsyncLoader::endBatch(TransferBatch &batch) {
+  vkEndCommandBuffer(batch.cmd);
 
-    VkCommandBufferSubmitInfo cmdSubmitInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
-        .pNext = nullptr,
-        .commandBuffer = cmd,
-    };
+  batch.timelineValue = ++timelineValue;
+  batch.stagingEnd = stagingHead;
 
-    VkSubmitInfo2 submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-        .pNext = nullptr,
-        .flags = 0,
-        .commandBufferInfoCount = 1,
-        .pCommandBufferInfos = &cmdSubmitInfo,
-    };
+  VkCommandBufferSubmitInfo cmdSubmitInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .pNext = nullptr,
+      .commandBuffer = batch.cmd,
+  };
 
-    vkQueueSubmit2(gpu->transferQueue, 1, &submitInfo, transferFence);
+  VkSemaphoreSubmitInfo signalInfo = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .semaphore = timelineSemaphore,
+      .value = batch.timelineValue,
+      .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .deviceIndex = 0,
+  };
 
-    if (request.texture && request.texture->mipLevel > 1) {
-      VkHelper::genMips(gpu->getCommandBuffer(), request.texture->image,
-                        {request.texture->width, request.texture->height});
-    }
+  VkSubmitInfo2 submitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .pNext = nullptr,
+      .flags = 0,
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &cmdSubmitInfo,
+      .signalSemaphoreInfoCount = 1,
+      .pSignalSemaphoreInfos = &signalInfo,
+  };
 
-    if (request.texture) {
-      std::lock_guard<std::mutex> lock(textureMutex);
-      pendingTextures.push_back(request.texture);
-    } else if (request.dstBuffer) {
-      std::lock_guard<std::mutex> lock(bufferMutex);
-      pendingBuffers.push_back(request.dstBuffer);
-    }
+  if (vkQueueSubmit2(gpu->transferQueue, 1, &submitInfo, VK_NULL_HANDLE) !=
+      VK_SUCCESS) {
+    spdlog::error("AsyncLoader: Error submitting transfer batch");
   }
 
-  stagingBufferOffset = 0;
+  inFlightBatches.push_back(std::move(batch));
 }
 
-void AsyncLoader::signalTextures(VkCommandBuffer cmd) {
-  std::lock_guard<std::mutex> lock(textureMutex);
+void AsyncLoader::recordTextureUpload(VkCommandBuffer cmd,
+                                      Handle<Texture> handle,
+                                      size_t stagingOffset, uint32_t firstRow,
+                                      uint32_t rowCount) {
+  Texture *texture = gpu->getTexture(handle);
+  Buffer *stagingBuffer = gpu->getBuffer(stagingBufferHandle);
+
+  VkImageSubresourceRange subresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = VK_REMAINING_MIP_LEVELS,
+      .baseArrayLayer = 0,
+      .layerCount = VK_REMAINING_ARRAY_LAYERS,
+  };
 
-  if (pendingTextures.empty()) {
-    return;
-  }
+  VkImageMemoryBarrier2 preCopyBarrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .pNext = nullptr,
+      .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+      .srcAccessMask = VK_ACCESS_2_NONE,
+      .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = texture->image,
+      .subresourceRange = subresourceRange,
+  };
 
-  for (const auto &texture : pendingTextures) {
-    VkImageMemoryBarrier2 barrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .pNext = nullptr,
-        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-        .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-        .dstAccessMask = 0,
-        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        .srcQueueFamilyIndex = gpu->transferFamily,
-        .dstQueueFamilyIndex = gpu->mainFamily,
-        .image = texture->image,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = VK_REMAINING_MIP_LEVELS,
-            .baseArrayLayer = 0,
-            .layerCount = VK_REMAINING_ARRAY_LAYERS,
-        }};
-
-    VkDependencyInfo postCopyDep = {
-        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .pNext = nullptr,
-        .dependencyFlags = 0,
-        .imageMemoryBarrierCount = 1,
-        .pImageMemoryBarriers = &barrier,
-    };
+  VkDependencyInfo preCopyDep = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .pNext = nullptr,
+      .dependencyFlags = 0,
+      .imageMemoryBarrierCount = 1,
+      .pImageMemoryBarriers = &preCopyBarrier,
+  };
 
-    vkCmdPipelineBarrier2(cmd, &postCopyDep);
+  // later chunks are ordered after it by the transfer queue's submission
+  // order
+  if (firstRow == 0) {
+    vkCmdPipelineBarrier2(cmd, &preCopyDep);
   }
 
-  pendingTextures.clear();
-}
+  VkBufferImageCopy2 region = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+      .pNext = nullptr,
+      .bufferOffset = stagingOffset,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .mipLevel = 0,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+      .imageOffset = {0, static_cast<int32_t>(firstRow), 0},
+      .imageExtent =
+          {
+              .width = texture->width,
+              .height = rowCount,
+              .depth = texture->depth,
+          },
+  };
+
+  VkCopyBufferToImageInfo2 copyInfo = {
+      .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2,
+      .pNext = nullptr,
+      .srcBuffer = stagingBuffer->buffer,
+      .dstImage = texture->image,
+      .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .regionCount = 1,
+      .pRegions = &region,
+  };
 
-void AsyncLoader::signalBuffers(VkCommandBuffer cmd) {
-  std::lock_guard<std::mutex> lock(bufferMutex);
+  vkCmdCopyBufferToImage2(cmd, &copyInfo);
 
-  if (pendingBuffers.empty()) {
+  if (firstRow + rowCount < texture->height) {
     return;
   }
 
-  for (const auto &buffer : pendingBuffers) {
-    VkBufferMemoryBarrier2 barrier = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-        .pNext = nullptr,
-        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-        .srcAccessMask = 0,
-        .dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
-        .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
-        .srcQueueFamilyIndex = gpu->transferFamily,
-        .dstQueueFamilyIndex = gpu->mainFamily,
-        .buffer = buffer->buffer,
-        .offset = 0,
-        .size = buffer->size};
-
-    VkDependencyInfo dep = {
+  // mips are blitted on the main queue after the acquire, so those images
+  // stay in transfer dst. the matching acquire is in recordAcquires
+  bool sameFamily = gpu->transferFamily == gpu->mainFamily;
+  VkImageMemoryBarrier2 releaseBarrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .pNext = nullptr,
+      .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .dstAccessMask = VK_ACCESS_2_NONE,
+      .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .newLayout = texture->mipLevel > 1
+                       ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                       : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      .srcQueueFamilyIndex =
+          sameFamily ? VK_QUEUE_FAMILY_IGNORED : gpu->transferFamily,
+      .dstQueueFamilyIndex =
+          sameFamily ? VK_QUEUE_FAMILY_IGNORED : gpu->mainFamily,
+      .image = texture->image,
+      .subresourceRange = subresourceRange,
+  };
+
+  VkDependencyInfo releaseDep = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .pNext = nullptr,
+      .dependencyFlags = 0,
+      .imageMemoryBarrierCount = 1,
+      .pImageMemoryBarriers = &releaseBarrier,
+  };
+
+  vkCmdPipelineBarrier2(cmd, &releaseDep);
+}
+
+VkCommandBuffer AsyncLoader::recordAcquires() {
+  if (acquireTextures.empty()) {
+    return VK_NULL_HANDLE;
+  }
+
+  VkCommandBuffer cmd = acquireCommandBuffers[gpu->currentFrame];
+  vkResetCommandPool(gpu->device, acquireCommandPools[gpu->currentFrame], 0);
+
+  VkCommandBufferBeginInfo beginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
+
+  vkBeginCommandBuffer(cmd, &beginInfo);
+
+  // on a shared family the release barrier already did the transition and
+  // the semaphore wait makes the copies visible, only the mips are left
+  bool sameFamily = gpu->transferFamily == gpu->mainFamily;
+
+  std::vector<VkImageMemoryBarrier2> imageBarriers;
+  if (!sameFamily) {
+    imageBarriers.reserve(acquireTextures.size());
+    for (const auto &handle : acquireTextures) {
+      Texture *texture = gpu->getTexture(handle);
+      VkImageLayout layout = texture->mipLevel > 1
+                                 ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                                 : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      imageBarriers.push_back({
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .pNext = nullptr,
+          .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+          .srcAccessMask = VK_ACCESS_2_NONE,
+          .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+          .dstAccessMask =
+              VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          .newLayout = layout,
+          .srcQueueFamilyIndex = gpu->transferFamily,
+          .dstQueueFamilyIndex = gpu->mainFamily,
+          .image = texture->image,
+          .subresourceRange =
+              {
+                  .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                  .baseMipLevel = 0,
+                  .levelCount = VK_REMAINING_MIP_LEVELS,
+                  .baseArrayLayer = 0,
+                  .layerCount = VK_REMAINING_ARRAY_LAYERS,
+              },
+      });
+    }
+
+    VkDependencyInfo acquireDep = {
         .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
         .pNext = nullptr,
         .dependencyFlags = 0,
-        .bufferMemoryBarrierCount = 1,
-        .pBufferMemoryBarriers = &barrier,
+        .imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+        .pImageMemoryBarriers = imageBarriers.data(),
     };
 
-    vkCmdPipelineBarrier2(cmd, &dep);
+    vkCmdPipelineBarrier2(cmd, &acquireDep);
   }
 
-  pendingBuffers.clear();
+  for (const auto &handle : acquireTextures) {
+    Texture *texture = gpu->getTexture(handle);
+    if (texture->mipLevel > 1) {
+      gpu->mipGenerator.generate(cmd, texture);
+    }
+  }
+
+  vkEndCommandBuffer(cmd);
+
+  acquireTextures.clear();
+
+  return cmd;
 }
-} // namespace Flare
\ No newline at end of file
+} // namespace Flare
@@ -1,54 +1,127 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
 
-#include "GpuDevice.h"
+#include "GpuResources.h"
+#include "ThreadPool.h"
 
 namespace Flare {
-struct UploadRequest {
-  Texture *texture = nullptr;
-  Buffer *dstBuffer = nullptr;
-  Buffer *srcBuffer = nullptr;
-  //        Handle<Texture> texture;
-  //        Handle<Buffer> dstBuffer;
-  //        Handle<Buffer> srcBuffer;
-  void *data = nullptr;
-};
+struct GpuDevice;
+
+static constexpr size_t ASYNC_LOADER_STAGING_ALIGNMENT = 16;
 
-struct FileRequest {
+struct TextureRequest {
+  // decoded from encodedData if it isn't empty, otherwise from path
   std::filesystem::path path;
-  Texture *texture;
-  //        Handle<Texture> texture;
+  std::vector<unsigned char> encodedData;
+  // width and height are taken from the decoded image
+  TextureCI ci;
+  std::function<void(Handle<Texture>)> onLoaded;
+};
+
+struct DecodedTexture {
+  TextureCI ci;
+  unsigned char *data = nullptr;
+  std::function<void(Handle<Texture>)> onLoaded;
+
+  // created with the first chunk, rows before uploadedRows are in flight
+  Handle<Texture> texture;
+  uint32_t uploadedRows = 0;
+};
+
+struct LoadedTexture {
+  Handle<Texture> texture;
+  std::function<void(Handle<Texture>)> onLoaded;
+};
+
+// one transfer submit, its staging range is reused once the loader timeline
+// reaches timelineValue
+struct TransferBatch {
+  uint64_t timelineValue = 0;
+  // staging ring head after the batch's allocations
+  size_t stagingEnd = 0;
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  std::vector<LoadedTexture> textures;
 };
 
 struct AsyncLoader {
-  GpuDevice *gpu;
+  // threadCount 0 uses half the hardware threads
+  void init(GpuDevice &gpuDevice, uint32_t threadCount = 0);
 
-  std::array<VkCommandPool, FRAMES_IN_FLIGHT> commandPools;
-  std::array<VkCommandBuffer, FRAMES_IN_FLIGHT> commandBuffers;
+  void shutdown();
 
-  VkFence transferFence = VK_NULL_HANDLE;
+  // decoded on the loader's workers and uploaded by a later update. onLoaded
+  // runs on the main thread in GpuDevice::newFrame once the texture is ready
+  // to be sampled by the frame being recorded. callable from any thread
+  void requestTexture(TextureRequest request);
 
-  Handle<Buffer> stagingBufferHandle;
-  std::atomic_size_t stagingBufferOffset = 0;
+  // retires finished batches, then records everything decoded that fits in
+  // the staging ring into one transfer submit
+  void update();
 
-  std::vector<UploadRequest> uploadRequests;
-  std::vector<FileRequest> fileRequests;
+  // updates until everything requested so far is uploaded, for loading
+  // screens and benchmarks. the acquires still go out with the next present
+  void flush();
 
-  std::mutex textureMutex;
-  std::vector<Texture *> pendingTextures;
+  // records the main queue side of the ownership transfers for the batches
+  // update retired, VK_NULL_HANDLE if there are none. the submit executing it
+  // must wait on timelineSemaphore at acquireWaitValue
+  VkCommandBuffer recordAcquires();
 
-  std::mutex bufferMutex;
-  std::vector<Buffer *> pendingBuffers;
+  // nothing is being decoded, waiting for staging space or in flight
+  bool idle();
 
-  void init(GpuDevice &gpuDevice);
+  void retireBatches();
 
-  void shutdown();
+  void submitBatch();
 
-  void update();
+  void endBatch(TransferBatch &batch);
+
+  // [stagingTail, stagingHead) is in use, wrapping around the end of the
+  // buffer when the head is behind the tail
+  bool allocateStaging(size_t size, size_t &offset);
+
+  VkCommandBuffer beginBatch();
+
+  // the first chunk transitions the image, the last one releases it
+  void recordTextureUpload(VkCommandBuffer cmd, Handle<Texture> handle,
+                           size_t stagingOffset, uint32_t firstRow,
+                           uint32_t rowCount);
+
+  GpuDevice *gpu = nullptr;
 
-  void signalTextures(VkCommandBuffer cmd);
+  ThreadPool decodePool;
+  std::atomic_bool stopping = false;
+  std::atomic_uint32_t pendingDecodes = 0;
 
-  void signalBuffers(VkCommandBuffer cmd);
+  std::mutex requestMutex;
+  std::deque<DecodedTexture> decodedTextures;
+
+  VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+  std::vector<VkCommandBuffer> freeCommandBuffers;
+
+  // per frame in flight, on the main queue family
+  std::vector<VkCommandPool> acquireCommandPools;
+  std::vector<VkCommandBuffer> acquireCommandBuffers;
+
+  VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+  uint64_t timelineValue = 0;
+  uint64_t acquireWaitValue = 0;
+
+  std::deque<TransferBatch> inFlightBatches;
+  std::vector<Handle<Texture>> acquireTextures;
+
+  Handle<Buffer> stagingBufferHandle;
+  size_t stagingSize = 0;
+  // uploads larger than this are split, so one chunk can transfer while the
+  // next is copied into the other half of the ring
+  size_t maxChunkSize = 0;
+  size_t stagingHead = 0;
+  size_t stagingTail = 0;
 };
 } // namespace Flare
@@ -1,4 +1,10 @@
 #include "CalcTangent.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tracy/Tracy.hpp>
+#include <unordered_map>
 
 namespace Flare {
 CalcTangent::CalcTangent() {
@@ -17,7 +23,8 @@ int CalcTangent::getVertexIndex(const SMikkTSpaceContext *pContext, int iFace,
   const auto *data =
       static_cast<const CalcTangentData *>(pContext->m_pUserData);
 
-  uint32_t index = iFace * getNumVerticesOfFace(pContext, iFace) + iVert;
+  uint32_t face = data->faces ? (*data->faces)[iFace] : iFace;
+  uint32_t index = face * getNumVerticesOfFace(pContext, iFace) + iVert;
 
   return data->indices[index];
 }
@@ -26,6 +33,9 @@ int CalcTangent::getNumFaces(const SMikkTSpaceContext *pContext) {
   const auto *data =
       static_cast<const CalcTangentData *>(pContext->m_pUserData);
 
+  if (data->faces) {
+    return data->faces->size();
+  }
   return data->indices.size() / 3;
 }
 
@@ -78,12 +88,14 @@ void CalcTangent::setTSpaceBasic(const SMikkTSpaceContext *pContext,
   const auto *data =
       static_cast<const CalcTangentData *>(pContext->m_pUserData);
 
-  int index = getVertexIndex(pContext, iFace, iVert);
+  glm::vec4 tangent(fvTangent[0], fvTangent[1], fvTangent[2], fSign);
+  if (data->faces) {
+    (*data->cornerTangents)[iFace * 3 + iVert] = tangent;
+    return;
+  }
 
-  data->tangents[index].x = fvTangent[0];
-  data->tangents[index].y = fvTangent[1];
-  data->tangents[index].z = fvTangent[2];
-  data->tangents[index].w = fSign;
+  int index = getVertexIndex(pContext, iFace, iVert);
+  data->tangents[index] = tangent;
 }
 
 void CalcTangent::calculate(CalcTangentData *data) {
@@ -91,4 +103,141 @@ void CalcTangent::calculate(CalcTangentData *data) {
 
   genTangSpaceDefault(&context);
 }
+
+// the attributes mikktspace welds corners by
+struct WeldKey {
+  float values[8];
+
+  bool operator==(const WeldKey &other) const {
+    return memcmp(values, other.values, sizeof(values)) == 0;
+  }
+};
+
+struct WeldKeyHash {
+  size_t operator()(const WeldKey &key) const {
+    return hashBytes(key.values, sizeof(key.values));
+  }
+};
+
+static uint32_t findRoot(std::vector<uint32_t> &parents, uint32_t i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+void CalcTangent::calculateChunked(const CalcTangentData &data,
+                                   ThreadPool &threadPool) {
+  ZoneScoped;
+
+  uint32_t faceCount = data.indices.size() / 3;
+  if (faceCount <= CALC_TANGENT_CHUNK_FACES) {
+    CalcTangentData chunkData = data;
+    CalcTangent mikktspace;
+    mikktspace.calculate(&chunkData);
+    return;
+  }
+
+  // vertices with equal attributes are welded into one node. adding 0
+  // turns -0 into 0, which compare equal in mikktspace. anything else it
+  // wouldn't weld only makes the components coarser
+  std::vector<uint32_t> parents(data.positions.size());
+  for (uint32_t i = 0; i < parents.size(); i++) {
+    parents[i] = i;
+  }
+
+  std::unordered_map<WeldKey, uint32_t, WeldKeyHash> welded;
+  welded.reserve(data.positions.size());
+  for (uint32_t i = 0; i < data.positions.size(); i++) {
+    WeldKey key = {{
+        data.positions[i].x + 0.f,
+        data.positions[i].y + 0.f,
+        data.positions[i].z + 0.f,
+        data.normals[i].x + 0.f,
+        data.normals[i].y + 0.f,
+        data.normals[i].z + 0.f,
+        data.uvs[i].s + 0.f,
+        data.uvs[i].t + 0.f,
+    }};
+    auto [it, inserted] = welded.try_emplace(key, i);
+    if (!inserted) {
+      parents[i] = it->second;
+    }
+  }
+
+  for (uint32_t face = 0; face < faceCount; face++) {
+    uint32_t a = findRoot(parents, data.indices[face * 3]);
+    for (uint32_t corner = 1; corner < 3; corner++) {
+      uint32_t b = findRoot(parents, data.indices[face * 3 + corner]);
+      if (a != b) {
+        parents[std::max(a, b)] = std::min(a, b);
+        a = std::min(a, b);
+      }
+    }
+  }
+
+  std::vector<uint32_t> componentFaceCounts(data.positions.size(), 0);
+  for (uint32_t face = 0; face < faceCount; face++) {
+    componentFaceCounts[findRoot(parents, data.indices[face * 3])]++;
+  }
+
+  // components are packed into chunks in order of their first face
+  std::vector<uint32_t> componentChunks(data.positions.size(), UINT32_MAX);
+  std::vector<uint32_t> chunkFaceCounts = {0};
+  for (uint32_t face = 0; face < faceCount; face++) {
+    uint32_t component = findRoot(parents, data.indices[face * 3]);
+    if (componentChunks[component] != UINT32_MAX) {
+      continue;
+    }
+    if (chunkFaceCounts.back() >= CALC_TANGENT_CHUNK_FACES) {
+      chunkFaceCounts.push_back(0);
+    }
+    componentChunks[component] = chunkFaceCounts.size() - 1;
+    chunkFaceCounts.back() += componentFaceCounts[component];
+  }
+
+  uint32_t chunkCount = chunkFaceCounts.size();
+  if (chunkCount == 1) {
+    CalcTangentData chunkData = data;
+    CalcTangent mikktspace;
+    mikktspace.calculate(&chunkData);
+    return;
+  }
+
+  // faces keep their relative order, mikktspace then sums in the same order
+  // as it does for the whole mesh
+  std::vector<std::vector<uint32_t>> chunkFaces(chunkCount);
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+    chunkFaces[chunk].reserve(chunkFaceCounts[chunk]);
+  }
+  for (uint32_t face = 0; face < faceCount; face++) {
+    uint32_t component = findRoot(parents, data.indices[face * 3]);
+    chunkFaces[componentChunks[component]].push_back(face);
+  }
+
+  std::vector<std::vector<glm::vec4>> chunkTangents(chunkCount);
+  threadPool.parallelFor(chunkCount, [&](size_t chunk) {
+    chunkTangents[chunk].resize(chunkFaces[chunk].size() * 3);
+
+    CalcTangentData chunkData = data;
+    chunkData.faces = &chunkFaces[chunk];
+    chunkData.cornerTangents = &chunkTangents[chunk];
+
+    CalcTangent mikktspace;
+    mikktspace.calculate(&chunkData);
+  });
+
+  // a vertex is only used by faces of one chunk, so the last of its faces
+  // writes it like in calculate
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+    const std::vector<uint32_t> &faces = chunkFaces[chunk];
+    for (size_t i = 0; i < faces.size(); i++) {
+      for (uint32_t corner = 0; corner < 3; corner++) {
+        data.tangents[data.indices[faces[i] * 3 + corner]] =
+            chunkTangents[chunk][i * 3 + corner];
+      }
+    }
+  }
+}
 } // namespace Flare
\ No newline at end of file
@@ -4,13 +4,24 @@
 #include <mikktspace.h>
 #include <vector>
 
+#include "ThreadPool.h"
+
 namespace Flare {
+// a large mesh is split across threads into chunks of whole components, each
+// filled until it has at least this many faces
+static constexpr uint32_t CALC_TANGENT_CHUNK_FACES = 16 * 1024;
+
 struct CalcTangentData {
   const std::vector<uint32_t> &indices;
   const std::vector<glm::vec4> &positions;
   const std::vector<glm::vec4> &normals;
   const std::vector<glm::vec2> &uvs;
   std::vector<glm::vec4> &tangents;
+
+  // if set, only these faces are processed and tangents are written per
+  // corner of them instead of per vertex
+  const std::vector<uint32_t> *faces = nullptr;
+  std::vector<glm::vec4> *cornerTangents = nullptr;
 };
 
 struct CalcTangent {
@@ -18,6 +29,14 @@ struct CalcTangent {
 
   void calculate(CalcTangentData *data);
 
+  // splits the faces into chunks processed on the thread pool, the output is
+  // identical to calculate. mikktspace averages over every face sharing a
+  // vertex, including corners welded because their position, normal and uv
+  // are equal, so chunks are made of whole connected components of the
+  // welded mesh. a mesh that is one big component isn't split
+  static void calculateChunked(const CalcTangentData &data,
+                               ThreadPool &threadPool);
+
   SMikkTSpaceInterface interface = {};
   SMikkTSpaceContext context = {};
 
@@ -0,0 +1,219 @@
+#include "CookedMesh.h"
+#include "GltfScene.h"
+#include "MappedFile.h"
+
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Flare {
+static uint64_t appendBytes(std::vector<uint8_t> &bytes, const void *data,
+                            size_t size) {
+  uint64_t offset = bytes.size();
+  const auto *src = static_cast<const uint8_t *>(data);
+  bytes.insert(bytes.end(), src, src + size);
+  return offset;
+}
+
+template <typename T>
+static CookedMeshRange appendSection(std::vector<uint8_t> &fileData,
+                                     const std::vector<T> &section) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  fileData.resize((fileData.size() + COOKED_MESH_ALIGNMENT - 1) &
+                  ~(COOKED_MESH_ALIGNMENT - 1));
+  return {
+      .offset = appendBytes(fileData, section.data(),
+                            section.size() * sizeof(T)),
+      .size = section.size() * sizeof(T),
+      .elementSize = sizeof(T),
+  };
+}
+
+static bool inRange(uint64_t offset, uint64_t size, uint64_t totalSize) {
+  return offset <= totalSize && size <= totalSize - offset;
+}
+
+template <typename T>
+static bool readSection(const MappedFile &file, const CookedMeshRange &range,
+                        std::vector<T> &section) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (!inRange(range.offset, range.size, file.size) ||
+      range.offset % COOKED_MESH_ALIGNMENT != 0 ||
+      range.elementSize != sizeof(T) || range.size % sizeof(T) != 0) {
+    return false;
+  }
+
+  const auto *data = reinterpret_cast<const T *>(file.data + range.offset);
+  section.assign(data, data + range.size / sizeof(T));
+  return true;
+}
+
+bool writeCookedMesh(const GltfScene &scene,
+                     const std::filesystem::path &path) {
+  ZoneScoped;
+
+  std::filesystem::path directory =
+      std::filesystem::absolute(path).parent_path();
+
+  std::vector<uint8_t> blob;
+  std::vector<CookedImage> images;
+  images.reserve(scene.imageSources.size());
+  for (const auto &source : scene.imageSources) {
+    // image files aren't copied, the cooked file refers to them
+    std::string imagePath;
+    if (!source.path.empty()) {
+      imagePath =
+          std::filesystem::proximate(source.path, directory).generic_string();
+    }
+
+    CookedImage image = {
+        .nameSize = source.name.size(),
+        .pathSize = imagePath.size(),
+        .dataSize = source.encodedData.size(),
+        .srgb = source.srgb,
+        .pad = 0,
+    };
+    image.nameOffset = appendBytes(blob, source.name.data(), image.nameSize);
+    image.pathOffset = appendBytes(blob, imagePath.data(), image.pathSize);
+    image.dataOffset =
+        appendBytes(blob, source.encodedData.data(), image.dataSize);
+    images.push_back(image);
+  }
+
+  std::vector<CookedTexture> textures;
+  textures.reserve(scene.textureSources.size());
+  for (const auto &source : scene.textureSources) {
+    textures.push_back({
+        .imageIndex = source.imageIndex,
+        .samplerIndex = source.samplerIndex,
+        .normal = source.normal,
+    });
+  }
+
+  CookedMeshHeader header = {
+      .magic = COOKED_MESH_MAGIC,
+      .version = COOKED_MESH_VERSION,
+  };
+
+  std::vector<uint8_t> fileData(sizeof(header));
+  header.indices = appendSection(fileData, scene.indices);
+  header.positions = appendSection(fileData, scene.positions);
+  header.normals = appendSection(fileData, scene.normals);
+  header.tangents = appendSection(fileData, scene.tangents);
+  header.uvs = appendSection(fileData, scene.uvs);
+  header.materials = appendSection(fileData, scene.materials);
+  header.meshDraws = appendSection(fileData, scene.meshDraws);
+  header.transforms = appendSection(fileData, scene.transforms);
+  header.samplers = appendSection(fileData, scene.samplerCIs);
+  header.textures = appendSection(fileData, textures);
+  header.images = appendSection(fileData, images);
+  header.blob = appendSection(fileData, blob);
+  memcpy(fileData.data(), &header, sizeof(header));
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    spdlog::error("CookedMesh: Failed to open {} for writing", path.string());
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(fileData.data()),
+             fileData.size());
+
+  return file.good();
+}
+
+bool readCookedMesh(const std::filesystem::path &path, GltfScene &scene) {
+  ZoneScoped;
+
+  MappedFile file;
+  if (!file.open(path)) {
+    return false;
+  }
+
+  CookedMeshHeader header;
+  if (file.size < sizeof(header)) {
+    spdlog::error("CookedMesh: {} is truncated", path.string());
+    return false;
+  }
+  memcpy(&header, file.data, sizeof(header));
+
+  if (header.magic != COOKED_MESH_MAGIC ||
+      header.version != COOKED_MESH_VERSION) {
+    spdlog::error("CookedMesh: {} isn't a cooked mesh of this version",
+                  path.string());
+    return false;
+  }
+
+  // read into a scene of its own so a bad file leaves scene untouched
+  GltfScene cooked;
+  std::vector<CookedTexture> textures;
+  std::vector<CookedImage> images;
+  if (!readSection(file, header.indices, cooked.indices) ||
+      !readSection(file, header.positions, cooked.positions) ||
+      !readSection(file, header.normals, cooked.normals) ||
+      !readSection(file, header.tangents, cooked.tangents) ||
+      !readSection(file, header.uvs, cooked.uvs) ||
+      !readSection(file, header.materials, cooked.materials) ||
+      !readSection(file, header.meshDraws, cooked.meshDraws) ||
+      !readSection(file, header.transforms, cooked.transforms) ||
+      !readSection(file, header.samplers, cooked.samplerCIs) ||
+      !readSection(file, header.textures, textures) ||
+      !readSection(file, header.images, images) ||
+      !inRange(header.blob.offset, header.blob.size, file.size)) {
+    spdlog::error("CookedMesh: {} has an invalid section", path.string());
+    return false;
+  }
+
+  cooked.textureSources.reserve(textures.size());
+  for (const auto &texture : textures) {
+    cooked.textureSources.push_back({
+        .imageIndex = texture.imageIndex,
+        .samplerIndex = texture.samplerIndex,
+        .normal = texture.normal != 0,
+    });
+  }
+
+  // embedded images are copied straight out of the mapping
+  const uint8_t *blob = file.data + header.blob.offset;
+  const char *blobChars = reinterpret_cast<const char *>(blob);
+  std::filesystem::path directory = path.parent_path();
+  cooked.imageSources.resize(images.size());
+  for (size_t i = 0; i < images.size(); i++) {
+    const CookedImage &image = images[i];
+    if (!inRange(image.nameOffset, image.nameSize, header.blob.size) ||
+        !inRange(image.pathOffset, image.pathSize, header.blob.size) ||
+        !inRange(image.dataOffset, image.dataSize, header.blob.size)) {
+      spdlog::error("CookedMesh: {} has an invalid image", path.string());
+      return false;
+    }
+
+    GltfImageSource &source = cooked.imageSources[i];
+    source.name.assign(blobChars + image.nameOffset, image.nameSize);
+    if (image.pathSize > 0) {
+      source.path = directory / std::string(blobChars + image.pathOffset,
+                                            image.pathSize);
+    }
+    source.encodedData.assign(blob + image.dataOffset,
+                              blob + image.dataOffset + image.dataSize);
+    source.srgb = image.srgb != 0;
+  }
+
+  scene.indices = std::move(cooked.indices);
+  scene.positions = std::move(cooked.positions);
+  scene.normals = std::move(cooked.normals);
+  scene.tangents = std::move(cooked.tangents);
+  scene.uvs = std::move(cooked.uvs);
+  scene.materials = std::move(cooked.materials);
+  scene.meshDraws = std::move(cooked.meshDraws);
+  scene.transforms = std::move(cooked.transforms);
+  scene.samplerCIs = std::move(cooked.samplerCIs);
+  scene.textureSources = std::move(cooked.textureSources);
+  scene.imageSources = std::move(cooked.imageSources);
+
+  return true;
+}
+} // namespace Flare
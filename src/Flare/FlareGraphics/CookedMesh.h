@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+namespace Flare {
+struct GltfScene;
+
+static constexpr uint32_t COOKED_MESH_MAGIC = 0x48534d46; // "FMSH"
+// bump when a stored struct changes layout without changing size
+static constexpr uint32_t COOKED_MESH_VERSION = 2;
+static constexpr const char *COOKED_MESH_EXTENSION = ".flaremesh";
+// sections start at multiples of this so the mapped arrays are aligned
+static constexpr uint64_t COOKED_MESH_ALIGNMENT = 16;
+
+// bytes from the start of the file. elementSize is sizeof the stored type
+// when the file was written, a build where it differs rejects the file
+struct CookedMeshRange {
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  uint64_t elementSize = 0;
+};
+
+// file layout: header, then each section. arrays are stored exactly as the
+// scene holds them after loading a gltf, so reading is a copy per section
+struct CookedMeshHeader {
+  uint32_t magic;
+  uint32_t version;
+  CookedMeshRange indices;
+  CookedMeshRange positions;
+  CookedMeshRange normals;
+  CookedMeshRange tangents;
+  CookedMeshRange uvs;
+  CookedMeshRange materials;
+  CookedMeshRange meshDraws;
+  CookedMeshRange transforms;
+  CookedMeshRange samplers;
+  CookedMeshRange textures;
+  CookedMeshRange images;
+  // image names, paths and embedded image data
+  CookedMeshRange blob;
+};
+
+// offsets are from the start of the blob, paths are relative to the cooked
+// file
+struct CookedImage {
+  uint64_t nameOffset;
+  uint64_t nameSize;
+  uint64_t pathOffset;
+  uint64_t pathSize;
+  uint64_t dataOffset;
+  uint64_t dataSize;
+  uint32_t srgb;
+  uint32_t pad;
+};
+
+struct CookedTexture {
+  uint32_t imageIndex;
+  uint32_t samplerIndex;
+  uint32_t normal;
+};
+
+// writes a scene filled by GltfScene::loadGltf
+bool writeCookedMesh(const GltfScene &scene, const std::filesystem::path &path);
+
+// fills the same cpu side data as GltfScene::loadGltf
+bool readCookedMesh(const std::filesystem::path &path, GltfScene &scene);
+} // namespace Flare
@@ -4,7 +4,9 @@
 #extension GL_GOOGLE_include_directive : enable
 
 #include "CoreShaders/BindlessCommon.glsl"
+#include "CoreShaders/QuantizedVertex.glsl"
 
+// decoded in main with QUANTIZED_VERTICES
 layout (location = 0) in vec4 inPos;
 layout (location = 1) in vec2 inUV;
 layout (location = 2) in vec4 inNormal;
@@ -28,6 +30,7 @@ void main() {
     const uint indirectDrawDataBufferIndex = pc.data0;
     const uint transformBufferIndex = pc.data1;
     const uint materialBufferIndex = pc.data2;
+    const uint boundsBufferIndex = pc.data4;
 
     GBufferUniforms uniforms = gBufferUniforms[pc.uniformOffset].uniforms;
 
@@ -35,15 +38,25 @@ void main() {
 
     mat4 transform = transformAlias[transformBufferIndex].transforms[dd.transformOffset];
 
-    vec4 pos = transform * inPos;
+    vec4 localPos = inPos;
+    vec3 localNormal = inNormal.xyz;
+    vec4 localTangent = inTangent;
+    if (QUANTIZED_VERTICES) {
+        Bounds bounds = boundsAlias[boundsBufferIndex].bounds[dd.transformOffset];
+        localPos = vec4(decodePosition(inPos.xyz, bounds), 1.0);
+        localNormal = octahedralDecode(inNormal.xy);
+        localTangent = vec4(octahedralDecode(inTangent.xy), inPos.w);
+    }
+
+    vec4 pos = transform * localPos;
 
     outClipSpacePos = uniforms.viewProjection * pos;
     outPrevClipSpacePos = uniforms.prevViewProjection * pos;
     outModelSpacePos = pos.xyz;
     gl_Position = outClipSpacePos;
 
-    vec3 normal = normalize(mat3(transpose(inverse(transform))) * inNormal.xyz);
-    vec4 tangent = normalize(transform * inTangent);
+    vec3 normal = normalize(mat3(transpose(inverse(transform))) * localNormal);
+    vec4 tangent = normalize(transform * localTangent);
     vec3 bitangent = normalize(cross(normal, tangent.xyz) * tangent.w);
     outTBN = mat3(tangent.xyz, bitangent, normal);
 
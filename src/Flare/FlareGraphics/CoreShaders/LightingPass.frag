@@ -27,6 +27,12 @@ layout (set = 0, binding = 0) uniform LightingPassUniformBuffer {
     LightingPassUniform uniforms;
 } lightingPassUniformAlias[];
 
+// set by LightingPass, the loops below are unrolled and the shadow lookups
+// removed when shadows are off
+layout (constant_id = 0) const int PCF_RANGE = 1;
+layout (constant_id = 1) const float PCF_SCALE = 1.5;
+layout (constant_id = 2) const bool SHADOWS = true;
+
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outColor;
@@ -100,16 +106,14 @@ float shadowCalculation(vec4 fragPosLightSpace, vec2 off, uint shadowDepthTextur
 float filterPCF(vec4 fragPosLightSpace, uint shadowDepthTextureIndex, uint shadowSamplerIndex) {
     ivec2 texDim = textureSize(globalTextures[nonuniformEXT(shadowDepthTextureIndex)], 0);
 
-    float scale = 1.5;
-    float dx = scale * 1.0 / float(texDim.x);
-    float dy = scale * 1.0 / float(texDim.y);
+    float dx = PCF_SCALE * 1.0 / float(texDim.x);
+    float dy = PCF_SCALE * 1.0 / float(texDim.y);
 
     float shadowFactor = 0.0;
     int count = 0;
-    int range = 1;
 
-    for (int x = -range; x <= range; x++) {
-        for (int y = -range; y <= range; y++) {
+    for (int x = -PCF_RANGE; x <= PCF_RANGE; x++) {
+        for (int y = -PCF_RANGE; y <= PCF_RANGE; y++) {
             shadowFactor += shadowCalculation(fragPosLightSpace, vec2(dx*x, dy*y), shadowDepthTextureIndex, shadowSamplerIndex);
             count++;
         }
@@ -223,7 +227,10 @@ void main() {
 
     vec4 fragLightSpace = light.lightViewProjection * vec4(worldPos, 1.0);
 
-    float shadow = filterPCF(fragLightSpace, shadowMapIndex, shadowSamplerIndex);
+    float shadow = 1.0;
+    if (SHADOWS) {
+        shadow = filterPCF(fragLightSpace, shadowMapIndex, shadowSamplerIndex);
+    }
 
     vec3 color = NoL * (diffuseContrib + specularContrib) * shadow;
 
@@ -0,0 +1,30 @@
+#ifndef SHADER_QUANTIZED_VERTEX_GLSL
+#define SHADER_QUANTIZED_VERTEX_GLSL
+
+#include "CoreShaders/BindlessCommon.glsl"
+#include "CoreShaders/NormalEncoding.glsl"
+
+// set when ModelManager uploads QuantizedVertices. positions are snorm relative
+// to the draw bounds with the tangent sign in w, normals and tangents are
+// octahedral snorm and uvs are half floats
+layout (constant_id = 0) const bool QUANTIZED_VERTICES = false;
+
+layout (set = 1, binding = 0) readonly buffer QuantizedPositionBuffer {
+    uvec2 positions[];
+} quantizedPositionAlias[];
+
+// per draw, indexed by IndirectDrawData.transformOffset
+layout (set = 1, binding = 0) readonly buffer BoundsBuffer {
+    Bounds bounds[];
+} boundsAlias[];
+
+vec3 decodePosition(vec3 quantized, Bounds bounds) {
+    return bounds.origin + quantized * abs(bounds.extents);
+}
+
+// xyz is the position, w the tangent sign
+vec4 unpackQuantizedPosition(uvec2 packedPosition) {
+    return vec4(unpackSnorm2x16(packedPosition.x), unpackSnorm2x16(packedPosition.y));
+}
+
+#endif
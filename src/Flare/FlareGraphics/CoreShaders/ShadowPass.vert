@@ -3,18 +3,27 @@
 #extension GL_GOOGLE_include_directive : enable
 
 #include "CoreShaders/BindlessCommon.glsl"
+#include "CoreShaders/QuantizedVertex.glsl"
 
 void main() {
     const uint indirectDrawDataBufferIndex = pc.data0;
     const uint positionBufferIndex = pc.data1;
     const uint transformBufferIndex = pc.data2;
     const uint lightBufferIndex = pc.data3;
+    const uint boundsBufferIndex = pc.data4;
 
     IndirectDrawData dd = indirectDrawDataAlias[indirectDrawDataBufferIndex].indirectDrawDatas[gl_DrawID];
     Light light = lightAlias[lightBufferIndex].light;
 
     mat4 transform = transformAlias[transformBufferIndex].transforms[dd.transformOffset];
-    vec4 position = positionAlias[positionBufferIndex].positions[gl_VertexIndex];
+    vec4 position;
+    if (QUANTIZED_VERTICES) {
+        uvec2 packedPosition = quantizedPositionAlias[positionBufferIndex].positions[gl_VertexIndex];
+        Bounds bounds = boundsAlias[boundsBufferIndex].bounds[dd.transformOffset];
+        position = vec4(decodePosition(unpackQuantizedPosition(packedPosition).xyz, bounds), 1.0);
+    } else {
+        position = positionAlias[positionBufferIndex].positions[gl_VertexIndex];
+    }
 
     gl_Position = light.lightViewProjection * transform * position;
 }
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "GltfScene.h"
 #include "CalcTangent.h"
+#include "CookedMesh.h"
 #include "GpuDevice.h"
 #include "VkHelper.h"
-#include <stb_image.h>
+#include <tracy/Tracy.hpp>
 
 #define GLM_SWIZZLE
 
@@ -10,27 +11,216 @@
 #include "glm/gtc/type_ptr.hpp"
 
 namespace Flare {
+static void loadPrimitive(const cgltf_data *data,
+                          const cgltf_primitive &primitive,
+                          uint32_t defaultMaterialOffset,
+                          ThreadPool *threadPool,
+                          GltfMeshPrimitive &meshPrimitive) {
+  if (primitive.material) {
+    meshPrimitive.materialOffset = primitive.material - data->materials;
+  } else {
+    meshPrimitive.materialOffset = defaultMaterialOffset;
+  }
+
+  if (primitive.indices) {
+    cgltf_accessor &accessor = *primitive.indices;
+    meshPrimitive.indices.resize(accessor.count);
+
+    cgltf_buffer_view &bufferView = *accessor.buffer_view;
+    size_t offset = accessor.offset + bufferView.offset;
+    const uint8_t *bufferData =
+        static_cast<uint8_t *>(bufferView.buffer->data) + offset;
+
+    switch (cgltf_component_size(accessor.component_type)) {
+    case 4: {
+      for (size_t index = 0; index < accessor.count; index++) {
+        meshPrimitive.indices[index] =
+            reinterpret_cast<const uint32_t *>(bufferData)[index];
+      }
+      break;
+    }
+    case 2: {
+      for (size_t index = 0; index < accessor.count; index++) {
+        meshPrimitive.indices[index] =
+            reinterpret_cast<const uint16_t *>(bufferData)[index];
+      }
+      break;
+    }
+    case 1: {
+      for (size_t index = 0; index < accessor.count; index++) {
+        meshPrimitive.indices[index] =
+            reinterpret_cast<const uint8_t *>(bufferData)[index];
+      }
+      break;
+    }
+    default:
+      spdlog::error("invalid primitive index component type");
+      break;
+    }
+  }
+
+  bool hasNormal = false;
+  bool hasUV = false;
+  bool hasTangent = false;
+
+  for (size_t attr_i = 0; attr_i < primitive.attributes_count; attr_i++) {
+    cgltf_attribute &attribute = primitive.attributes[attr_i];
+
+    cgltf_accessor &accessor = *attribute.data;
+    cgltf_buffer_view &bufferView = *accessor.buffer_view;
+    size_t offset = accessor.offset + bufferView.offset;
+    const uint8_t *bufferData =
+        static_cast<uint8_t *>(bufferView.buffer->data) + offset;
+
+    switch (attribute.type) {
+    case cgltf_attribute_type_position: { // float3, convert to vec of
+                                          // float4
+      meshPrimitive.positions.resize(accessor.count);
+      const float *positionBuffer =
+          reinterpret_cast<const float *>(bufferData);
+
+      glm::vec3 aabbMin(FLT_MAX, FLT_MAX, FLT_MAX);
+      glm::vec3 aabbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+      for (size_t pos_i = 0; pos_i < accessor.count; pos_i++) {
+        const float *pos = positionBuffer + pos_i * 3;
+        meshPrimitive.positions[pos_i] =
+            glm::vec4(pos[0], pos[1], pos[2], 1.f);
+        aabbMin.x = std::min(aabbMin.x, pos[0]);
+        aabbMax.x = std::max(aabbMax.x, pos[0]);
+        aabbMin.y = std::min(aabbMin.y, pos[1]);
+        aabbMax.y = std::max(aabbMax.y, pos[1]);
+        aabbMin.z = std::min(aabbMin.z, pos[2]);
+        aabbMax.z = std::max(aabbMax.z, pos[2]);
+      }
+
+      meshPrimitive.bounds.origin = (aabbMin + aabbMax) / 2.f;
+      meshPrimitive.bounds.extents = (aabbMin - aabbMax) / 2.f;
+      meshPrimitive.bounds.radius =
+          glm::length(meshPrimitive.bounds.extents);
+
+      break;
+    }
+    case cgltf_attribute_type_normal: { // float3, convert to vec of float4
+      hasNormal = true;
+      meshPrimitive.normals.resize(accessor.count);
+      const float *normalBuffer =
+          reinterpret_cast<const float *>(bufferData);
+
+      for (size_t normal_i = 0; normal_i < accessor.count; normal_i++) {
+        const float *normal = normalBuffer + normal_i * 3;
+        meshPrimitive.normals[normal_i] =
+            glm::vec4(normal[0], normal[1], normal[2], 1.f);
+      }
+      break;
+    }
+    case cgltf_attribute_type_texcoord: { // assume float2
+      hasUV = true;
+      meshPrimitive.uvs.resize(accessor.count);
+      memcpy(meshPrimitive.uvs.data(), bufferData,
+             accessor.count * sizeof(glm::vec2));
+      break;
+    }
+    case cgltf_attribute_type_tangent: {
+      hasTangent = true;
+      meshPrimitive.tangents.resize(accessor.count);
+      memcpy(meshPrimitive.tangents.data(), bufferData,
+             accessor.count * sizeof(glm::vec4));
+      break;
+    }
+      // todo: handle weights and joints stuff for skinning
+    default:
+      break;
+    }
+  }
+
+  if (!hasNormal) {
+    meshPrimitive.normals =
+        std::vector<glm::vec4>(meshPrimitive.positions.size());
+  }
+
+  if (!hasUV) {
+    meshPrimitive.uvs =
+        std::vector<glm::vec2>(meshPrimitive.positions.size());
+  }
+
+  if (!hasTangent) {
+    meshPrimitive.tangents.resize(meshPrimitive.positions.size());
+    CalcTangentData calcTangentData = {
+        .indices = meshPrimitive.indices,
+        .positions = meshPrimitive.positions,
+        .normals = meshPrimitive.normals,
+        .uvs = meshPrimitive.uvs,
+        .tangents = meshPrimitive.tangents,
+    };
+    if (threadPool) {
+      CalcTangent::calculateChunked(calcTangentData, *threadPool);
+    } else {
+      CalcTangent mikktspace;
+      mikktspace.calculate(&calcTangentData);
+    }
+  }
+}
+
 void GltfScene::init(const std::filesystem::path &path, GpuDevice *gpuDevice) {
+  ZoneScoped;
+  std::string pathString = path.string();
+  ZoneText(pathString.c_str(), pathString.size());
+
   gpu = gpuDevice;
   filename = path.stem().string();
 
+  if (path.extension() == COOKED_MESH_EXTENSION) {
+    if (!readCookedMesh(path, *this)) {
+      return;
+    }
+    requestImages();
+  } else if (!loadGltf(path, &gpu->threadPool)) {
+    return;
+  }
+
+  createGpuResources();
+}
+
+bool GltfScene::loadGltf(const std::filesystem::path &path,
+                         ThreadPool *threadPool) {
+  ZoneScoped;
+
   std::filesystem::path directory = path.parent_path();
 
+  cgltf_data *data = nullptr;
   cgltf_options options = {};
   cgltf_result result =
       cgltf_parse_file(&options, path.string().c_str(), &data);
   if (result != cgltf_result_success) {
     spdlog::error("Failed to load gltf file {}", path.string());
-    return;
+    return false;
   }
   cgltf_load_buffers(&options, data, path.string().c_str());
 
-  images.resize(data->images_count);
+  // color textures are stored srgb encoded, their mips are filtered in linear
+  std::vector<bool> srgbImages(data->images_count, false);
+  for (size_t i = 0; i < data->materials_count; i++) {
+    const cgltf_material &material = data->materials[i];
+    for (const cgltf_texture *texture :
+         {material.pbr_metallic_roughness.base_color_texture.texture,
+          material.emissive_texture.texture}) {
+      if (texture && texture->image) {
+        srgbImages[texture->image - data->images] = true;
+      }
+    }
+  }
+
+  imageSources.resize(data->images_count);
   for (size_t i = 0; i < data->images_count; i++) {
     const cgltf_image *cgltfImage = &data->images[i];
     const char *uri = cgltfImage->uri;
 
-    int width, height, channelCount;
+    GltfImageSource &source = imageSources[i];
+    source.srgb = srgbImages[i];
+    if (cgltfImage->name) {
+      source.name = cgltfImage->name;
+    }
 
     if (uri) {
       if (strncmp(uri, "data:", 5) == 0) {
@@ -54,94 +244,39 @@ void GltfScene::init(const std::filesystem::path &path, GpuDevice *gpuDevice) {
                                        base64,
                                        &imageData) != cgltf_result_success) {
             spdlog::error("Failed to parse base64 image uri");
-          } else {
-            unsigned char *stbData = stbi_load_from_memory(
-                static_cast<const unsigned char *>(imageData),
-                static_cast<int>(decodedBinarySize), &width, &height,
-                &channelCount, STBI_rgb_alpha);
-
-            TextureCI textureCI = {
-                .initialData = stbData,
-                .width = static_cast<uint32_t>(width),
-                .height = static_cast<uint32_t>(height),
-                .depth = 1,
-                .format = VK_FORMAT_R8G8B8A8_UNORM,
-                .type = VK_IMAGE_TYPE_2D,
-                .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                .genMips = true,
-            };
-            if (cgltfImage->name) {
-              textureCI.name = cgltfImage->name;
-            }
-
-            images[i] = gpu->createTexture(textureCI);
-            free(stbData);
-
-            free(imageData);
+            continue;
           }
+
+          const unsigned char *bytes =
+              static_cast<const unsigned char *>(imageData);
+          source.encodedData.assign(bytes, bytes + decodedBinarySize);
+          free(imageData);
         } else {
           spdlog::error("Invalid embedded image uri");
+          continue;
         }
       } else {
-        std::filesystem::path imageFile = directory / uri;
-
-        unsigned char *stbData =
-            stbi_load(imageFile.string().c_str(), &width, &height,
-                      &channelCount, STBI_rgb_alpha);
-
-        TextureCI textureCI = {
-            .initialData = stbData,
-            .width = static_cast<uint32_t>(width),
-            .height = static_cast<uint32_t>(height),
-            .depth = 1,
-            .format = VK_FORMAT_R8G8B8A8_UNORM,
-            .type = VK_IMAGE_TYPE_2D,
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .genMips = true,
-        };
-        if (cgltfImage->name) {
-          textureCI.name = cgltfImage->name;
-        }
-
-        images[i] = gpu->createTexture(textureCI);
-        free(stbData);
+        source.path = directory / uri;
       }
     } else {
-      // image from buffer
+      // image from buffer, copied since the cgltf data is freed after loading
       cgltf_buffer_view &bufferView = *cgltfImage->buffer_view;
       const uint8_t *bufferData =
           static_cast<uint8_t *>(bufferView.buffer->data) + bufferView.offset;
-
-      unsigned char *stbData =
-          stbi_load_from_memory(static_cast<const unsigned char *>(bufferData),
-                                static_cast<int>(bufferView.size), &width,
-                                &height, &channelCount, STBI_rgb_alpha);
-
-      TextureCI textureCI = {
-          .initialData = stbData,
-          .width = static_cast<uint32_t>(width),
-          .height = static_cast<uint32_t>(height),
-          .depth = 1,
-          .format = VK_FORMAT_R8G8B8A8_UNORM,
-          .type = VK_IMAGE_TYPE_2D,
-          .viewType = VK_IMAGE_VIEW_TYPE_2D,
-          .genMips = true,
-      };
-      if (cgltfImage->name) {
-        textureCI.name = cgltfImage->name;
-      }
-
-      images[i] = gpu->createTexture(textureCI);
-
-      free(stbData);
+      source.encodedData.assign(bufferData, bufferData + bufferView.size);
     }
   }
 
-  samplers.resize(data->samplers_count);
+  // the cooker has no device and keeps the sources
+  if (gpu) {
+    requestImages();
+  }
+
+  samplerCIs.resize(data->samplers_count);
   for (size_t i = 0; i < data->samplers_count; i++) {
     cgltf_sampler &sampler = data->samplers[i];
 
-    SamplerCI ci = {
+    samplerCIs[i] = {
         .minFilter = VkHelper::extractGltfMinFilter(sampler.min_filter),
         .magFilter = VkHelper::extractGltfMagFilter(sampler.mag_filter),
         .mipFilter = VkHelper::extractGltfMipmapMode(sampler.min_filter),
@@ -149,8 +284,24 @@ void GltfScene::init(const std::filesystem::path &path, GpuDevice *gpuDevice) {
         .v = VkHelper::extractGltfWrapMode(sampler.wrap_t),
         .w = VK_SAMPLER_ADDRESS_MODE_REPEAT,
     };
+  }
 
-    samplers[i] = gpu->createSampler(ci);
+  textureSources.resize(data->textures_count);
+  for (size_t i = 0; i < data->textures_count; i++) {
+    cgltf_texture &gltfTexture = data->textures[i];
+    if (gltfTexture.image) {
+      textureSources[i].imageIndex = gltfTexture.image - data->images;
+    }
+    if (gltfTexture.sampler) {
+      textureSources[i].samplerIndex = gltfTexture.sampler - data->samplers;
+    }
+  }
+  for (size_t i = 0; i < data->materials_count; i++) {
+    if (data->materials[i].normal_texture.texture) {
+      textureSources[data->materials[i].normal_texture.texture -
+                     data->textures]
+          .normal = true;
+    }
   }
 
   uint32_t defaultAlbedoOffset =
@@ -164,40 +315,6 @@ void GltfScene::init(const std::filesystem::path &path, GpuDevice *gpuDevice) {
   uint32_t defaultEmissiveOffset =
       data->textures_count - 1 + DEFAULT_EMISSIVE_BASE_OFFSET;
 
-  gltfTextures.resize(data->textures_count +
-                      5); // make space for default textures at end
-
-  gltfTextures[defaultAlbedoOffset] = {gpu->defaultTexture.index,
-                                       gpu->defaultSampler.index};
-  gltfTextures[defaultNormalOffset] = {gpu->defaultNormalTexture.index,
-                                       gpu->defaultSampler.index};
-  gltfTextures[defaultMetallicRoughnessOffset] = {
-      gpu->defaultTexture.index, gpu->defaultSampler.index}; // todo
-  gltfTextures[defaultOcclusionOffset] = {gpu->defaultTexture.index,
-                                          gpu->defaultSampler.index}; // todo
-  gltfTextures[defaultEmissiveOffset] = {gpu->defaultTexture.index,
-                                         gpu->defaultSampler.index}; // todo
-
-  for (size_t i = 0; i < data->textures_count; i++) {
-    cgltf_texture &gltfTexture = data->textures[i];
-
-    if (gltfTexture.image) {
-      uint32_t textureIndex = gltfTexture.image - data->images;
-      gltfTextures[i].imageIndex = images[textureIndex].index;
-      if (gltfTexture.sampler) {
-        uint32_t samplerIndex = gltfTexture.sampler - data->samplers;
-        gltfTextures[i].samplerIndex = samplers[samplerIndex].index;
-      } else {
-        gltfTextures[i].samplerIndex = gpu->defaultSampler.index;
-      }
-    } else {
-      gltfTextures[i] = {
-          .imageIndex = gpu->defaultTexture.index,
-          .samplerIndex = gpu->defaultSampler.index,
-      };
-    }
-  }
-
   materials.resize(data->materials_count +
                    1); // + 1 for default material at the back
 
@@ -275,160 +392,34 @@ void GltfScene::init(const std::filesystem::path &path, GpuDevice *gpuDevice) {
     }
   }
 
+  // primitives are independent, they're processed on the thread pool but
+  // stored in gltf order so the output doesn't depend on scheduling
   meshes.resize(data->meshes_count);
-  uint32_t meshPrimitiveId = 0;
+  std::vector<const cgltf_primitive *> primitives;
+  std::vector<GltfMeshPrimitive *> meshPrimitives;
   for (size_t i = 0; i < data->meshes_count; i++) {
     cgltf_mesh &mesh = data->meshes[i];
+    meshes[i].meshPrimitives.resize(mesh.primitives_count);
 
     for (size_t prim_i = 0; prim_i < mesh.primitives_count; prim_i++) {
-      cgltf_primitive &primitive = mesh.primitives[prim_i];
-
-      GltfMeshPrimitive meshPrimitive;
-      meshPrimitive.id = meshPrimitiveId++;
-
-      if (primitive.material) {
-        meshPrimitive.materialOffset = primitive.material - data->materials;
-      } else {
-        meshPrimitive.materialOffset =
-            materials.size() - 1; // default material at the back
-      }
-
-      if (primitive.indices) {
-        cgltf_accessor &accessor = *primitive.indices;
-        meshPrimitive.indices.resize(accessor.count);
-
-        cgltf_buffer_view &bufferView = *accessor.buffer_view;
-        size_t offset = accessor.offset + bufferView.offset;
-        const uint8_t *bufferData =
-            static_cast<uint8_t *>(bufferView.buffer->data) + offset;
-
-        switch (cgltf_component_size(accessor.component_type)) {
-        case 4: {
-          for (size_t index = 0; index < accessor.count; index++) {
-            meshPrimitive.indices[index] =
-                reinterpret_cast<const uint32_t *>(bufferData)[index];
-          }
-          break;
-        }
-        case 2: {
-          for (size_t index = 0; index < accessor.count; index++) {
-            meshPrimitive.indices[index] =
-                reinterpret_cast<const uint16_t *>(bufferData)[index];
-          }
-          break;
-        }
-        case 1: {
-          for (size_t index = 0; index < accessor.count; index++) {
-            meshPrimitive.indices[index] =
-                reinterpret_cast<const uint8_t *>(bufferData)[index];
-          }
-          break;
-        }
-        default:
-          spdlog::error("invalid primitive index component type");
-          break;
-        }
-      }
-
-      bool hasNormal = false;
-      bool hasUV = false;
-      bool hasTangent = false;
-
-      for (size_t attr_i = 0; attr_i < primitive.attributes_count; attr_i++) {
-        cgltf_attribute &attribute = primitive.attributes[attr_i];
-
-        cgltf_accessor &accessor = *attribute.data;
-        cgltf_buffer_view &bufferView = *accessor.buffer_view;
-        size_t offset = accessor.offset + bufferView.offset;
-        const uint8_t *bufferData =
-            static_cast<uint8_t *>(bufferView.buffer->data) + offset;
-
-        switch (attribute.type) {
-        case cgltf_attribute_type_position: { // float3, convert to vec of
-                                              // float4
-          meshPrimitive.positions.resize(accessor.count);
-          const float *positionBuffer =
-              reinterpret_cast<const float *>(bufferData);
-
-          glm::vec3 aabbMin(FLT_MAX, FLT_MAX, FLT_MAX);
-          glm::vec3 aabbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-
-          for (size_t pos_i = 0; pos_i < accessor.count; pos_i++) {
-            const float *pos = positionBuffer + pos_i * 3;
-            meshPrimitive.positions[pos_i] =
-                glm::vec4(pos[0], pos[1], pos[2], 1.f);
-            aabbMin.x = std::min(aabbMin.x, pos[0]);
-            aabbMax.x = std::max(aabbMax.x, pos[0]);
-            aabbMin.y = std::min(aabbMin.y, pos[1]);
-            aabbMax.y = std::max(aabbMax.y, pos[1]);
-            aabbMin.z = std::min(aabbMin.z, pos[2]);
-            aabbMax.z = std::max(aabbMax.z, pos[2]);
-          }
-
-          meshPrimitive.bounds.origin = (aabbMin + aabbMax) / 2.f;
-          meshPrimitive.bounds.extents = (aabbMin - aabbMax) / 2.f;
-          meshPrimitive.bounds.radius =
-              glm::length(meshPrimitive.bounds.extents);
-
-          break;
-        }
-        case cgltf_attribute_type_normal: { // float3, convert to vec of float4
-          hasNormal = true;
-          meshPrimitive.normals.resize(accessor.count);
-          const float *normalBuffer =
-              reinterpret_cast<const float *>(bufferData);
-
-          for (size_t normal_i = 0; normal_i < accessor.count; normal_i++) {
-            const float *normal = normalBuffer + normal_i * 3;
-            meshPrimitive.normals[normal_i] =
-                glm::vec4(normal[0], normal[1], normal[2], 1.f);
-          }
-          break;
-        }
-        case cgltf_attribute_type_texcoord: { // assume float2
-          hasUV = true;
-          meshPrimitive.uvs.resize(accessor.count);
-          memcpy(meshPrimitive.uvs.data(), bufferData,
-                 accessor.count * sizeof(glm::vec2));
-          break;
-        }
-        case cgltf_attribute_type_tangent: {
-          hasTangent = true;
-          meshPrimitive.tangents.resize(accessor.count);
-          memcpy(meshPrimitive.tangents.data(), bufferData,
-                 accessor.count * sizeof(glm::vec4));
-          break;
-        }
-          // todo: handle weights and joints stuff for skinning
-        default:
-          break;
-        }
-      }
-
-      if (!hasNormal) {
-        meshPrimitive.normals =
-            std::vector<glm::vec4>(meshPrimitive.positions.size());
-      }
-
-      if (!hasUV) {
-        meshPrimitive.uvs =
-            std::vector<glm::vec2>(meshPrimitive.positions.size());
-      }
-
-      if (!hasTangent) {
-        meshPrimitive.tangents.resize(meshPrimitive.positions.size());
-        CalcTangent mikktspace;
-        CalcTangentData calcTangentData = {
-            .indices = meshPrimitive.indices,
-            .positions = meshPrimitive.positions,
-            .normals = meshPrimitive.normals,
-            .uvs = meshPrimitive.uvs,
-            .tangents = meshPrimitive.tangents,
-        };
-        mikktspace.calculate(&calcTangentData);
-      }
+      GltfMeshPrimitive &meshPrimitive = meshes[i].meshPrimitives[prim_i];
+      meshPrimitive.id = meshPrimitives.size();
+      primitives.push_back(&mesh.primitives[prim_i]);
+      meshPrimitives.push_back(&meshPrimitive);
+    }
+  }
 
-      meshes[i].meshPrimitives.push_back(meshPrimitive);
+  // default material at the back
+  uint32_t defaultMaterialOffset = materials.size() - 1;
+  auto processPrimitive = [&](size_t i) {
+    loadPrimitive(data, *primitives[i], defaultMaterialOffset, threadPool,
+                  *meshPrimitives[i]);
+  };
+  if (threadPool) {
+    threadPool->parallelFor(primitives.size(), processPrimitive);
+  } else {
+    for (size_t i = 0; i < primitives.size(); i++) {
+      processPrimitive(i);
     }
   }
 
@@ -467,15 +458,109 @@ void GltfScene::init(const std::filesystem::path &path, GpuDevice *gpuDevice) {
   }
 
   meshDraws = generateMeshDraws();
+
+  cgltf_free(data);
+
+  return true;
 }
 
-void GltfScene::shutdown() {
-  if (data) {
-    cgltf_free(data);
+void GltfScene::requestImages() {
+  // decoded concurrently on the async loader's workers
+  alive = std::make_shared<bool>(true);
+
+  images.resize(imageSources.size());
+  for (size_t i = 0; i < imageSources.size(); i++) {
+    GltfImageSource &source = imageSources[i];
+    if (source.path.empty() && source.encodedData.empty()) {
+      continue; // failed to load
+    }
+
+    TextureRequest request = {
+        .path = source.path,
+        // not needed once the request is made
+        .encodedData = std::move(source.encodedData),
+        .ci =
+            {
+                .depth = 1,
+                .format = VK_FORMAT_R8G8B8A8_UNORM,
+                .type = VK_IMAGE_TYPE_2D,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .name = source.name,
+                .genMips = true,
+                .srgb = source.srgb,
+            },
+    };
+
+    request.onLoaded = [this, gpuDevice = gpu,
+                        aliveToken = std::weak_ptr<bool>(alive),
+                        i](Handle<Texture> handle) {
+      if (aliveToken.expired()) {
+        // the scene was shut down while the image was in flight
+        gpuDevice->destroyTextureDeferred(handle);
+        return;
+      }
+
+      images[i] = handle;
+      for (size_t textureIndex = 0; textureIndex < textureSources.size();
+           textureIndex++) {
+        if (textureSources[textureIndex].imageIndex == i) {
+          gltfTextures[textureIndex].imageIndex = handle.index;
+        }
+      }
+      texturesVersion++;
+    };
+
+    gpu->asyncLoader.requestTexture(std::move(request));
+  }
+}
+
+void GltfScene::createGpuResources() {
+  samplers.resize(samplerCIs.size());
+  for (size_t i = 0; i < samplerCIs.size(); i++) {
+    samplers[i] = gpu->createSampler(samplerCIs[i]);
+  }
+
+  uint32_t defaultOffset = textureSources.size() - 1;
+  gltfTextures.resize(textureSources.size() +
+                      5); // make space for default textures at end
+
+  gltfTextures[defaultOffset + DEFAULT_ALBEDO_BASE_OFFSET] = {
+      gpu->defaultTexture.index, gpu->defaultSampler.index};
+  gltfTextures[defaultOffset + DEFAULT_NORMAL_BASE_OFFSET] = {
+      gpu->defaultNormalTexture.index, gpu->defaultSampler.index};
+  gltfTextures[defaultOffset + DEFAULT_METALLIC_ROUGHNESS_BASE_OFFSET] = {
+      gpu->defaultTexture.index, gpu->defaultSampler.index}; // todo
+  gltfTextures[defaultOffset + DEFAULT_OCCLUSION_BASE_OFFSET] = {
+      gpu->defaultTexture.index, gpu->defaultSampler.index}; // todo
+  gltfTextures[defaultOffset + DEFAULT_EMISSIVE_BASE_OFFSET] = {
+      gpu->defaultTexture.index, gpu->defaultSampler.index}; // todo
+
+  // textures sample the default textures until their image is resident
+  for (size_t i = 0; i < textureSources.size(); i++) {
+    const GltfTextureSource &source = textureSources[i];
+    gltfTextures[i] = {
+        .imageIndex = source.normal ? gpu->defaultNormalTexture.index
+                                    : gpu->defaultTexture.index,
+        .samplerIndex = source.samplerIndex != invalidIndex
+                            ? samplers[source.samplerIndex].index
+                            : gpu->defaultSampler.index,
+    };
+    if (source.imageIndex == invalidIndex) {
+      gltfTextures[i].imageIndex = gpu->defaultTexture.index;
+    } else if (images[source.imageIndex].isValid()) {
+      gltfTextures[i].imageIndex = images[source.imageIndex].index;
+    }
   }
+}
+
+void GltfScene::shutdown() {
+  // images still in flight are destroyed by their callback
+  alive.reset();
 
   for (auto &handle : images) {
-    gpu->destroyTexture(handle);
+    if (handle.isValid()) {
+      gpu->destroyTexture(handle);
+    }
   }
   for (auto &handle : samplers) {
     gpu->destroySampler(handle);
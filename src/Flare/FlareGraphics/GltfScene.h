@@ -3,6 +3,7 @@
 #include "GpuDevice.h"
 #include <cgltf.h>
 #include <filesystem>
+#include <memory>
 
 #define GLM_ENABLE_EXPERIMENTAL
 
@@ -63,6 +64,23 @@ struct GltfMeshPrimitive {
   Bounds bounds;
 };
 
+// where an image's encoded data comes from, kept apart from the gpu resources
+// so a scene can be cooked without a device
+struct GltfImageSource {
+  std::string name;
+  // decoded from encodedData if it isn't empty, otherwise from path
+  std::filesystem::path path;
+  std::vector<unsigned char> encodedData;
+  bool srgb = false;
+};
+
+struct GltfTextureSource {
+  uint32_t imageIndex = invalidIndex;
+  uint32_t samplerIndex = invalidIndex;
+  // a normal map waiting on its image samples the flat default normal
+  bool normal = false;
+};
+
 struct GltfMesh {
   std::vector<GltfMeshPrimitive> meshPrimitives;
 };
@@ -91,6 +109,8 @@ struct GltfScene {
   std::vector<Handle<Texture>> images;
   std::vector<Handle<Sampler>> samplers;
   std::vector<TextureIndex> gltfTextures;
+  // bumped whenever an image upload lands and gltfTextures changes
+  uint32_t texturesVersion = 0;
 
   std::vector<Node> nodes;
   std::vector<Node *> topLevelNodes;
@@ -105,15 +125,35 @@ struct GltfScene {
 
   std::vector<MeshDraw> meshDraws;
 
+  std::vector<GltfImageSource> imageSources;
+  std::vector<SamplerCI> samplerCIs;
+  std::vector<GltfTextureSource> textureSources;
+
   GpuDevice *gpu = nullptr;
-  cgltf_data *data = nullptr;
 
   std::string filename;
 
+  // upload callbacks hold a weak reference to tell if the scene is gone
+  std::shared_ptr<bool> alive;
+
+  // loads a .gltf, .glb or a cooked .flaremesh
   void init(const std::filesystem::path &path, GpuDevice *gpuDevice);
 
   void shutdown();
 
+  // fills the cpu side data. with a device the images are requested as soon
+  // as they're known, so they decode while the geometry is processed.
+  // primitives are processed on the thread pool if one is given
+  bool loadGltf(const std::filesystem::path &path,
+                ThreadPool *threadPool = nullptr);
+
+  // hands every image source to the async loader, textures are created on
+  // the main thread once decoded
+  void requestImages();
+
+  // creates the samplers and the texture table of the loaded data
+  void createGpuResources();
+
   void generateMeshDrawsFromNode(
       Node *node, std::unordered_map<uint32_t, std::vector<MeshDraw>> &map);
 
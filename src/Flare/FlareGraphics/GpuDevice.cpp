@@ -6,14 +6,22 @@
 #include <GLFW/glfw3.h>
 #include <algorithm>
 #include <cgltf.h>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
 #include <optional>
 #include <spdlog/spdlog.h>
 #include <spirv_cross.hpp>
+#include <tracy/Tracy.hpp>
+#include <type_traits>
 #include <volk.h>
 
+#include "Hash.h"
 #include "VkHelper.h"
 
 namespace Flare {
+static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x46504331; // "FPC1"
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL
 debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
               VkDebugUtilsMessageTypeFlagsEXT type,
@@ -45,14 +53,99 @@ debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
   return VK_FALSE;
 }
 
+template <typename T> static void appendKey(std::string &key, const T &value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// fields are appended one by one since the padding in the CI structs isn't
+// initialized
+static std::string getPipelineKey(const PipelineCI &ci) {
+  std::string key;
+
+  appendKey(key, ci.shaderStages.size());
+  for (const auto &shaderStage : ci.shaderStages) {
+    std::string path = normalizeShaderPath(shaderStage.path);
+    appendKey(key, path.size());
+    key += path;
+    appendKey(key, shaderStage.stage);
+    appendKey(key, shaderStage.specializationConstants.size());
+    for (const auto &constant : shaderStage.specializationConstants) {
+      appendKey(key, constant.id);
+      appendKey(key, constant.value);
+    }
+  }
+
+  appendKey(key, ci.vertexInput.vertexBindings.size());
+  for (const auto &binding : ci.vertexInput.vertexBindings) {
+    appendKey(key, binding.binding);
+    appendKey(key, binding.stride);
+    appendKey(key, binding.inputRate);
+  }
+  appendKey(key, ci.vertexInput.vertexAttributes.size());
+  for (const auto &attribute : ci.vertexInput.vertexAttributes) {
+    appendKey(key, attribute.location);
+    appendKey(key, attribute.binding);
+    appendKey(key, attribute.format);
+    appendKey(key, attribute.offset);
+  }
+
+  appendKey(key, ci.rasterization.cullMode);
+  appendKey(key, ci.rasterization.frontFace);
+  appendKey(key, ci.rasterization.depthBiasEnable);
+  appendKey(key, ci.rasterization.depthBiasConstant);
+  appendKey(key, ci.rasterization.depthBiasSlope);
+
+  appendKey(key, ci.depthStencil.front);
+  appendKey(key, ci.depthStencil.back);
+  appendKey(key, ci.depthStencil.depthCompareOp);
+  appendKey(key, ci.depthStencil.depthTestEnable);
+  appendKey(key, ci.depthStencil.depthWriteEnable);
+  appendKey(key, ci.depthStencil.stencilTestEnable);
+
+  appendKey(key, ci.colorBlend.attachments.size());
+  for (const auto &attachment : ci.colorBlend.attachments) {
+    appendKey(key, attachment.srcColor);
+    appendKey(key, attachment.dstColor);
+    appendKey(key, attachment.colorOp);
+    appendKey(key, attachment.srcAlpha);
+    appendKey(key, attachment.dstAlpha);
+    appendKey(key, attachment.alphaOp);
+    appendKey(key, attachment.enable);
+    appendKey(key, attachment.colorWriteMask);
+  }
+
+  appendKey(key, ci.rendering.colorFormats.size());
+  for (const auto &format : ci.rendering.colorFormats) {
+    appendKey(key, format);
+  }
+  appendKey(key, ci.rendering.depthFormat);
+  appendKey(key, ci.rendering.stencilFormat);
+
+  appendKey(key, ci.topology);
+
+  return key;
+}
+
 void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
   spdlog::info("GpuDevice: Initialize");
 
   // Set window
-  glfwWindow = gpuDeviceCI.glfwWindow;
+  headless = gpuDeviceCI.headless;
+  glfwWindow = headless ? nullptr : gpuDeviceCI.glfwWindow;
+  pipelineCachePath = gpuDeviceCI.pipelineCachePath;
 
   // Shader compiler
-  shaderCompiler.init();
+#ifdef FLARE_SHIPPING
+  shaderCompiler.allowCompile = false;
+#endif
+  shaderCompiler.init(gpuDeviceCI.shaderCachePath,
+                      gpuDeviceCI.shaderArchivePath);
+  // set before any pipeline is created so every pipeline is watched
+  shaderReloader.enabled =
+      gpuDeviceCI.shaderHotReload && shaderCompiler.allowCompile;
+
+  threadPool.init();
 
   // Init resource pools;
   pipelines.init(gpuDeviceCI.resourcePoolCI.pipelines);
@@ -77,12 +170,15 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
       .apiVersion = VK_API_VERSION_1_3,
   };
 
-  uint32_t glfwExtensionsCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
+  std::vector<const char *> enabledInstanceExtensions;
+  if (!headless) {
+    uint32_t glfwExtensionsCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
 
-  std::vector<const char *> enabledInstanceExtensions(
-      glfwExtensions, glfwExtensions + glfwExtensionsCount);
+    enabledInstanceExtensions.assign(glfwExtensions,
+                                     glfwExtensions + glfwExtensionsCount);
+  }
   std::vector<const char *> enabledLayers;
 
 #ifdef ENABLE_VULKAN_VALIDATION
@@ -186,6 +282,9 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
     physicalDevice = discreteGpu;
   } else if (integratedGpu != VK_NULL_HANDLE) {
     physicalDevice = integratedGpu;
+  } else if (gpuCount > 0) {
+    // cpu implementations like lavapipe, for machines without a gpu
+    physicalDevice = physicalDevices[0];
   } else {
     spdlog::error("GpuDevice: Failed to find a suitable gpu");
   }
@@ -246,10 +345,14 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
     spdlog::error("GpuDevice: Failed to find main queue family");
   }
   if (!computeFamilyOpt.has_value()) {
-    spdlog::error("GpuDevice: Failed to find compute queue family");
+    spdlog::warn("GpuDevice: No separate compute queue family, using the main "
+                 "queue");
+    computeFamilyOpt = mainFamilyOpt;
   }
   if (!transferFamilyOpt.has_value()) {
-    spdlog::error("GpuDevice: Failed to find transfer queue family");
+    spdlog::warn("GpuDevice: No separate transfer queue family, using the "
+                 "main queue");
+    transferFamilyOpt = mainFamilyOpt;
   }
 
   mainFamily = mainFamilyOpt.value();
@@ -258,35 +361,23 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
 
   float queuePriority = 1.f;
 
-  VkDeviceQueueCreateInfo mainQueueCI{
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = 0,
-      .queueFamilyIndex = mainFamily,
-      .queueCount = 1,
-      .pQueuePriorities = &queuePriority,
-  };
-
-  VkDeviceQueueCreateInfo computeQueueCI{
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = 0,
-      .queueFamilyIndex = computeFamily,
-      .queueCount = 1,
-      .pQueuePriorities = &queuePriority,
-  };
-
-  VkDeviceQueueCreateInfo transferQueueCI{
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = 0,
-      .queueFamilyIndex = transferFamily,
-      .queueCount = 1,
-      .pQueuePriorities = &queuePriority,
-  };
-
-  std::vector<VkDeviceQueueCreateInfo> queueCI = {mainQueueCI, computeQueueCI,
-                                                  transferQueueCI};
+  // one queue per distinct family, queues sharing a family share the queue
+  std::vector<VkDeviceQueueCreateInfo> queueCI;
+  for (uint32_t family : {mainFamily, computeFamily, transferFamily}) {
+    if (std::any_of(queueCI.begin(), queueCI.end(), [&](const auto &ci) {
+          return ci.queueFamilyIndex == family;
+        })) {
+      continue;
+    }
+    queueCI.push_back({
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queueFamilyIndex = family,
+        .queueCount = 1,
+        .pQueuePriorities = &queuePriority,
+    });
+  }
 
   // device extensions
   uint32_t deviceExtensionCount = 0;
@@ -317,7 +408,7 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
     }
   }
 
-  if (!swapchainExtensionPresent) {
+  if (!swapchainExtensionPresent && !headless) {
     spdlog::error("GpuDevice: Swapchain extension not present");
   }
   if (accelStructExtensionPresent) {
@@ -329,7 +420,9 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
         VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
   }
 
-  enabledDeviceExtensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  if (!headless) {
+    enabledDeviceExtensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
 
   // device features
   VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{
@@ -360,6 +453,7 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
                    : static_cast<void *>(&shaderDrawParamFeatures),
       .drawIndirectCount = VK_TRUE,
       .descriptorIndexing = VK_TRUE,
+      .hostQueryReset = VK_TRUE,
       .timelineSemaphore = VK_TRUE,
       .bufferDeviceAddress = VK_TRUE,
   };
@@ -394,6 +488,8 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
   vkGetDeviceQueue(device, computeFamily, 0, &computeQueue);
   vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
 
+  createPipelineCache();
+
   // vma
   VmaVulkanFunctions vmaFunctions = {
       .vkGetPhysicalDeviceProperties = vkGetPhysicalDeviceProperties,
@@ -434,41 +530,16 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
   createBindlessDescriptorSets(gpuDeviceCI);
 
   // surface and swapchain
-  if (glfwCreateWindowSurface(instance, glfwWindow, nullptr, &surface) !=
-      VK_SUCCESS) {
-    spdlog::error("GpuDevice: Failed to create window surface");
-  }
-
-  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
-                                            &surfaceCapabilities);
-
-  uint32_t surfaceFormatCount;
-  vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface,
-                                       &surfaceFormatCount, nullptr);
-  if (surfaceFormatCount != 0) {
-    surfaceFormats.resize(surfaceFormatCount);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(
-        physicalDevice, surface, &surfaceFormatCount, surfaceFormats.data());
-  }
-
-  uint32_t presentModeCount;
-  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
-                                            &presentModeCount, nullptr);
-  if (presentModeCount != 0) {
-    presentModes.resize(presentModeCount);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(
-        physicalDevice, surface, &presentModeCount, presentModes.data());
-  }
-
-  if (surfaceFormats.empty() || presentModes.empty()) {
-    spdlog::error("GpuDevice: Swapchain not supported");
+  if (headless) {
+    swapchainExtent = gpuDeviceCI.headlessExtent;
+    surfaceFormat = {
+        .format = drawTextureFormat,
+        .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+    };
+  } else {
+    createSurface();
   }
 
-  setSurfaceFormat(VK_FORMAT_B8G8R8A8_SRGB);
-  setPresentMode(VK_PRESENT_MODE_MAILBOX_KHR);
-  setSwapchainExtent();
-  createSwapchain();
-
   createDrawTexture();
 
   VkFenceCreateInfo fenceCI = {
@@ -476,6 +547,9 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
   };
 
   vkCreateFence(device, &fenceCI, nullptr, &immediateFence);
+  for (auto &fence : uploadFences) {
+    vkCreateFence(device, &fenceCI, nullptr, &fence);
+  }
 
   VkSemaphoreCreateInfo semaphoreCI = {
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
@@ -501,6 +575,7 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
   };
   semaphoreCI.pNext = &semaphoreTypeCI;
   vkCreateSemaphore(device, &semaphoreCI, nullptr, &graphicsTimelineSemaphore);
+  vkCreateSemaphore(device, &semaphoreCI, nullptr, &computeTimelineSemaphore);
 
   VkCommandPoolCreateInfo commandPoolCI = {
       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
@@ -531,6 +606,48 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
     }
   }
 
+  if (vkCreateCommandPool(device, &commandPoolCI, nullptr,
+                          &uploadCommandPool) != VK_SUCCESS) {
+    spdlog::error("Failed to create upload command pool");
+  }
+
+  commandAllocInfo.commandPool = uploadCommandPool;
+  commandAllocInfo.commandBufferCount =
+      static_cast<uint32_t>(uploadCommandBuffers.size());
+
+  if (vkAllocateCommandBuffers(device, &commandAllocInfo,
+                               uploadCommandBuffers.data()) != VK_SUCCESS) {
+    spdlog::error("Failed to allocated upload command buffers");
+  }
+  commandAllocInfo.commandBufferCount = 1;
+
+  commandPoolCI.queueFamilyIndex = computeFamily;
+  for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+    if (vkCreateCommandPool(device, &commandPoolCI, nullptr,
+                            &computeCommandPools[i]) != VK_SUCCESS) {
+      spdlog::error("Failed to create compute command pool");
+    }
+
+    commandAllocInfo.commandPool = computeCommandPools[i];
+
+    if (vkAllocateCommandBuffers(device, &commandAllocInfo,
+                                 &computeCommandBuffers[i]) != VK_SUCCESS) {
+      spdlog::error("Failed to allocated compute command buffer");
+    }
+  }
+
+  // one extra for threads outside the pool
+  commandPoolCI.queueFamilyIndex = mainFamily;
+  for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+    threadCommandPools[i].resize(threadPool.workerCount() + 1);
+    for (auto &threadCommandPool : threadCommandPools[i]) {
+      if (vkCreateCommandPool(device, &commandPoolCI, nullptr,
+                              &threadCommandPool.commandPool) != VK_SUCCESS) {
+        spdlog::error("Failed to create thread command pool");
+      }
+    }
+  }
+
   BufferCI stagingBufferCI = {
       .size = STAGING_BUFFER_SIZE_MB * 1024 * 1024,
       .usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -539,35 +656,86 @@ void GpuDevice::init(GpuDeviceCreateInfo &gpuDeviceCI) {
 
   stagingBufferHandle = createBuffer(stagingBufferCI);
 
+  profiler.init(this);
+
+  BufferCI frameStagingBufferCI = {
+      .size = FRAME_STAGING_BUFFER_SIZE_MB * 1024 * 1024,
+      .usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      .mapped = true,
+      .name = "frame staging",
+  };
+
+  for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+    frameStagingBufferHandles[i] = createBuffer(frameStagingBufferCI);
+  }
+
+  // closed by the first frame or whoever records with a pipeline first, the
+  // passes created in between join it
+  beginPipelineBatch();
+  mipGenerator.init(this, gpuDeviceCI.resourcePoolCI.storageTextures,
+                    gpuDeviceCI.bindlessSetup.storageImages);
+
   createDefaultTextures();
+
+  createTracyContexts();
+
+  asyncLoader.init(*this);
+  shaderReloader.init(this);
 }
 
 void GpuDevice::shutdown() {
   vkDeviceWaitIdle(device);
 
+  shaderReloader.shutdown();
+  asyncLoader.shutdown();
+  processDeferredDestructions(true);
+  mipGenerator.shutdown();
+
   shaderCompiler.shutdown();
+  threadPool.shutdown();
+  shaderModules.clear();
 
   destroyDefaultTextures();
   destroyBuffer(stagingBufferHandle);
+  for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+    destroyBuffer(frameStagingBufferHandles[i]);
+  }
 
   destroyBindlessDescriptorSets();
 
+  vkDestroyCommandPool(device, uploadCommandPool, nullptr);
   for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
     vkDestroyCommandPool(device, commandPools[i], nullptr);
+    vkDestroyCommandPool(device, computeCommandPools[i], nullptr);
+    for (auto &threadCommandPool : threadCommandPools[i]) {
+      vkDestroyCommandPool(device, threadCommandPool.commandPool, nullptr);
+    }
   }
 
+  destroyPipelineCache();
+  profiler.shutdown();
+  destroyTracyContexts();
+
   vkDestroyFence(device, immediateFence, nullptr);
+  for (auto &fence : uploadFences) {
+    vkDestroyFence(device, fence, nullptr);
+  }
   vkDestroySemaphore(device, graphicsTimelineSemaphore, nullptr);
+  vkDestroySemaphore(device, computeTimelineSemaphore, nullptr);
   for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(device, imageAcquiredSemaphores[i], nullptr);
     vkDestroySemaphore(device, renderCompletedSemaphores[i], nullptr);
   }
 
   destroyDrawTexture();
-  destroySwapchain();
+  if (!headless) {
+    destroySwapchain();
+  }
   vmaDestroyAllocator(allocator);
   vkDestroyDevice(device, nullptr);
-  vkDestroySurfaceKHR(instance, surface, nullptr);
+  if (!headless) {
+    vkDestroySurfaceKHR(instance, surface, nullptr);
+  }
 #ifdef ENABLE_VULKAN_VALIDATION
   vkDestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 #endif
@@ -575,6 +743,43 @@ void GpuDevice::shutdown() {
   spdlog::info("GpuDevice: Shutdown");
 }
 
+void GpuDevice::createSurface() {
+  if (glfwCreateWindowSurface(instance, glfwWindow, nullptr, &surface) !=
+      VK_SUCCESS) {
+    spdlog::error("GpuDevice: Failed to create window surface");
+  }
+
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
+                                            &surfaceCapabilities);
+
+  uint32_t surfaceFormatCount;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface,
+                                       &surfaceFormatCount, nullptr);
+  if (surfaceFormatCount != 0) {
+    surfaceFormats.resize(surfaceFormatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(
+        physicalDevice, surface, &surfaceFormatCount, surfaceFormats.data());
+  }
+
+  uint32_t presentModeCount;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
+                                            &presentModeCount, nullptr);
+  if (presentModeCount != 0) {
+    presentModes.resize(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(
+        physicalDevice, surface, &presentModeCount, presentModes.data());
+  }
+
+  if (surfaceFormats.empty() || presentModes.empty()) {
+    spdlog::error("GpuDevice: Swapchain not supported");
+  }
+
+  setSurfaceFormat(VK_FORMAT_B8G8R8A8_SRGB);
+  setPresentMode(VK_PRESENT_MODE_MAILBOX_KHR);
+  setSwapchainExtent();
+  createSwapchain();
+}
+
 void GpuDevice::setSurfaceFormat(VkFormat format) {
   bool supported = false;
 
@@ -636,7 +841,7 @@ void GpuDevice::setSwapchainExtent() {
   }
 }
 
-void GpuDevice::createSwapchain() {
+void GpuDevice::createSwapchain(VkSwapchainKHR oldSwapchain) {
   uint32_t imageCount = surfaceCapabilities.minImageCount + 1;
   if (surfaceCapabilities.maxImageCount > 0 &&
       imageCount > surfaceCapabilities.maxImageCount) {
@@ -662,7 +867,7 @@ void GpuDevice::createSwapchain() {
       .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
       .presentMode = presentMode,
       .clipped = VK_TRUE,
-      .oldSwapchain = VK_NULL_HANDLE,
+      .oldSwapchain = oldSwapchain,
   };
 
   if (vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapchain) !=
@@ -716,83 +921,271 @@ void GpuDevice::destroySwapchain() {
 }
 
 Handle<Pipeline> GpuDevice::createPipeline(const PipelineCI &ci) {
-  std::vector<VkShaderModule> modules;
+  std::string key = getPipelineKey(ci);
+  auto it = pipelineLookup.find(key);
+  if (it != pipelineLookup.end()) {
+    sharedPipelines[it->second.index].refCount++;
+    return it->second;
+  }
+
+  if (batchingPipelines) {
+    Handle<Pipeline> handle = pipelines.obtain();
+    if (handle.isValid()) {
+      addSharedPipeline(handle, key);
+      batchedPipelineCIs.push_back(ci);
+      batchedPipelineHandles.push_back(handle);
+    }
+    return handle;
+  }
+
+  Handle<Pipeline> handle = createUniquePipeline(ci);
+  if (handle.isValid()) {
+    addSharedPipeline(handle, key);
+    shaderReloader.watch(handle, ci);
+  }
+
+  return handle;
+}
+
+std::vector<Handle<Pipeline>>
+GpuDevice::createPipelines(std::span<const PipelineCI> cis) {
+  std::vector<Handle<Pipeline>> handles(cis.size());
+
+  if (batchingPipelines) {
+    for (size_t i = 0; i < cis.size(); i++) {
+      handles[i] = createPipeline(cis[i]);
+    }
+    return handles;
+  }
+
+  // only the first of several identical cis is built, the rest share it
+  std::vector<std::string> keys(cis.size());
+  std::unordered_map<std::string, size_t> firstIndices;
+  std::vector<size_t> buildIndices;
+  for (size_t i = 0; i < cis.size(); i++) {
+    keys[i] = getPipelineKey(cis[i]);
+
+    auto it = pipelineLookup.find(keys[i]);
+    if (it != pipelineLookup.end()) {
+      sharedPipelines[it->second.index].refCount++;
+      handles[i] = it->second;
+    } else if (firstIndices.emplace(keys[i], i).second) {
+      buildIndices.push_back(i);
+    }
+  }
+
+  // resource pool isn't thread safe, obtain handles up front
+  std::vector<const PipelineCI *> buildCIs;
+  std::vector<Handle<Pipeline>> buildHandles;
+  for (size_t i : buildIndices) {
+    handles[i] = pipelines.obtain();
+    buildCIs.push_back(&cis[i]);
+    buildHandles.push_back(handles[i]);
+  }
+
+  std::vector<uint8_t> built = buildPipelines(buildCIs, buildHandles);
+
+  for (size_t buildIndex = 0; buildIndex < buildIndices.size(); buildIndex++) {
+    size_t i = buildIndices[buildIndex];
+    if (!handles[i].isValid()) {
+      continue;
+    }
+    if (!built[buildIndex]) {
+      pipelines.release(handles[i]);
+      handles[i].invalidate();
+      continue;
+    }
+    addSharedPipeline(handles[i], keys[i]);
+    shaderReloader.watch(handles[i], cis[i]);
+  }
+
+  for (size_t i = 0; i < cis.size(); i++) {
+    auto it = firstIndices.find(keys[i]);
+    if (it == firstIndices.end() || it->second == i) {
+      continue;
+    }
+    handles[i] = handles[it->second];
+    if (handles[i].isValid()) {
+      sharedPipelines[handles[i].index].refCount++;
+    }
+  }
+
+  return handles;
+}
+
+void GpuDevice::beginPipelineBatch() { batchingPipelines = true; }
+
+void GpuDevice::endPipelineBatch() {
+  batchingPipelines = false;
+  if (batchedPipelineHandles.empty()) {
+    return;
+  }
+  ZoneScoped;
+
+  std::vector<const PipelineCI *> cis;
+  cis.reserve(batchedPipelineCIs.size());
+  for (const auto &ci : batchedPipelineCIs) {
+    cis.push_back(&ci);
+  }
+
+  std::vector<uint8_t> built = buildPipelines(cis, batchedPipelineHandles);
+
+  for (size_t i = 0; i < batchedPipelineHandles.size(); i++) {
+    if (!built[i]) {
+      spdlog::error("Failed to build pipeline for {}",
+                    batchedPipelineCIs[i].shaderStages[0].path.string());
+      continue;
+    }
+    shaderReloader.watch(batchedPipelineHandles[i], batchedPipelineCIs[i]);
+  }
+
+  batchedPipelineCIs.clear();
+  batchedPipelineHandles.clear();
+}
+
+std::vector<uint8_t>
+GpuDevice::buildPipelines(std::span<const PipelineCI *const> cis,
+                          std::span<const Handle<Pipeline>> handles) {
+  // compile every unique shader once, pipelines sharing a stage would
+  // otherwise race on writing its .spv cache
+  std::vector<std::filesystem::path> shaderPaths;
+  for (const PipelineCI *ci : cis) {
+    for (const auto &shaderStage : ci->shaderStages) {
+      if (std::find(shaderPaths.begin(), shaderPaths.end(),
+                    shaderStage.path) == shaderPaths.end()) {
+        shaderPaths.push_back(shaderStage.path);
+      }
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> compiled(shaderPaths.size());
+  std::vector<std::span<const uint32_t>> spirvs(shaderPaths.size());
+  threadPool.parallelFor(shaderPaths.size(), [&](size_t i) {
+    spirvs[i] = shaderCompiler.getSpirv(shaderPaths[i], compiled[i]);
+    if (spirvs[i].empty()) {
+      spdlog::error("Failed to compile {}", shaderPaths[i].string());
+    }
+  });
+
+  std::vector<uint8_t> built(cis.size(), 0);
+  threadPool.parallelFor(cis.size(), [&](size_t i) {
+    if (!handles[i].isValid()) {
+      return;
+    }
+
+    std::vector<std::span<const uint32_t>> stageSpirvs;
+    stageSpirvs.reserve(cis[i]->shaderStages.size());
+    for (const auto &shaderStage : cis[i]->shaderStages) {
+      size_t shaderIndex =
+          std::find(shaderPaths.begin(), shaderPaths.end(), shaderStage.path) -
+          shaderPaths.begin();
+      stageSpirvs.push_back(spirvs[shaderIndex]);
+    }
+
+    built[i] = buildPipeline(pipelines.get(handles[i]), *cis[i], stageSpirvs);
+  });
+
+  return built;
+}
+
+Handle<Pipeline> GpuDevice::createUniquePipeline(const PipelineCI &ci) {
+  std::vector<std::vector<uint32_t>> compiled(ci.shaderStages.size());
+  std::vector<std::span<const uint32_t>> spirvs;
+  spirvs.reserve(ci.shaderStages.size());
+
+  for (size_t i = 0; i < ci.shaderStages.size(); i++) {
+    const ShaderStage &shaderStage = ci.shaderStages[i];
+    spirvs.push_back(shaderCompiler.getSpirv(shaderStage.path, compiled[i]));
+    if (spirvs.back().empty()) {
+      spdlog::error("Failed to compile {}", shaderStage.path.string());
+      return {}; // return invalid pipeline handle
+    }
+  }
+
+  Handle<Pipeline> handle = pipelines.obtain();
+  if (!handle.isValid()) {
+    return handle;
+  }
+
+  if (!buildPipeline(pipelines.get(handle), ci, spirvs)) {
+    pipelines.release(handle);
+    return {};
+  }
+
+  return handle;
+}
+
+bool GpuDevice::buildPipeline(
+    Pipeline *pipeline, const PipelineCI &ci,
+    std::span<const std::span<const uint32_t>> spirvs) {
+  // held until the pipeline is created, the cache may replace them meanwhile
+  std::vector<std::shared_ptr<VkShaderModule>> modules;
   std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+  // sized up front, the stage create infos point into it
+  std::vector<VkSpecializationInfo> specializationInfos(
+      ci.shaderStages.size());
+  std::vector<std::vector<VkSpecializationMapEntry>> specializationEntries(
+      ci.shaderStages.size());
 
-  bool shaderCompileSuccess = true;
+  bool shaderModuleSuccess = true;
   bool isCompute = false;
 
-  for (const auto &shaderStage : ci.shaderStages) {
+  for (size_t i = 0; i < ci.shaderStages.size(); i++) {
+    const ShaderStage &shaderStage = ci.shaderStages[i];
     if (shaderStage.stage == VK_SHADER_STAGE_COMPUTE_BIT) {
       isCompute = true;
     }
 
-    std::vector<uint32_t> spirv = shaderCompiler.compileGLSL(shaderStage.path);
-    if (spirv.empty()) {
-      spdlog::error("Failed to compile {}", shaderStage.path.string());
-      shaderCompileSuccess = false;
+    if (spirvs[i].empty()) {
+      shaderModuleSuccess = false;
       break;
     }
 
-    VkShaderModuleCreateInfo shaderModuleCI{
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .codeSize = spirv.size() * sizeof(uint32_t),
-        .pCode = spirv.data(),
-    };
-
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &shaderModuleCI, nullptr, &shaderModule) !=
-        VK_SUCCESS) {
-      spdlog::error("Failed to create shader module");
-      shaderCompileSuccess = false;
+    std::shared_ptr<VkShaderModule> shaderModule =
+        getShaderModule(shaderStage.path, spirvs[i]);
+    if (!shaderModule) {
+      shaderModuleSuccess = false;
       break;
     }
     modules.push_back(shaderModule);
 
+    const auto &constants = shaderStage.specializationConstants;
+    for (size_t j = 0; j < constants.size(); j++) {
+      specializationEntries[i].push_back({
+          .constantID = constants[j].id,
+          .offset = static_cast<uint32_t>(
+              j * sizeof(SpecializationConstant) +
+              offsetof(SpecializationConstant, value)),
+          .size = sizeof(uint32_t),
+      });
+    }
+    specializationInfos[i] = {
+        .mapEntryCount =
+            static_cast<uint32_t>(specializationEntries[i].size()),
+        .pMapEntries = specializationEntries[i].data(),
+        .dataSize = constants.size() * sizeof(SpecializationConstant),
+        .pData = constants.data(),
+    };
+
     shaderStages.emplace_back(VkPipelineShaderStageCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
         .stage = shaderStage.stage,
-        .module = shaderModule,
+        .module = *shaderModule,
         .pName = "main",
-        .pSpecializationInfo = nullptr,
+        .pSpecializationInfo =
+            constants.empty() ? nullptr : &specializationInfos[i],
     });
   }
 
-  if (!shaderCompileSuccess) {
-    for (const auto &module : modules) {
-      vkDestroyShaderModule(device, module, nullptr);
-    }
-    return {}; // return invalid pipeline handle
+  if (!shaderModuleSuccess) {
+    return false;
   }
 
-  Handle<Pipeline> handle = pipelines.obtain();
-  Pipeline *pipeline = pipelines.get(handle);
-
-  VkPushConstantRange pcRange = {
-      .stageFlags = VK_SHADER_STAGE_ALL,
-      .offset = 0,
-      .size = sizeof(PushConstants),
-  };
+  pipeline->pipelineLayout = bindlessPipelineLayout;
 
-  VkPipelineLayoutCreateInfo pipelineLayoutCI = {
-      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = 0,
-      .setLayoutCount =
-          static_cast<uint32_t>(bindlessDescriptorSetLayouts.size()),
-      .pSetLayouts = bindlessDescriptorSetLayouts.data(),
-      .pushConstantRangeCount = 1,
-      .pPushConstantRanges = &pcRange,
-  };
-
-  if (vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr,
-                             &pipeline->pipelineLayout) != VK_SUCCESS) {
-    spdlog::error("Failed to create pipeline layout");
-  }
+  bool pipelineSuccess = true;
 
   if (!isCompute) {
     std::vector<VkDynamicState> dynamicStates = {
@@ -975,10 +1368,10 @@ Handle<Pipeline> GpuDevice::createPipeline(const PipelineCI &ci) {
         .basePipelineIndex = 0,
     };
 
-    if (vkCreateGraphicsPipelines(
-            device, VK_NULL_HANDLE, // todo: pipeline cache
-            1, &pipelineCI, nullptr, &pipeline->pipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI,
+                                  nullptr, &pipeline->pipeline) != VK_SUCCESS) {
       spdlog::error("Failed to create graphics pipeline");
+      pipelineSuccess = false;
     }
     pipeline->bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
   } else {                            // compute
@@ -990,19 +1383,67 @@ Handle<Pipeline> GpuDevice::createPipeline(const PipelineCI &ci) {
         .stage = shaderStages[0],
         .layout = pipeline->pipelineLayout,
     };
-    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, // todo: pipeline cache
-                                 1, &pipelineCI, nullptr,
-                                 &pipeline->pipeline) != VK_SUCCESS) {
+    if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCI,
+                                 nullptr, &pipeline->pipeline) != VK_SUCCESS) {
       spdlog::error("Failed to create compute pipeline");
+      pipelineSuccess = false;
     }
     pipeline->bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
   }
 
-  for (const auto &module : modules) {
-    vkDestroyShaderModule(device, module, nullptr);
+  return pipelineSuccess;
+}
+
+std::shared_ptr<VkShaderModule>
+GpuDevice::getShaderModule(const std::filesystem::path &path,
+                           std::span<const uint32_t> spirv) {
+  std::string name = normalizeShaderPath(path);
+  uint64_t spirvHash = hashBytes(spirv.data(), spirv.size_bytes());
+
+  std::lock_guard<std::mutex> lock(shaderModuleMutex);
+  auto it = shaderModules.find(name);
+  if (it != shaderModules.end() && it->second.spirvHash == spirvHash) {
+    if (auto module = it->second.module.lock()) {
+      return module;
+    }
   }
 
-  return handle;
+  VkShaderModuleCreateInfo shaderModuleCI{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .codeSize = spirv.size_bytes(),
+      .pCode = spirv.data(),
+  };
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &shaderModuleCI, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    spdlog::error("Failed to create shader module");
+    return nullptr;
+  }
+
+  VkDevice moduleDevice = device;
+  std::shared_ptr<VkShaderModule> module(
+      new VkShaderModule(shaderModule), [moduleDevice](VkShaderModule *ptr) {
+        vkDestroyShaderModule(moduleDevice, *ptr, nullptr);
+        delete ptr;
+      });
+  shaderModules[name] = {
+      .spirvHash = spirvHash,
+      .module = module,
+  };
+
+  return module;
+}
+
+void GpuDevice::addSharedPipeline(Handle<Pipeline> handle,
+                                  const std::string &key) {
+  pipelineLookup[key] = handle;
+  sharedPipelines[handle.index] = {
+      .key = key,
+      .refCount = 1,
+  };
 }
 
 void GpuDevice::destroyPipeline(Handle<Pipeline> handle) {
@@ -1011,16 +1452,215 @@ void GpuDevice::destroyPipeline(Handle<Pipeline> handle) {
     return;
   }
 
-  Pipeline *pipeline = pipelines.get(handle);
+  auto it = sharedPipelines.find(handle.index);
+  if (it != sharedPipelines.end()) {
+    if (--it->second.refCount > 0) {
+      return;
+    }
+
+    auto lookupIt = pipelineLookup.find(it->second.key);
+    if (lookupIt != pipelineLookup.end() && lookupIt->second == handle) {
+      pipelineLookup.erase(lookupIt);
+    }
+    sharedPipelines.erase(it);
+  }
+
+  // still queued, so never built
+  auto batchedIt = std::find(batchedPipelineHandles.begin(),
+                             batchedPipelineHandles.end(), handle);
+  if (batchedIt != batchedPipelineHandles.end()) {
+    size_t batchedIndex = batchedIt - batchedPipelineHandles.begin();
+    batchedPipelineHandles.erase(batchedIt);
+    batchedPipelineCIs.erase(batchedPipelineCIs.begin() + batchedIndex);
+  }
 
-  vkDestroyPipelineLayout(device, pipeline->pipelineLayout, nullptr);
+  shaderReloader.unwatch(handle);
 
+  Pipeline *pipeline = pipelines.get(handle);
+
+  // the layout is shared by every pipeline
   vkDestroyPipeline(device, pipeline->pipeline, nullptr);
 
   pipelines.release(handle);
 }
 
+void GpuDevice::createPipelineCache() {
+  std::vector<char> cacheData;
+
+  std::ifstream cacheFile(pipelineCachePath, std::ios::binary | std::ios::ate);
+  if (cacheFile.is_open()) {
+    size_t fileSize = cacheFile.tellg();
+    cacheFile.seekg(0);
+
+    PipelineCacheFileHeader header = {};
+    if (fileSize >= sizeof(header)) {
+      cacheFile.read(reinterpret_cast<char *>(&header), sizeof(header));
+    }
+
+    bool valid =
+        fileSize >= sizeof(header) && header.magic == PIPELINE_CACHE_MAGIC &&
+        header.dataSize == fileSize - sizeof(header) &&
+        header.vendorID == physicalDeviceProperties.vendorID &&
+        header.deviceID == physicalDeviceProperties.deviceID &&
+        header.driverVersion == physicalDeviceProperties.driverVersion &&
+        memcmp(header.pipelineCacheUUID,
+               physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+    if (valid) {
+      cacheData.resize(header.dataSize);
+      cacheFile.read(cacheData.data(), header.dataSize);
+      spdlog::info("GpuDevice: Loaded pipeline cache {} ({} bytes)",
+                   pipelineCachePath.string(), header.dataSize);
+    } else {
+      spdlog::warn("GpuDevice: Pipeline cache {} is stale, ignoring",
+                   pipelineCachePath.string());
+    }
+    cacheFile.close();
+  }
+
+  VkPipelineCacheCreateInfo pipelineCacheCI = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .initialDataSize = cacheData.size(),
+      .pInitialData = cacheData.empty() ? nullptr : cacheData.data(),
+  };
+
+  if (vkCreatePipelineCache(device, &pipelineCacheCI, nullptr,
+                            &pipelineCache) != VK_SUCCESS) {
+    spdlog::error("GpuDevice: Failed to create pipeline cache");
+    pipelineCache = VK_NULL_HANDLE;
+  }
+}
+
+void GpuDevice::savePipelineCache() {
+  if (pipelineCache == VK_NULL_HANDLE) {
+    return;
+  }
+
+  size_t dataSize = 0;
+  vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr);
+
+  std::vector<char> cacheData(dataSize);
+  if (vkGetPipelineCacheData(device, pipelineCache, &dataSize,
+                             cacheData.data()) != VK_SUCCESS) {
+    spdlog::error("GpuDevice: Failed to get pipeline cache data");
+    return;
+  }
+
+  PipelineCacheFileHeader header = {
+      .magic = PIPELINE_CACHE_MAGIC,
+      .dataSize = static_cast<uint32_t>(dataSize),
+      .vendorID = physicalDeviceProperties.vendorID,
+      .deviceID = physicalDeviceProperties.deviceID,
+      .driverVersion = physicalDeviceProperties.driverVersion,
+  };
+  memcpy(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID,
+         VK_UUID_SIZE);
+
+  // write to a temporary file first so a crash never leaves a truncated cache
+  std::filesystem::path tmpPath = pipelineCachePath;
+  tmpPath += ".tmp";
+
+  std::ofstream cacheFile(tmpPath, std::ios::binary);
+  if (!cacheFile.is_open()) {
+    spdlog::error("GpuDevice: Failed to save pipeline cache {}",
+                  pipelineCachePath.string());
+    return;
+  }
+  cacheFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  cacheFile.write(cacheData.data(), dataSize);
+  cacheFile.close();
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, pipelineCachePath, ec);
+  if (ec) {
+    spdlog::error("GpuDevice: Failed to save pipeline cache {}: {}",
+                  pipelineCachePath.string(), ec.message());
+    return;
+  }
+
+  spdlog::info("GpuDevice: Saved pipeline cache {} ({} bytes)",
+               pipelineCachePath.string(), dataSize);
+}
+
+void GpuDevice::destroyPipelineCache() {
+  savePipelineCache();
+  vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+void GpuDevice::createTracyContexts() {
+#ifdef TRACY_ENABLE
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           queueFamilies.data());
+
+  // tracy records and submits a calibration command buffer on the queue, then
+  // resets it
+  tracyMainContext =
+      TracyVkContext(physicalDevice, device, mainQueue, commandBuffers[0]);
+  TracyVkContextName(tracyMainContext, "Main", 4);
+
+  if (queueFamilies[computeFamily].timestampValidBits != 0) {
+    tracyComputeContext = TracyVkContext(physicalDevice, device, computeQueue,
+                                         computeCommandBuffers[0]);
+    TracyVkContextName(tracyComputeContext, "Compute", 7);
+  } else {
+    spdlog::warn("GpuDevice: Timestamps not supported on compute queue");
+  }
+
+  if (queueFamilies[transferFamily].timestampValidBits == 0) {
+    spdlog::warn("GpuDevice: Timestamps not supported on transfer queue");
+    return;
+  }
+
+  VkCommandPoolCreateInfo commandPoolCI = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = transferFamily,
+  };
+  VkCommandPool transferCommandPool;
+  vkCreateCommandPool(device, &commandPoolCI, nullptr, &transferCommandPool);
+
+  VkCommandBufferAllocateInfo commandAllocInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = transferCommandPool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VkCommandBuffer transferCommandBuffer;
+  vkAllocateCommandBuffers(device, &commandAllocInfo, &transferCommandBuffer);
+
+  tracyTransferContext = TracyVkContext(physicalDevice, device, transferQueue,
+                                        transferCommandBuffer);
+  TracyVkContextName(tracyTransferContext, "Transfer", 8);
+
+  vkDestroyCommandPool(device, transferCommandPool, nullptr);
+#endif
+}
+
+void GpuDevice::destroyTracyContexts() {
+  if (tracyMainContext) {
+    TracyVkDestroy(tracyMainContext);
+  }
+  if (tracyComputeContext) {
+    TracyVkDestroy(tracyComputeContext);
+  }
+  if (tracyTransferContext) {
+    TracyVkDestroy(tracyTransferContext);
+  }
+}
+
 void GpuDevice::newFrame() {
+  ZoneScoped;
+
+  endPipelineBatch();
+
   if (absoluteFrame >= FRAMES_IN_FLIGHT) {
     uint64_t graphicsTimelineWaitValue = absoluteFrame - FRAMES_IN_FLIGHT + 1;
 
@@ -1036,33 +1676,75 @@ void GpuDevice::newFrame() {
     vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
   }
 
-  VkSemaphore *imageAcquiredSemaphore = &imageAcquiredSemaphores[currentFrame];
-  VkResult acquireResult = vkAcquireNextImageKHR(
-      device, swapchain, UINT64_MAX, *imageAcquiredSemaphore, VK_NULL_HANDLE,
-      &swapchainImageIndex);
-  if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
-    resizeSwapchain();
-    resized = true;
+  processDeferredDestructions();
+  shaderReloader.update();
+  profiler.newFrame();
+  asyncLoader.update();
+
+  // the frame that last used this staging slice has completed
+  frameStagingOffsets[currentFrame] = 0;
+  if (!queuedBufferUploads[currentFrame].empty()) {
+    spdlog::warn("GpuDevice: Dropping {} buffer uploads that were never "
+                 "flushed",
+                 queuedBufferUploads[currentFrame].size());
+    queuedBufferUploads[currentFrame].clear();
+  }
+
+  if (!headless) {
+    VkSemaphore *imageAcquiredSemaphore =
+        &imageAcquiredSemaphores[currentFrame];
+    VkResult acquireResult = vkAcquireNextImageKHR(
+        device, swapchain, UINT64_MAX, *imageAcquiredSemaphore, VK_NULL_HANDLE,
+        &swapchainImageIndex);
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+      resizeSwapchain();
+      resized = true;
+    }
   }
 
+  // compute work of a frame completes before its graphics work, so the wait
+  // above covers this pool too
   vkResetCommandPool(device, commandPools[currentFrame], 0);
+  vkResetCommandPool(device, computeCommandPools[currentFrame], 0);
+  for (auto &threadCommandPool : threadCommandPools[currentFrame]) {
+    vkResetCommandPool(device, threadCommandPool.commandPool, 0);
+    threadCommandPool.usedCount = 0;
+  }
 }
 
 void GpuDevice::present() {
+  ZoneScoped;
+
   VkSemaphore *imageAcquiredSemaphore = &imageAcquiredSemaphores[currentFrame];
   VkSemaphore *renderCompletedSemaphore =
       &renderCompletedSemaphores[currentFrame];
 
+  // ownership acquires for finished async uploads run before the frame's
+  // commands, their batches have already completed so the wait is free
+  VkCommandBuffer acquireCmd = asyncLoader.recordAcquires();
+
   std::vector<VkSemaphoreSubmitInfo> waitSemaphores;
-  waitSemaphores.reserve(2);
-  waitSemaphores.emplace_back(VkSemaphoreSubmitInfo{
-      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-      .pNext = nullptr,
-      .semaphore = *imageAcquiredSemaphore,
-      .value = 0,
-      .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-      .deviceIndex = 0,
-  });
+  waitSemaphores.reserve(4);
+  if (acquireCmd != VK_NULL_HANDLE) {
+    waitSemaphores.emplace_back(VkSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = asyncLoader.timelineSemaphore,
+        .value = asyncLoader.acquireWaitValue,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0,
+    });
+  }
+  if (!headless) {
+    waitSemaphores.emplace_back(VkSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = *imageAcquiredSemaphore,
+        .value = 0,
+        .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .deviceIndex = 0,
+    });
+  }
 
   if (absoluteFrame >= FRAMES_IN_FLIGHT) {
     waitSemaphores.emplace_back(VkSemaphoreSubmitInfo{
@@ -1075,30 +1757,52 @@ void GpuDevice::present() {
     });
   }
 
+  // compute outputs are only consumed by indirect draws and the shaders they
+  // launch, work recorded before those can still overlap
+  if (computeSubmitted) {
+    waitSemaphores.emplace_back(VkSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = computeTimelineSemaphore,
+        .value = absoluteFrame + 1,
+        .stageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+        .deviceIndex = 0,
+    });
+    computeSubmitted = false;
+  }
+
+  // the timeline comes first so headless frames can submit it alone
   std::array<VkSemaphoreSubmitInfo, 2> signalSemaphores = {
       VkSemaphoreSubmitInfo{
           .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
           .pNext = nullptr,
-          .semaphore = *renderCompletedSemaphore,
-          .value = 0,
-          .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .semaphore = graphicsTimelineSemaphore,
+          .value = absoluteFrame + 1,
+          .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
           .deviceIndex = 0,
       },
       VkSemaphoreSubmitInfo{
           .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
           .pNext = nullptr,
-          .semaphore = graphicsTimelineSemaphore,
-          .value = absoluteFrame + 1,
-          .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .semaphore = *renderCompletedSemaphore,
+          .value = 0,
+          .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
           .deviceIndex = 0,
       }};
 
-  VkCommandBufferSubmitInfo commandBufferInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
-      .pNext = nullptr,
-      .commandBuffer = commandBuffers[currentFrame],
-      .deviceMask = 0,
-  };
+  std::array<VkCommandBufferSubmitInfo, 2> commandBufferInfos = {
+      VkCommandBufferSubmitInfo{
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+          .pNext = nullptr,
+          .commandBuffer = acquireCmd,
+          .deviceMask = 0,
+      },
+      VkCommandBufferSubmitInfo{
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+          .pNext = nullptr,
+          .commandBuffer = commandBuffers[currentFrame],
+          .deviceMask = 0,
+      }};
 
   VkSubmitInfo2 submitInfo = {
       .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
@@ -1106,10 +1810,12 @@ void GpuDevice::present() {
       .flags = 0,
       .waitSemaphoreInfoCount = static_cast<uint32_t>(waitSemaphores.size()),
       .pWaitSemaphoreInfos = waitSemaphores.data(),
-      .commandBufferInfoCount = 1,
-      .pCommandBufferInfos = &commandBufferInfo,
+      .commandBufferInfoCount = acquireCmd != VK_NULL_HANDLE ? 2u : 1u,
+      .pCommandBufferInfos = acquireCmd != VK_NULL_HANDLE
+                                 ? commandBufferInfos.data()
+                                 : &commandBufferInfos[1],
       .signalSemaphoreInfoCount =
-          static_cast<uint32_t>(signalSemaphores.size()),
+          headless ? 1 : static_cast<uint32_t>(signalSemaphores.size()),
       .pSignalSemaphoreInfos = signalSemaphores.data(),
   };
 
@@ -1117,6 +1823,13 @@ void GpuDevice::present() {
     spdlog::error("Error submitting");
   }
 
+  // the frame ends at the submit, drawTexture holds the result
+  if (headless) {
+    FrameMark;
+    advanceFrameCounter();
+    return;
+  }
+
   VkPresentInfoKHR presentInfo = {
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
       .pNext = nullptr,
@@ -1129,6 +1842,8 @@ void GpuDevice::present() {
   };
 
   VkResult result = vkQueuePresentKHR(mainQueue, &presentInfo);
+  FrameMark;
+
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       resized) {
     resizeSwapchain();
@@ -1146,6 +1861,8 @@ void GpuDevice::advanceFrameCounter() {
 }
 
 VkCommandBuffer GpuDevice::getCommandBuffer(bool begin) {
+  endPipelineBatch();
+
   VkCommandBuffer cmdBuf = commandBuffers[currentFrame];
 
   if (begin) {
@@ -1159,11 +1876,156 @@ VkCommandBuffer GpuDevice::getCommandBuffer(bool begin) {
     };
 
     vkBeginCommandBuffer(cmdBuf, &beginInfo);
+
+    flushQueuedUploads(cmdBuf);
+  }
+
+  return cmdBuf;
+}
+
+VkCommandBuffer GpuDevice::getComputeCommandBuffer(bool begin) {
+  VkCommandBuffer cmdBuf = computeCommandBuffers[currentFrame];
+
+  if (begin) {
+    vkResetCommandBuffer(cmdBuf, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+
+    vkBeginCommandBuffer(cmdBuf, &beginInfo);
+  }
+
+  return cmdBuf;
+}
+
+VkCommandBuffer GpuDevice::getSecondaryCommandBuffer() {
+  uint32_t threadIndex = threadPool.threadIndex();
+  assert(threadIndex < threadCommandPools[currentFrame].size());
+  ThreadCommandPool &threadCommandPool =
+      threadCommandPools[currentFrame][threadIndex];
+
+  if (threadCommandPool.usedCount ==
+      threadCommandPool.secondaryCommandBuffers.size()) {
+    VkCommandBufferAllocateInfo commandAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .commandPool = threadCommandPool.commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer cmdBuf;
+    if (vkAllocateCommandBuffers(device, &commandAllocInfo, &cmdBuf) !=
+        VK_SUCCESS) {
+      spdlog::error("Failed to allocate secondary command buffer");
+      return VK_NULL_HANDLE;
+    }
+    threadCommandPool.secondaryCommandBuffers.push_back(cmdBuf);
   }
 
+  VkCommandBuffer cmdBuf =
+      threadCommandPool.secondaryCommandBuffers[threadCommandPool.usedCount++];
+
+  // passes begin their own dynamic rendering, so nothing is inherited
+  VkCommandBufferInheritanceInfo inheritanceInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .pNext = nullptr,
+  };
+
+  VkCommandBufferBeginInfo beginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = &inheritanceInfo,
+  };
+
+  vkBeginCommandBuffer(cmdBuf, &beginInfo);
+
   return cmdBuf;
 }
 
+void GpuDevice::recordParallel(
+    VkCommandBuffer cmd,
+    std::span<const std::function<void(VkCommandBuffer)>> recorders) {
+  ZoneScoped;
+
+  std::vector<VkCommandBuffer> secondaries(recorders.size(), VK_NULL_HANDLE);
+
+  threadPool.parallelFor(recorders.size(), [&](size_t i) {
+    VkCommandBuffer secondary = getSecondaryCommandBuffer();
+    if (secondary == VK_NULL_HANDLE) {
+      return;
+    }
+    recorders[i](secondary);
+    vkEndCommandBuffer(secondary);
+    secondaries[i] = secondary;
+  });
+
+  std::erase_if(secondaries,
+                [](VkCommandBuffer secondary) { return !secondary; });
+  if (!secondaries.empty()) {
+    vkCmdExecuteCommands(cmd, static_cast<uint32_t>(secondaries.size()),
+                         secondaries.data());
+  }
+}
+
+void GpuDevice::submitCompute() {
+  std::vector<VkSemaphoreSubmitInfo> waitSemaphores;
+
+  // buffers written here were last read by the graphics work of the frame
+  // that used this slot
+  if (absoluteFrame >= FRAMES_IN_FLIGHT) {
+    waitSemaphores.emplace_back(VkSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = graphicsTimelineSemaphore,
+        .value = absoluteFrame - FRAMES_IN_FLIGHT + 1,
+        .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .deviceIndex = 0,
+    });
+  }
+
+  VkSemaphoreSubmitInfo signalSemaphore = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .semaphore = computeTimelineSemaphore,
+      .value = absoluteFrame + 1,
+      .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .deviceIndex = 0,
+  };
+
+  VkCommandBufferSubmitInfo commandBufferInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .pNext = nullptr,
+      .commandBuffer = computeCommandBuffers[currentFrame],
+      .deviceMask = 0,
+  };
+
+  VkSubmitInfo2 submitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .pNext = nullptr,
+      .flags = 0,
+      .waitSemaphoreInfoCount = static_cast<uint32_t>(waitSemaphores.size()),
+      .pWaitSemaphoreInfos = waitSemaphores.data(),
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &commandBufferInfo,
+      .signalSemaphoreInfoCount = 1,
+      .pSignalSemaphoreInfos = &signalSemaphore,
+  };
+
+  if (vkQueueSubmit2(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) !=
+      VK_SUCCESS) {
+    spdlog::error("Error submitting compute");
+    return;
+  }
+
+  computeSubmitted = true;
+}
+
 Handle<Buffer> GpuDevice::createBuffer(const BufferCI &ci) {
   Handle<Buffer> handle;
 
@@ -1290,7 +2152,10 @@ void GpuDevice::destroyBuffer(Handle<Buffer> handle) {
 }
 
 void GpuDevice::resizeSwapchain() {
-  vkDeviceWaitIdle(device);
+  if (headless) {
+    return;
+  }
+
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
                                             &surfaceCapabilities);
   swapchainExtent = surfaceCapabilities.currentExtent;
@@ -1299,39 +2164,28 @@ void GpuDevice::resizeSwapchain() {
     return;
   }
 
-  destroySwapchain();
-  createSwapchain();
+  // frames in flight may still reference the old swapchain images and draw
+  // texture, retire them instead of waiting for the device to go idle
+  RetiredSwapchain retired = {
+      .swapchain = swapchain,
+      .imageViews = std::move(swapchainImageViews),
+      .timelineValue = absoluteFrame + 1,
+  };
+  for (const auto &depthTexture : depthTextures) {
+    destroyTextureDeferred(depthTexture);
+  }
+  depthTextures.clear();
+  swapchainImageViews.clear();
 
-  destroyDrawTexture();
+  createSwapchain(retired.swapchain);
+  retiredSwapchains.push_back(std::move(retired));
+
+  destroyTextureDeferred(drawTexture);
   createDrawTexture();
 }
 
-Handle<Texture> GpuDevice::createTexture(const TextureCI &ci) {
-  Handle<Texture> handle = textures.obtain();
-  if (!handle.isValid()) {
-    return handle;
-  }
-
-  Texture *texture = textures.get(handle);
-
-  texture->width = ci.width;
-  texture->height = ci.height;
-  texture->depth = ci.depth;
-  texture->format = ci.format;
-  texture->name = ci.name;
-
-  if (ci.genMips) {
-    texture->mipLevel = VkHelper::getMipLevel(ci.width, ci.height);
-  } else {
-    texture->mipLevel = 1;
-  }
-  if (ci.cubemap) {
-    texture->layerCount = 6;
-  } else {
-    texture->layerCount = 1;
-  }
-
-  VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+VkImageCreateInfo GpuDevice::getImageCI(const TextureCI &ci) const {
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT;
 
   if (ci.format == VK_FORMAT_D32_SFLOAT) {
     usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
@@ -1343,13 +2197,11 @@ Handle<Texture> GpuDevice::createTexture(const TextureCI &ci) {
     usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
   }
 
-  if (ci.storage) {
+  if (ci.storage || (ci.genMips && mipGenerator.supportsFormat(ci.format))) {
     usage |= VK_IMAGE_USAGE_STORAGE_BIT;
-    Handle<uint8_t> storageTextureHandle = storageTextures.obtain();
-    handle.storageIndex = storageTextureHandle.index;
   }
 
-  VkImageCreateInfo imageCI = {
+  return {
       .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
       .pNext = nullptr,
       .flags = static_cast<VkImageCreateFlags>(
@@ -1362,7 +2214,8 @@ Handle<Texture> GpuDevice::createTexture(const TextureCI &ci) {
               .height = ci.height,
               .depth = ci.depth,
           },
-      .mipLevels = ci.genMips ? texture->mipLevel : 1,
+      .mipLevels =
+          ci.genMips ? VkHelper::getMipLevel(ci.width, ci.height) : 1,
       .arrayLayers = static_cast<uint32_t>(ci.cubemap ? 6 : 1),
       .samples = VK_SAMPLE_COUNT_1_BIT,
       .tiling = VK_IMAGE_TILING_OPTIMAL,
@@ -1370,13 +2223,75 @@ Handle<Texture> GpuDevice::createTexture(const TextureCI &ci) {
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
   };
+}
+
+VkMemoryRequirements
+GpuDevice::getTextureMemoryRequirements(const TextureCI &ci) const {
+  VkImageCreateInfo imageCI = getImageCI(ci);
+
+  VkDeviceImageMemoryRequirements imageRequirements = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+      .pNext = nullptr,
+      .pCreateInfo = &imageCI,
+  };
 
-  VmaAllocationCreateInfo allocCI = {
-      .usage = VMA_MEMORY_USAGE_AUTO,
+  VkMemoryRequirements2 requirements = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+      .pNext = nullptr,
   };
 
-  vmaCreateImage(allocator, &imageCI, &allocCI, &texture->image,
-                 &texture->allocation, nullptr);
+  vkGetDeviceImageMemoryRequirements(device, &imageRequirements,
+                                     &requirements);
+  return requirements.memoryRequirements;
+}
+
+Handle<Texture> GpuDevice::createTexture(const TextureCI &ci) {
+  Handle<Texture> handle = textures.obtain();
+  if (!handle.isValid()) {
+    return handle;
+  }
+
+  Texture *texture = textures.get(handle);
+
+  texture->width = ci.width;
+  texture->height = ci.height;
+  texture->depth = ci.depth;
+  texture->format = ci.format;
+  texture->name = ci.name;
+  texture->srgb = ci.srgb;
+
+  if (ci.genMips) {
+    texture->mipLevel = VkHelper::getMipLevel(ci.width, ci.height);
+  } else {
+    texture->mipLevel = 1;
+  }
+  if (ci.cubemap) {
+    texture->layerCount = 6;
+  } else {
+    texture->layerCount = 1;
+  }
+
+  if (ci.storage) {
+    Handle<uint8_t> storageTextureHandle = storageTextures.obtain();
+    handle.storageIndex = storageTextureHandle.index;
+  }
+
+  VkImageCreateInfo imageCI = getImageCI(ci);
+
+  if (ci.aliasAllocation) {
+    // a null allocation makes vmaDestroyImage leave the shared memory alone
+    vkCreateImage(device, &imageCI, nullptr, &texture->image);
+    vmaBindImageMemory2(allocator, ci.aliasAllocation, ci.aliasOffset,
+                        texture->image, nullptr);
+    texture->allocation = nullptr;
+  } else {
+    VmaAllocationCreateInfo allocCI = {
+        .usage = VMA_MEMORY_USAGE_AUTO,
+    };
+
+    vmaCreateImage(allocator, &imageCI, &allocCI, &texture->image,
+                   &texture->allocation, nullptr);
+  }
   if (!ci.name.empty()) {
     setVkObjectName(texture->image, VK_OBJECT_TYPE_IMAGE, "Image " + ci.name);
   }
@@ -1449,6 +2364,7 @@ void GpuDevice::destroyTexture(Handle<Texture> handle) {
 
   Texture *texture = textures.get(handle);
 
+  mipGenerator.releaseMipViews(texture);
   vkDestroyImageView(device, texture->imageView, nullptr);
   vmaDestroyImage(allocator, texture->image, texture->allocation);
 
@@ -1524,6 +2440,108 @@ void GpuDevice::destroySampler(Handle<Sampler> handle) {
   samplers.release(handle);
 }
 
+void GpuDevice::destroyBufferDeferred(Handle<Buffer> handle) {
+  if (!handle.isValid()) {
+    spdlog::error("Invalid buffer handle");
+    return;
+  }
+  deferredBuffers.push_back({handle, absoluteFrame + 1});
+}
+
+void GpuDevice::destroyTextureDeferred(Handle<Texture> handle) {
+  if (!handle.isValid()) {
+    spdlog::error("Invalid texture handle");
+    return;
+  }
+  deferredTextures.push_back({handle, absoluteFrame + 1});
+}
+
+void GpuDevice::destroySamplerDeferred(Handle<Sampler> handle) {
+  if (!handle.isValid()) {
+    spdlog::error("Invalid sampler handle");
+    return;
+  }
+  deferredSamplers.push_back({handle, absoluteFrame + 1});
+}
+
+void GpuDevice::destroyPipelineDeferred(Handle<Pipeline> handle) {
+  if (!handle.isValid()) {
+    spdlog::error("Invalid pipeline handle");
+    return;
+  }
+  deferredPipelines.push_back({handle, absoluteFrame + 1});
+}
+
+void GpuDevice::freeAllocationDeferred(VmaAllocation allocation) {
+  if (!allocation) {
+    spdlog::error("Invalid allocation");
+    return;
+  }
+  deferredAllocations.push_back({allocation, absoluteFrame + 1});
+}
+
+void GpuDevice::processDeferredDestructions(bool force) {
+  uint64_t completedValue = UINT64_MAX;
+  if (!force) {
+    vkGetSemaphoreCounterValue(device, graphicsTimelineSemaphore,
+                               &completedValue);
+  }
+
+  std::erase_if(deferredBuffers, [&](const auto &entry) {
+    if (entry.timelineValue > completedValue) {
+      return false;
+    }
+    destroyBuffer(entry.handle);
+    return true;
+  });
+
+  std::erase_if(deferredTextures, [&](const auto &entry) {
+    if (entry.timelineValue > completedValue) {
+      return false;
+    }
+    destroyTexture(entry.handle);
+    return true;
+  });
+
+  std::erase_if(deferredSamplers, [&](const auto &entry) {
+    if (entry.timelineValue > completedValue) {
+      return false;
+    }
+    destroySampler(entry.handle);
+    return true;
+  });
+
+  std::erase_if(deferredPipelines, [&](const auto &entry) {
+    if (entry.timelineValue > completedValue) {
+      return false;
+    }
+    destroyPipeline(entry.handle);
+    return true;
+  });
+
+  mipGenerator.processReleases(completedValue);
+
+  // after the textures, aliased images have to go before their memory
+  std::erase_if(deferredAllocations, [&](const auto &entry) {
+    if (entry.timelineValue > completedValue) {
+      return false;
+    }
+    vmaFreeMemory(allocator, entry.allocation);
+    return true;
+  });
+
+  std::erase_if(retiredSwapchains, [&](const auto &entry) {
+    if (entry.timelineValue > completedValue) {
+      return false;
+    }
+    for (const auto &imageView : entry.imageViews) {
+      vkDestroyImageView(device, imageView, nullptr);
+    }
+    vkDestroySwapchainKHR(device, entry.swapchain, nullptr);
+    return true;
+  });
+}
+
 void GpuDevice::submitImmediate(VkCommandBuffer cmd) {
   vkEndCommandBuffer(cmd);
 
@@ -1675,9 +2693,32 @@ void GpuDevice::createBindlessDescriptorSets(const GpuDeviceCreateInfo &ci) {
                                bindlessDescriptorSets.data()) != VK_SUCCESS) {
     spdlog::error("Failed to allocate bindless descriptor sets");
   }
+
+  VkPushConstantRange pcRange = {
+      .stageFlags = VK_SHADER_STAGE_ALL,
+      .offset = 0,
+      .size = sizeof(PushConstants),
+  };
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCI = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .setLayoutCount =
+          static_cast<uint32_t>(bindlessDescriptorSetLayouts.size()),
+      .pSetLayouts = bindlessDescriptorSetLayouts.data(),
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &pcRange,
+  };
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr,
+                             &bindlessPipelineLayout) != VK_SUCCESS) {
+    spdlog::error("Failed to create bindless pipeline layout");
+  }
 }
 
 void GpuDevice::destroyBindlessDescriptorSets() {
+  vkDestroyPipelineLayout(device, bindlessPipelineLayout, nullptr);
   for (const auto &layout : bindlessDescriptorSetLayouts) {
     vkDestroyDescriptorSetLayout(device, layout, nullptr);
   }
@@ -1732,123 +2773,296 @@ void GpuDevice::destroyDefaultTextures() {
   destroyTexture(defaultNormalTexture);
 }
 
-void GpuDevice::recreatePipeline(Handle<Pipeline> handle,
-                                 const PipelineCI &ci) {
-  if (!handle.isValid()) {
-    spdlog::error("Invalid pipeline handle");
-    return;
+void GpuDevice::uploadTextureData(Texture *texture, void *data, bool genMips) {
+  size_t rowSize = texture->width * 4;
+  // rows of all depth slices, chunks hold whole rows
+  uint32_t rowCount = texture->height * texture->depth;
+  uint32_t chunkRows =
+      static_cast<uint32_t>(std::max<size_t>(1, UPLOAD_CHUNK_SIZE / rowSize));
+
+  Buffer *stagingBuffer = storageBuffers.get(stagingBufferHandle);
+  auto *stagingData =
+      static_cast<uint8_t *>(stagingBuffer->allocationInfo.pMappedData);
+  const auto *srcData = static_cast<const uint8_t *>(data);
+
+  std::vector<VkBufferImageCopy2> regions;
+  for (uint32_t firstRow = 0; firstRow < rowCount; firstRow += chunkRows) {
+    uint32_t chunkRowCount = std::min(chunkRows, rowCount - firstRow);
+
+    size_t stagingOffset = 0;
+    VkCommandBuffer cmd = beginUploadChunk(stagingOffset);
+    memcpy(stagingData + stagingOffset, srcData + firstRow * rowSize,
+           chunkRowCount * rowSize);
+
+    if (firstRow == 0) {
+      VkHelper::transitionImage(cmd, texture->image, VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    }
+
+    // one region per depth slice the chunk touches
+    regions.clear();
+    for (uint32_t row = firstRow; row < firstRow + chunkRowCount;) {
+      uint32_t y = row % texture->height;
+      uint32_t z = row / texture->height;
+      uint32_t count =
+          std::min(texture->height - y, firstRow + chunkRowCount - row);
+
+      regions.push_back({
+          .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+          .pNext = nullptr,
+          .bufferOffset = stagingOffset + (row - firstRow) * rowSize,
+          .bufferRowLength = 0,
+          .bufferImageHeight = 0,
+          .imageSubresource =
+              {
+                  .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                  .mipLevel = 0,
+                  .baseArrayLayer = 0,
+                  .layerCount = 1,
+              },
+          .imageOffset = {0, static_cast<int32_t>(y), static_cast<int32_t>(z)},
+          .imageExtent = {texture->width, count, 1},
+      });
+
+      row += count;
+    }
+
+    VkCopyBufferToImageInfo2 copyInfo = {
+        .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2,
+        .pNext = nullptr,
+        .srcBuffer = stagingBuffer->buffer,
+        .dstImage = texture->image,
+        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .regionCount = static_cast<uint32_t>(regions.size()),
+        .pRegions = regions.data(),
+    };
+
+    vkCmdCopyBufferToImage2(cmd, &copyInfo);
+
+    if (firstRow + chunkRowCount == rowCount) {
+      if (genMips) {
+        mipGenerator.generate(cmd, texture);
+      } else {
+        VkHelper::transitionImage(cmd, texture->image,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      }
+    }
+
+    submitUploadChunk();
   }
 
-  vkDeviceWaitIdle(device);
+  waitUploadChunks();
+}
 
-  Handle<Pipeline> recreatedHandle = createPipeline(ci);
-  if (!recreatedHandle.isValid()) {
-    spdlog::error("Failed to recreate pipeline, using old pipeline");
+void GpuDevice::uploadBufferData(Handle<Buffer> targetHandle, void *data) {
+  if (!data) {
     return;
   }
-  pipelines.swap(handle, recreatedHandle);
-  destroyPipeline(recreatedHandle); // destroy old pipeline
-}
+  Buffer *stagingBuffer = getBuffer(stagingBufferHandle);
+  Buffer *targetBuffer = getBuffer(targetHandle);
+  auto *stagingData =
+      static_cast<uint8_t *>(stagingBuffer->allocationInfo.pMappedData);
+  const auto *srcData = static_cast<const uint8_t *>(data);
+
+  for (size_t offset = 0; offset < targetBuffer->size;
+       offset += UPLOAD_CHUNK_SIZE) {
+    size_t chunkSize = std::min(UPLOAD_CHUNK_SIZE, targetBuffer->size - offset);
+
+    size_t stagingOffset = 0;
+    VkCommandBuffer cmd = beginUploadChunk(stagingOffset);
+    memcpy(stagingData + stagingOffset, srcData + offset, chunkSize);
+
+    VkBufferCopy2 region = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2,
+        .srcOffset = stagingOffset,
+        .dstOffset = offset,
+        .size = chunkSize,
+    };
 
-void GpuDevice::uploadTextureData(Texture *texture, void *data, bool genMips) {
-  size_t size = texture->width * texture->height * texture->depth * 4;
+    VkCopyBufferInfo2 copyInfo = {
+        .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
+        .srcBuffer = stagingBuffer->buffer,
+        .dstBuffer = targetBuffer->buffer,
+        .regionCount = 1,
+        .pRegions = &region,
+    };
 
-  Buffer *stagingBuffer = storageBuffers.get(stagingBufferHandle);
+    vkCmdCopyBuffer2(cmd, &copyInfo);
 
-  memcpy(stagingBuffer->allocationInfo.pMappedData, data, size);
+    if (offset + chunkSize == targetBuffer->size) {
+      VkBufferMemoryBarrier2 barrier = {
+          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+          .pNext = nullptr,
+          .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+          .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+          .dstAccessMask = 0,
+          .buffer = targetBuffer->buffer,
+          .offset = 0,
+          .size = targetBuffer->size,
+      };
+
+      VkDependencyInfo depInfo = {
+          .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+          .pNext = nullptr,
+          .dependencyFlags = 0,
+          .bufferMemoryBarrierCount = 1,
+          .pBufferMemoryBarriers = &barrier,
+      };
 
-  VkCommandBuffer cmd = getCommandBuffer();
-  VkHelper::transitionImage(cmd, texture->image, VK_IMAGE_LAYOUT_UNDEFINED,
-                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
 
-  VkBufferImageCopy2 region = {
-      .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+    submitUploadChunk();
+  }
+
+  waitUploadChunks();
+}
+
+VkCommandBuffer GpuDevice::beginUploadChunk(size_t &stagingOffset) {
+  if (uploadsInFlight[uploadChunkIndex]) {
+    vkWaitForFences(device, 1, &uploadFences[uploadChunkIndex], VK_TRUE,
+                    UINT64_MAX);
+    uploadsInFlight[uploadChunkIndex] = false;
+  }
+  vkResetFences(device, 1, &uploadFences[uploadChunkIndex]);
+
+  VkCommandBuffer cmd = uploadCommandBuffers[uploadChunkIndex];
+  vkResetCommandBuffer(cmd, 0);
+
+  VkCommandBufferBeginInfo beginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
       .pNext = nullptr,
-      .bufferOffset = 0,
-      .bufferRowLength = 0,
-      .bufferImageHeight = 0,
-      .imageSubresource =
-          {
-              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-              .mipLevel = 0,
-              .baseArrayLayer = 0,
-              .layerCount = 1,
-          },
-      .imageOffset = {0, 0, 0},
-      .imageExtent = {texture->width, texture->height, texture->depth},
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
   };
 
-  VkCopyBufferToImageInfo2 copyInfo = {
-      .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2,
+  vkBeginCommandBuffer(cmd, &beginInfo);
+
+  stagingOffset = uploadChunkIndex * UPLOAD_CHUNK_SIZE;
+  return cmd;
+}
+
+void GpuDevice::submitUploadChunk() {
+  VkCommandBuffer cmd = uploadCommandBuffers[uploadChunkIndex];
+  vkEndCommandBuffer(cmd);
+
+  VkSubmitInfo submitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
       .pNext = nullptr,
-      .srcBuffer = stagingBuffer->buffer,
-      .dstImage = texture->image,
-      .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      .regionCount = 1,
-      .pRegions = &region,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &cmd,
   };
 
-  vkCmdCopyBufferToImage2(cmd, &copyInfo);
+  vkQueueSubmit(mainQueue, 1, &submitInfo, uploadFences[uploadChunkIndex]);
 
-  if (genMips) {
-    VkHelper::genMips(cmd, texture->image, {texture->width, texture->height});
-  } else {
-    VkHelper::transitionImage(cmd, texture->image,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-  }
+  uploadsInFlight[uploadChunkIndex] = true;
+  uploadChunkIndex = (uploadChunkIndex + 1) % uploadFences.size();
+}
 
-  submitImmediate(cmd);
+void GpuDevice::waitUploadChunks() {
+  for (uint32_t i = 0; i < uploadFences.size(); i++) {
+    if (uploadsInFlight[i]) {
+      vkWaitForFences(device, 1, &uploadFences[i], VK_TRUE, UINT64_MAX);
+      uploadsInFlight[i] = false;
+    }
+  }
 }
 
-void GpuDevice::uploadBufferData(Handle<Buffer> targetHandle, void *data) {
+void GpuDevice::queueBufferUpload(Handle<Buffer> targetHandle, void *data) {
   if (!data) {
     return;
   }
-  Buffer *stagingBuffer = getBuffer(stagingBufferHandle);
+  Buffer *stagingBuffer = getBuffer(frameStagingBufferHandles[currentFrame]);
   Buffer *targetBuffer = getBuffer(targetHandle);
 
-  memcpy(stagingBuffer->allocationInfo.pMappedData, data, targetBuffer->size);
+  size_t offset = frameStagingOffsets[currentFrame];
+  if (offset + targetBuffer->size > stagingBuffer->size) {
+    spdlog::warn("GpuDevice: Frame staging buffer full, uploading {} "
+                 "immediately",
+                 targetBuffer->name);
+    uploadBufferData(targetHandle, data);
+    return;
+  }
 
-  VkCommandBuffer cmd = getCommandBuffer();
-  VkBufferCopy2 region = {
-      .sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2,
-      .size = targetBuffer->size,
-  };
+  memcpy(static_cast<uint8_t *>(stagingBuffer->allocationInfo.pMappedData) +
+             offset,
+         data, targetBuffer->size);
 
-  VkCopyBufferInfo2 copyInfo = {
-      .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
-      .srcBuffer = stagingBuffer->buffer,
+  queuedBufferUploads[currentFrame].push_back({
       .dstBuffer = targetBuffer->buffer,
-      .regionCount = 1,
-      .pRegions = &region,
-  };
+      .srcOffset = offset,
+      .size = targetBuffer->size,
+  });
 
-  vkCmdCopyBuffer2(cmd, &copyInfo);
+  frameStagingOffsets[currentFrame] =
+      VkHelper::memoryAlign(offset + targetBuffer->size, 16);
+}
 
-  VkBufferMemoryBarrier2 barrier = {
-      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+void GpuDevice::flushQueuedUploads(VkCommandBuffer cmd) {
+  std::vector<QueuedBufferUpload> &uploads = queuedBufferUploads[currentFrame];
+  if (uploads.empty()) {
+    return;
+  }
+
+  Buffer *stagingBuffer = getBuffer(frameStagingBufferHandles[currentFrame]);
+
+  // previous frames may still be reading the destination buffers
+  VkMemoryBarrier2 preCopyBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
       .pNext = nullptr,
-      .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .srcAccessMask = 0,
       .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-      .dstAccessMask = 0,
-      .buffer = targetBuffer->buffer,
-      .offset = 0,
-      .size = targetBuffer->size,
+      .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
   };
 
   VkDependencyInfo depInfo = {
       .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
       .pNext = nullptr,
       .dependencyFlags = 0,
-      .bufferMemoryBarrierCount = 1,
-      .pBufferMemoryBarriers = &barrier,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &preCopyBarrier,
   };
 
   vkCmdPipelineBarrier2(cmd, &depInfo);
 
-  submitImmediate(cmd);
+  for (const auto &upload : uploads) {
+    VkBufferCopy2 region = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2,
+        .srcOffset = upload.srcOffset,
+        .dstOffset = 0,
+        .size = upload.size,
+    };
+
+    VkCopyBufferInfo2 copyInfo = {
+        .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
+        .srcBuffer = stagingBuffer->buffer,
+        .dstBuffer = upload.dstBuffer,
+        .regionCount = 1,
+        .pRegions = &region,
+    };
+
+    vkCmdCopyBuffer2(cmd, &copyInfo);
+  }
+
+  VkMemoryBarrier2 postCopyBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .pNext = nullptr,
+      .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .dstAccessMask = VK_ACCESS_2_UNIFORM_READ_BIT |
+                       VK_ACCESS_2_SHADER_READ_BIT |
+                       VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+  };
+
+  depInfo.pMemoryBarriers = &postCopyBarrier;
+
+  vkCmdPipelineBarrier2(cmd, &depInfo);
+
+  uploads.clear();
 }
 
 void GpuDevice::createDrawTexture() {
@@ -1866,102 +3080,6 @@ void GpuDevice::createDrawTexture() {
 
 void GpuDevice::destroyDrawTexture() { destroyTexture(drawTexture); }
 
-void GpuDevice::transitionDrawTextureToColorAttachment(VkCommandBuffer cmd) {
-  VkImageMemoryBarrier2 barrier = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-      .pNext = nullptr,
-      .srcStageMask = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-      .srcAccessMask = 0,
-      .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-      .dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-      .image = getTexture(drawTexture)->image,
-      .subresourceRange = VkHelper::subresourceRange(),
-  };
-
-  VkDependencyInfo dependencyInfo = {
-      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-      .pNext = nullptr,
-      .imageMemoryBarrierCount = 1,
-      .pImageMemoryBarriers = &barrier,
-  };
-
-  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
-}
-
-void GpuDevice::transitionDrawTextureToTransferSrc(VkCommandBuffer cmd) {
-  VkImageMemoryBarrier2 barrier = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-      .pNext = nullptr,
-      .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-      .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-      .dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
-      .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
-      .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-      .image = getTexture(drawTexture)->image,
-      .subresourceRange = VkHelper::subresourceRange(),
-  };
-
-  VkDependencyInfo dependencyInfo = {
-      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-      .pNext = nullptr,
-      .imageMemoryBarrierCount = 1,
-      .pImageMemoryBarriers = &barrier,
-  };
-
-  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
-}
-
-void GpuDevice::transitionSwapchainTextureToTransferDst(VkCommandBuffer cmd) {
-  VkImageMemoryBarrier2 barrier = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-      .pNext = nullptr,
-      .srcStageMask = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-      .srcAccessMask = 0,
-      .dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
-      .dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      .image = swapchainImages[swapchainImageIndex],
-      .subresourceRange = VkHelper::subresourceRange(),
-  };
-
-  VkDependencyInfo dependencyInfo = {
-      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-      .pNext = nullptr,
-      .imageMemoryBarrierCount = 1,
-      .pImageMemoryBarriers = &barrier,
-  };
-
-  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
-}
-
-void GpuDevice::transitionSwapchainTextureToPresentSrc(VkCommandBuffer cmd) {
-  VkImageMemoryBarrier2 barrier = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-      .pNext = nullptr,
-      .srcStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
-      .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-      .dstStageMask = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
-      .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
-      .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-      .image = swapchainImages[swapchainImageIndex],
-      .subresourceRange = VkHelper::subresourceRange(),
-  };
-
-  VkDependencyInfo dependencyInfo = {
-      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-      .pNext = nullptr,
-      .imageMemoryBarrierCount = 1,
-      .pImageMemoryBarriers = &barrier,
-  };
-
-  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
-}
-
 void GpuDevice::copyDrawTextureToSwapchain(VkCommandBuffer cmd) {
   VkHelper::copyImageToImage(cmd, getTexture(drawTexture)->image,
                              swapchainImages[swapchainImageIndex],
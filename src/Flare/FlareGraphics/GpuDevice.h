@@ -6,11 +6,25 @@
 
 #include <array>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <span>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "AsyncLoader.h"
+#include "GpuProfiler.h"
 #include "GpuResources.h"
+#include "MipGenerator.h"
 #include "ShaderCompiler.h"
+#include "ShaderReloader.h"
+#include "ThreadPool.h"
+
+// needs the volk function pointers declared first
+#include <tracy/TracyVulkan.hpp>
 
 struct GLFWwindow;
 
@@ -25,6 +39,10 @@ static constexpr uint32_t SAMPLERS_SET = 4;
 static constexpr uint32_t ACCEL_STRUCT_SET = 5;
 
 static constexpr size_t STAGING_BUFFER_SIZE_MB = 128;
+// immediate uploads go through the staging buffer in chunks of half its size
+static constexpr size_t UPLOAD_CHUNK_SIZE =
+    STAGING_BUFFER_SIZE_MB * 1024 * 1024 / 2;
+static constexpr size_t FRAME_STAGING_BUFFER_SIZE_MB = 8;
 
 struct ResourcePoolCI {
   uint32_t pipelines = 256;
@@ -44,8 +62,73 @@ struct BindlessSetup {
   uint32_t samplers = 4 * 1024;
 };
 
+struct QueuedBufferUpload {
+  VkBuffer dstBuffer = VK_NULL_HANDLE;
+  VkDeviceSize srcOffset = 0;
+  VkDeviceSize size = 0;
+};
+
+// only ever touched by the thread it belongs to, so needs no locking
+struct ThreadCommandPool {
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  std::vector<VkCommandBuffer> secondaryCommandBuffers;
+  uint32_t usedCount = 0;
+};
+
+template <typename T> struct DeferredDestruction {
+  Handle<T> handle;
+  uint64_t timelineValue = 0;
+};
+
+struct DeferredAllocation {
+  VmaAllocation allocation = nullptr;
+  uint64_t timelineValue = 0;
+};
+
+// shared by the pipelines building from the same shader at the same time,
+// replaced once its spirv changes. the cache doesn't keep the module alive,
+// it is destroyed when the last build holding it finishes
+struct CachedShaderModule {
+  uint64_t spirvHash = 0;
+  std::weak_ptr<VkShaderModule> module;
+};
+
+// pipelines created from identical PipelineCIs share one handle
+struct SharedPipeline {
+  std::string key;
+  uint32_t refCount = 0;
+};
+
+struct RetiredSwapchain {
+  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+  std::vector<VkImageView> imageViews;
+  uint64_t timelineValue = 0;
+};
+
+// prepended to the driver's cache data so stale caches from another driver
+// or device are discarded instead of handed to vkCreatePipelineCache
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t dataSize;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
 struct GpuDeviceCreateInfo {
   GLFWwindow *glfwWindow = nullptr;
+  // renders into drawTexture only, no surface, swapchain or present. the
+  // window is ignored and the extent is used as the swapchain extent
+  bool headless = false;
+  VkExtent2D headlessExtent = {1280, 720};
+  std::filesystem::path pipelineCachePath = "pipeline_cache.bin";
+  std::filesystem::path shaderCachePath = "shader_cache";
+  // built by flare-shaderpack, see cmake/PackShaders.cmake
+  std::filesystem::path shaderArchivePath = "CoreShaders.pack";
+  // rebuild pipelines when their shaders change on disk, ignored in
+  // FLARE_SHIPPING builds
+  bool shaderHotReload = true;
   ResourcePoolCI resourcePoolCI;
   BindlessSetup bindlessSetup;
 };
@@ -55,13 +138,15 @@ struct GpuDevice {
 
   void shutdown();
 
+  void createSurface();
+
   void setSurfaceFormat(VkFormat format);
 
   void setPresentMode(VkPresentModeKHR mode);
 
   void setSwapchainExtent();
 
-  void createSwapchain();
+  void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 
   void destroySwapchain();
 
@@ -75,18 +160,95 @@ struct GpuDevice {
 
   VkCommandBuffer getCommandBuffer(bool begin = true);
 
+  // recorded on the compute queue, the next present waits on it before any
+  // indirect draws
+  VkCommandBuffer getComputeCommandBuffer(bool begin = true);
+
+  void submitCompute();
+
+  // begins a secondary command buffer from the calling thread's pool, usable
+  // from the main thread and threadPool's workers only
+  VkCommandBuffer getSecondaryCommandBuffer();
+
+  // records each recorder into its own secondary command buffer on the thread
+  // pool, then executes them on cmd in the order given
+  void recordParallel(
+      VkCommandBuffer cmd,
+      std::span<const std::function<void(VkCommandBuffer)>> recorders);
+
   void submitImmediate(VkCommandBuffer cmd);
 
+  // returns the existing handle if an identical pipeline was already created,
+  // every call needs a matching destroyPipeline
   Handle<Pipeline> createPipeline(const PipelineCI &ci);
 
-  void recreatePipeline(Handle<Pipeline> handle, const PipelineCI &ci);
+  // compiles shaders and builds pipelines on the thread pool, failed entries
+  // are returned as invalid handles
+  std::vector<Handle<Pipeline>>
+  createPipelines(std::span<const PipelineCI> cis);
+
+  // until endPipelineBatch, createPipeline and createPipelines return handles
+  // right away and queue the builds. init opens a batch, so the pipelines of
+  // every pass created before the first frame are built together
+  void beginPipelineBatch();
 
+  // builds everything queued in one createPipelines style batch. a pipeline
+  // that fails keeps its handle without a VkPipeline. called by newFrame,
+  // getCommandBuffer and MipGenerator::generate, so a queued handle is never
+  // bound unbuilt
+  void endPipelineBatch();
+
+  // compiles every unique shader of cis once, then builds cis[i] into
+  // handles[i] on the thread pool. returns which ones were built
+  std::vector<uint8_t>
+  buildPipelines(std::span<const PipelineCI *const> cis,
+                 std::span<const Handle<Pipeline>> handles);
+
+  // always builds a new pipeline
+  Handle<Pipeline> createUniquePipeline(const PipelineCI &ci);
+
+  bool buildPipeline(Pipeline *pipeline, const PipelineCI &ci,
+                     std::span<const std::span<const uint32_t>> spirvs);
+
+  std::shared_ptr<VkShaderModule>
+  getShaderModule(const std::filesystem::path &path,
+                  std::span<const uint32_t> spirv);
+
+  void addSharedPipeline(Handle<Pipeline> handle, const std::string &key);
+
+  // destroyed once every user of a shared pipeline has released it
   void destroyPipeline(Handle<Pipeline> handle);
 
+  void createPipelineCache();
+
+  void savePipelineCache();
+
+  void destroyPipelineCache();
+
+  void createTracyContexts();
+
+  void destroyTracyContexts();
+
   Handle<Buffer> createBuffer(const BufferCI &ci);
 
   void uploadBufferData(Handle<Buffer> targetHandle, void *data);
 
+  // waits until the previous chunk in the same half of the staging buffer is
+  // done, the returned command buffer is begun and the half starts at
+  // stagingOffset
+  VkCommandBuffer beginUploadChunk(size_t &stagingOffset);
+
+  // submits without waiting, the next chunk goes to the other half
+  void submitUploadChunk();
+
+  void waitUploadChunks();
+
+  // copies data into the current frame's staging slice, the copy is recorded
+  // into the frame command buffer when it begins instead of blocking
+  void queueBufferUpload(Handle<Buffer> targetHandle, void *data);
+
+  void flushQueuedUploads(VkCommandBuffer cmd);
+
   void destroyBuffer(Handle<Buffer> handle);
 
   Buffer *getBuffer(Handle<Buffer> handle);
@@ -95,6 +257,10 @@ struct GpuDevice {
 
   Pipeline *getPipeline(Handle<Pipeline> handle);
 
+  VkImageCreateInfo getImageCI(const TextureCI &ci) const;
+
+  VkMemoryRequirements getTextureMemoryRequirements(const TextureCI &ci) const;
+
   Handle<Texture> createTexture(const TextureCI &ci);
 
   void uploadTextureData(Texture *texture, void *data, bool genMips);
@@ -105,6 +271,21 @@ struct GpuDevice {
 
   void destroySampler(Handle<Sampler> handle);
 
+  // deferred variants free the resource once the graphics timeline passes the
+  // frame currently being recorded
+  void destroyBufferDeferred(Handle<Buffer> handle);
+
+  void destroyTextureDeferred(Handle<Texture> handle);
+
+  void destroySamplerDeferred(Handle<Sampler> handle);
+
+  void destroyPipelineDeferred(Handle<Pipeline> handle);
+
+  // for memory textures were aliased into, queue their destruction first
+  void freeAllocationDeferred(VmaAllocation allocation);
+
+  void processDeferredDestructions(bool force = false);
+
   void createBindlessDescriptorSets(const GpuDeviceCreateInfo &ci);
 
   void destroyBindlessDescriptorSets();
@@ -117,20 +298,21 @@ struct GpuDevice {
 
   void destroyDrawTexture();
 
-  void transitionDrawTextureToColorAttachment(VkCommandBuffer cmd);
-
-  void transitionDrawTextureToTransferSrc(VkCommandBuffer cmd);
-
-  void transitionSwapchainTextureToTransferDst(VkCommandBuffer cmd);
-
-  void transitionSwapchainTextureToPresentSrc(VkCommandBuffer cmd);
-
   void copyDrawTextureToSwapchain(VkCommandBuffer cmd);
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
 
   ShaderCompiler shaderCompiler;
+  ShaderReloader shaderReloader;
+  ThreadPool threadPool;
+  GpuProfiler profiler;
+  AsyncLoader asyncLoader;
+  MipGenerator mipGenerator;
+
+  TracyVkCtx tracyMainContext = nullptr;
+  TracyVkCtx tracyComputeContext = nullptr;
+  TracyVkCtx tracyTransferContext = nullptr;
 
   GLFWwindow *glfwWindow;
   VkSurfaceKHR surface;
@@ -146,6 +328,7 @@ struct GpuDevice {
   std::vector<Handle<Texture>> depthTextures;
   uint32_t swapchainImageIndex = 0;
   bool resized = false;
+  bool headless = false;
 
   bool swapchainExtensionPresent = false;
   bool accelStructExtensionPresent = false;
@@ -162,12 +345,30 @@ struct GpuDevice {
   std::array<VkCommandBuffer, FRAMES_IN_FLIGHT> commandBuffers;
   VkFence immediateFence;
 
+  // one per staging buffer half
+  VkCommandPool uploadCommandPool;
+  std::array<VkCommandBuffer, 2> uploadCommandBuffers;
+  std::array<VkFence, 2> uploadFences;
+  std::array<bool, 2> uploadsInFlight = {};
+  uint32_t uploadChunkIndex = 0;
+
+  std::array<VkCommandPool, FRAMES_IN_FLIGHT> computeCommandPools;
+  std::array<VkCommandBuffer, FRAMES_IN_FLIGHT> computeCommandBuffers;
+  VkSemaphore computeTimelineSemaphore;
+  bool computeSubmitted = false;
+
+  // indexed by threadPool.threadIndex()
+  std::array<std::vector<ThreadCommandPool>, FRAMES_IN_FLIGHT>
+      threadCommandPools;
+
   VkPhysicalDevice physicalDevice;
   VkPhysicalDeviceProperties physicalDeviceProperties;
   VkPhysicalDeviceFeatures physicalDeviceFeatures;
   VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
 
   VkDevice device;
+  // compute and transfer fall back to the main queue on devices with a
+  // single queue family, e.g. software rasterizers
   VkQueue mainQueue;
   VkQueue computeQueue;
   VkQueue transferQueue;
@@ -175,9 +376,19 @@ struct GpuDevice {
   uint32_t computeFamily;
   uint32_t transferFamily;
 
+  std::filesystem::path pipelineCachePath;
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
   VkDescriptorPool bindlessDescriptorPool;
   std::vector<VkDescriptorSetLayout> bindlessDescriptorSetLayouts;
   std::vector<VkDescriptorSet> bindlessDescriptorSets;
+  // every pipeline uses the bindless sets and the same push constants
+  VkPipelineLayout bindlessPipelineLayout = VK_NULL_HANDLE;
+
+  // by normalized shader path, locked since pipelines build on the thread pool
+  // and the shader reloader
+  std::mutex shaderModuleMutex;
+  std::unordered_map<std::string, CachedShaderModule> shaderModules;
 
   VmaAllocator allocator;
 
@@ -185,11 +396,26 @@ struct GpuDevice {
   Handle<Texture> drawTexture;
 
   Handle<Buffer> stagingBufferHandle;
+
+  // linear per-frame staging, reused once the timeline semaphore passes the
+  // frame that last used it
+  std::array<Handle<Buffer>, FRAMES_IN_FLIGHT> frameStagingBufferHandles;
+  std::array<size_t, FRAMES_IN_FLIGHT> frameStagingOffsets = {};
+  std::array<std::vector<QueuedBufferUpload>, FRAMES_IN_FLIGHT>
+      queuedBufferUploads;
+
   Handle<Sampler> defaultSampler;
   Handle<Texture> defaultTexture;
   Handle<Texture> defaultNormalTexture;
 
   ResourcePool<Pipeline> pipelines;
+  std::unordered_map<std::string, Handle<Pipeline>> pipelineLookup;
+  // by pipeline handle index, handles from createUniquePipeline aren't in here
+  std::unordered_map<uint32_t, SharedPipeline> sharedPipelines;
+  bool batchingPipelines = false;
+  // queued while batching, the handles are already shared
+  std::vector<PipelineCI> batchedPipelineCIs;
+  std::vector<Handle<Pipeline>> batchedPipelineHandles;
   ResourcePool<Buffer> storageBuffers;
   ResourcePool<Buffer> uniformBuffers;
   ResourcePool<Texture> textures;
@@ -197,6 +423,13 @@ struct GpuDevice {
       storageTextures; // to ensure proper storage image indexing
   ResourcePool<Sampler> samplers;
 
+  std::vector<DeferredDestruction<Buffer>> deferredBuffers;
+  std::vector<DeferredDestruction<Texture>> deferredTextures;
+  std::vector<DeferredDestruction<Sampler>> deferredSamplers;
+  std::vector<DeferredDestruction<Pipeline>> deferredPipelines;
+  std::vector<DeferredAllocation> deferredAllocations;
+  std::vector<RetiredSwapchain> retiredSwapchains;
+
   template <typename T>
   void setVkObjectName(T handle, VkObjectType type,
                        const std::string &name) const {
@@ -0,0 +1,250 @@
+#include "GpuProfiler.h"
+#include "GpuDevice.h"
+
+#include <algorithm>
+#include <imgui.h>
+#include <spdlog/spdlog.h>
+
+namespace Flare {
+// scopes opened on this thread, UINT32_MAX for ones that didn't fit
+static thread_local std::vector<uint32_t> openScopes;
+
+void GpuScopeStats::addSample(float ms) {
+  last = ms;
+  history[historyIndex] = ms;
+  historyIndex = (historyIndex + 1) % PROFILER_HISTORY_SIZE;
+  sampleCount = std::min(sampleCount + 1, PROFILER_HISTORY_SIZE);
+}
+
+float GpuScopeStats::average() const {
+  if (sampleCount == 0) {
+    return 0.f;
+  }
+  float sum = 0.f;
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    sum += history[i];
+  }
+  return sum / static_cast<float>(sampleCount);
+}
+
+float GpuScopeStats::percentile(float p) const {
+  if (sampleCount == 0) {
+    return 0.f;
+  }
+  std::array<float, PROFILER_HISTORY_SIZE> sorted = history;
+  std::sort(sorted.begin(), sorted.begin() + sampleCount);
+  uint32_t index = static_cast<uint32_t>(p * (sampleCount - 1) + 0.5f);
+  return sorted[index];
+}
+
+void GpuProfiler::init(GpuDevice *gpuDevice) {
+  gpu = gpuDevice;
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(gpu->physicalDevice,
+                                           &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      gpu->physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+  // scopes can be recorded on both the main and the compute queue
+  uint32_t validBits =
+      std::min(queueFamilies[gpu->mainFamily].timestampValidBits,
+               queueFamilies[gpu->computeFamily].timestampValidBits);
+  if (validBits == 0) {
+    spdlog::warn("GpuProfiler: Timestamps not supported on main or compute "
+                 "queue");
+    return;
+  }
+  timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+  timestampPeriod = gpu->physicalDeviceProperties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo queryPoolCI = {
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = PROFILER_MAX_SCOPES * 2 * FRAMES_IN_FLIGHT,
+  };
+
+  if (vkCreateQueryPool(gpu->device, &queryPoolCI, nullptr, &queryPool) !=
+      VK_SUCCESS) {
+    spdlog::error("GpuProfiler: Failed to create query pool");
+    return;
+  }
+  vkResetQueryPool(gpu->device, queryPool, 0, queryPoolCI.queryCount);
+
+  frameScopeNames.resize(FRAMES_IN_FLIGHT);
+  frameNumbers.resize(FRAMES_IN_FLIGHT, 0);
+
+  enabled = true;
+}
+
+void GpuProfiler::shutdown() {
+  stopCsv();
+  if (queryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(gpu->device, queryPool, nullptr);
+  }
+}
+
+void GpuProfiler::newFrame() {
+  if (!enabled) {
+    return;
+  }
+
+  uint32_t frame = gpu->currentFrame;
+  uint32_t firstQuery = frame * PROFILER_MAX_SCOPES * 2;
+  std::vector<std::string> &scopeNames = frameScopeNames[frame];
+
+  resolvedFrame = UINT64_MAX;
+  resolvedScopes.clear();
+
+  if (!scopeNames.empty()) {
+    std::array<uint64_t, PROFILER_MAX_SCOPES * 2> timestamps;
+    uint32_t queryCount = static_cast<uint32_t>(scopeNames.size()) * 2;
+
+    // the timeline wait in newFrame guarantees these are available, so this
+    // never blocks
+    VkResult result = vkGetQueryPoolResults(
+        gpu->device, queryPool, firstQuery, queryCount,
+        queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+
+    if (result == VK_SUCCESS) {
+      resolvedFrame = frameNumbers[frame];
+      for (size_t i = 0; i < scopeNames.size(); i++) {
+        uint64_t begin = timestamps[i * 2] & timestampMask;
+        uint64_t end = timestamps[i * 2 + 1] & timestampMask;
+        float ms = static_cast<float>(end - begin) * timestampPeriod / 1e6f;
+
+        GpuScopeStats *scopeStats = getStats(scopeNames[i]);
+        if (!scopeStats) {
+          stats.push_back({.name = scopeNames[i]});
+          scopeStats = &stats.back();
+        }
+        scopeStats->addSample(ms);
+        resolvedScopes.push_back({.name = scopeNames[i], .ms = ms});
+
+        if (writeCsv) {
+          csvFile << frameNumbers[frame] << "," << scopeNames[i] << "," << ms
+                  << "\n";
+        }
+      }
+    }
+  }
+
+  vkResetQueryPool(gpu->device, queryPool, firstQuery, PROFILER_MAX_SCOPES * 2);
+  scopeNames.clear();
+  frameNumbers[frame] = gpu->absoluteFrame;
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer cmd, const std::string &name) {
+  if (!enabled) {
+    return;
+  }
+
+  uint32_t scope;
+  {
+    std::lock_guard<std::mutex> lock(scopeMutex);
+    std::vector<std::string> &scopeNames = frameScopeNames[gpu->currentFrame];
+    if (scopeNames.size() >= PROFILER_MAX_SCOPES) {
+      spdlog::warn("GpuProfiler: Too many scopes, ignoring {}", name);
+      openScopes.push_back(UINT32_MAX);
+      return;
+    }
+
+    scope = static_cast<uint32_t>(scopeNames.size());
+    scopeNames.push_back(name);
+  }
+  openScopes.push_back(scope);
+
+  uint32_t query = gpu->currentFrame * PROFILER_MAX_SCOPES * 2 + scope * 2;
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, queryPool,
+                       query);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer cmd) {
+  if (!enabled || openScopes.empty()) {
+    return;
+  }
+
+  uint32_t scope = openScopes.back();
+  openScopes.pop_back();
+  if (scope == UINT32_MAX) {
+    return;
+  }
+
+  uint32_t query = gpu->currentFrame * PROFILER_MAX_SCOPES * 2 + scope * 2 + 1;
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, queryPool,
+                       query);
+}
+
+void GpuProfiler::startCsv(const std::filesystem::path &path) {
+  csvFile.open(path, std::ios::trunc);
+  if (!csvFile.is_open()) {
+    spdlog::error("GpuProfiler: Failed to open {}", path.string());
+    writeCsv = false;
+    return;
+  }
+  csvFile << "frame,scope,ms\n";
+  writeCsv = true;
+}
+
+void GpuProfiler::stopCsv() {
+  if (csvFile.is_open()) {
+    csvFile.close();
+  }
+  writeCsv = false;
+}
+
+void GpuProfiler::drawImguiWindow() {
+  ImGui::Begin("GPU Profiler");
+
+  if (!enabled) {
+    ImGui::Text("Timestamp queries not supported");
+    ImGui::End();
+    return;
+  }
+
+  bool csv = writeCsv;
+  if (ImGui::Checkbox("Write gpu_timings.csv", &csv)) {
+    if (csv) {
+      startCsv("gpu_timings.csv");
+    } else {
+      stopCsv();
+    }
+  }
+
+  if (ImGui::BeginTable("scopes", 4)) {
+    ImGui::TableSetupColumn("Scope");
+    ImGui::TableSetupColumn("Last (ms)");
+    ImGui::TableSetupColumn("Avg (ms)");
+    ImGui::TableSetupColumn("P99 (ms)");
+    ImGui::TableHeadersRow();
+
+    for (const auto &scopeStats : stats) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(scopeStats.name.c_str());
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", scopeStats.last);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", scopeStats.average());
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", scopeStats.percentile(0.99f));
+    }
+    ImGui::EndTable();
+  }
+
+  ImGui::End();
+}
+
+GpuScopeStats *GpuProfiler::getStats(const std::string &name) {
+  for (auto &scopeStats : stats) {
+    if (scopeStats.name == name) {
+      return &scopeStats;
+    }
+  }
+  return nullptr;
+}
+} // namespace Flare
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <volk.h>
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Flare {
+struct GpuDevice;
+
+static constexpr uint32_t PROFILER_MAX_SCOPES = 64;
+static constexpr uint32_t PROFILER_HISTORY_SIZE = 256;
+
+struct GpuScopeTiming {
+  std::string name;
+  float ms = 0.f;
+};
+
+struct GpuScopeStats {
+  void addSample(float ms);
+
+  float average() const;
+
+  float percentile(float p) const;
+
+  std::string name;
+  std::array<float, PROFILER_HISTORY_SIZE> history = {};
+  uint32_t historyIndex = 0;
+  uint32_t sampleCount = 0;
+  float last = 0.f;
+};
+
+struct GpuProfiler {
+  void init(GpuDevice *gpuDevice);
+
+  void shutdown();
+
+  // reads back the results of the frame that last used the current slot, must
+  // be called after the timeline wait in GpuDevice::newFrame
+  void newFrame();
+
+  // scopes may be recorded from several threads at once, but a scope must end
+  // on the thread that began it
+  void beginScope(VkCommandBuffer cmd, const std::string &name);
+
+  void endScope(VkCommandBuffer cmd);
+
+  void startCsv(const std::filesystem::path &path);
+
+  void stopCsv();
+
+  void drawImguiWindow();
+
+  GpuScopeStats *getStats(const std::string &name);
+
+  GpuDevice *gpu = nullptr;
+
+  bool enabled = false;
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  float timestampPeriod = 1.f;
+  uint64_t timestampMask = UINT64_MAX;
+
+  // per frame in flight
+  std::vector<std::vector<std::string>> frameScopeNames;
+  std::vector<uint64_t> frameNumbers;
+  std::mutex scopeMutex;
+
+  std::vector<GpuScopeStats> stats;
+
+  // the scopes read back by the last newFrame and the frame they were
+  // recorded in, UINT64_MAX if nothing was read back
+  uint64_t resolvedFrame = UINT64_MAX;
+  std::vector<GpuScopeTiming> resolvedScopes;
+
+  std::ofstream csvFile;
+  bool writeCsv = false;
+};
+} // namespace Flare
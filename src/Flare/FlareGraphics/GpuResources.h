@@ -21,9 +21,18 @@ enum class BufferType {
   eUniform,
 };
 
+// value of a constant_id in the shader, bools are 0 or 1 and floats go
+// through std::bit_cast
+struct SpecializationConstant {
+  uint32_t id = 0;
+  uint32_t value = 0;
+};
+
 struct ShaderStage {
   std::filesystem::path path;
   VkShaderStageFlagBits stage = VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM;
+  // constants left out keep the default from the shader
+  std::vector<SpecializationConstant> specializationConstants;
 };
 
 struct VertexInputCI {
@@ -153,6 +162,14 @@ struct TextureCI {
   bool cubemap = false;
   bool offscreenDraw = false;
   bool storage = false;
+  // mip 0 holds srgb encoded values in a unorm or float format, the generated
+  // mips are averaged in linear space
+  bool srgb = false;
+
+  // bound into this allocation instead of getting its own, the texture then
+  // doesn't own the memory
+  VmaAllocation aliasAllocation = nullptr;
+  VkDeviceSize aliasOffset = 0;
 };
 
 struct Texture {
@@ -166,6 +183,11 @@ struct Texture {
   uint32_t depth = 1;
   uint32_t mipLevel = 1;
   uint32_t layerCount = 1;
+  bool srgb = false;
+
+  // per mip storage views for MipGenerator, created on first use
+  std::vector<VkImageView> mipViews;
+  uint32_t mipBlock = invalidIndex;
 
   std::string name;
 };
@@ -307,6 +329,8 @@ struct MeshDrawBuffers {
   Handle<Buffer> normals;
   Handle<Buffer> tangents;
   Handle<Buffer> transforms;
+  // per draw, indexed like transforms. decodes quantized positions
+  Handle<Buffer> bounds;
   Handle<Buffer> materials;
   Handle<Buffer> textures;
   Handle<Buffer> indirectDraws;
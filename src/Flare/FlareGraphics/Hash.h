@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Flare {
+// fnv-1a, stable across runs and platforms unlike std::hash
+inline uint64_t hashBytes(const void *data, size_t size,
+                          uint64_t hash = 0xcbf29ce484222325) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+} // namespace Flare
@@ -0,0 +1,95 @@
+#include "MappedFile.h"
+
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Flare {
+bool MappedFile::open(const std::filesystem::path &path) {
+  close();
+
+#ifdef _WIN32
+  fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    fileHandle = nullptr;
+    spdlog::error("MappedFile: Failed to open {}", path.string());
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(fileHandle, &fileSize);
+  size = static_cast<size_t>(fileSize.QuadPart);
+
+  if (size > 0) {
+    mappingHandle =
+        CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle) {
+      data = static_cast<const uint8_t *>(
+          MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+  }
+#else
+  fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    spdlog::error("MappedFile: Failed to open {}", path.string());
+    return false;
+  }
+
+  struct stat fileStat;
+  fstat(fd, &fileStat);
+  size = static_cast<size_t>(fileStat.st_size);
+
+  if (size > 0) {
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      data = static_cast<const uint8_t *>(mapped);
+    }
+  }
+#endif
+
+  if (!data) {
+    spdlog::error("MappedFile: Failed to map {}", path.string());
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+  if (data) {
+    UnmapViewOfFile(data);
+  }
+  if (mappingHandle) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle) {
+    CloseHandle(fileHandle);
+  }
+  mappingHandle = nullptr;
+  fileHandle = nullptr;
+#else
+  if (data) {
+    munmap(const_cast<uint8_t *>(data), size);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  fd = -1;
+#endif
+
+  data = nullptr;
+  size = 0;
+}
+} // namespace Flare
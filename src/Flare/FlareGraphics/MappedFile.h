@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace Flare {
+// read only memory mapping of a whole file, data stays valid until close
+struct MappedFile {
+  bool open(const std::filesystem::path &path);
+
+  void close();
+
+  bool isOpen() const { return data != nullptr; }
+
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  void *fileHandle = nullptr;
+  void *mappingHandle = nullptr;
+#else
+  int fd = -1;
+#endif
+};
+} // namespace Flare
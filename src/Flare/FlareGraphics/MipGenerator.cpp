@@ -0,0 +1,264 @@
+#include "MipGenerator.h"
+#include "GpuDevice.h"
+#include "VkHelper.h"
+
+#include <tracy/Tracy.hpp>
+
+namespace Flare {
+void MipGenerator::init(GpuDevice *gpuDevice, uint32_t storageBase,
+                        uint32_t storageCount) {
+  gpu = gpuDevice;
+  this->storageBase = storageBase;
+
+  // mip 0 is read through its storage view too
+  readWithoutFormat =
+      gpu->physicalDeviceFeatures.shaderStorageImageReadWithoutFormat &&
+      gpu->physicalDeviceFeatures.shaderStorageImageWriteWithoutFormat;
+  if (!readWithoutFormat) {
+    spdlog::warn("MipGenerator: Storage images without format aren't "
+                 "supported, generating mips with blits");
+    return;
+  }
+
+  uint32_t blockCount = 0;
+  if (storageCount > storageBase) {
+    blockCount = std::min((storageCount - storageBase) / MIP_GENERATOR_MAX_MIPS,
+                          MIP_GENERATOR_MAX_TEXTURES);
+  }
+  freeBlocks.reserve(blockCount);
+  for (uint32_t i = blockCount; i > 0; i--) {
+    freeBlocks.push_back(i - 1);
+  }
+
+  std::vector<uint32_t> counters(
+      MIP_GENERATOR_MAX_TEXTURES * MIP_GENERATOR_MAX_LAYERS, 0);
+  BufferCI counterCI = {
+      .initialData = counters.data(),
+      .size = counters.size() * sizeof(uint32_t),
+      .usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .name = "mip generator counters",
+  };
+  counterBufferHandle = gpu->createBuffer(counterCI);
+
+  PipelineCI pipelineCI;
+  pipelineCI.shaderStages = {
+      {"CoreShaders/GenerateMips.comp", VK_SHADER_STAGE_COMPUTE_BIT},
+  };
+  pipelineHandle = gpu->createPipeline(pipelineCI);
+}
+
+void MipGenerator::shutdown() {
+  if (pipelineHandle.isValid()) {
+    gpu->destroyPipeline(pipelineHandle);
+  }
+  if (counterBufferHandle.isValid()) {
+    gpu->destroyBuffer(counterBufferHandle);
+  }
+}
+
+bool MipGenerator::supportsFormat(VkFormat format) const {
+  if (!readWithoutFormat) {
+    return false;
+  }
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(gpu->physicalDevice, format,
+                                      &properties);
+  return properties.optimalTilingFeatures &
+         VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+}
+
+void MipGenerator::generate(VkCommandBuffer cmd, Texture *texture) {
+  ZoneScoped;
+
+  // textures can be uploaded before the first frame builds the batch
+  gpu->endPipelineBatch();
+
+  if (!pipelineHandle.isValid() || !supportsFormat(texture->format) ||
+      texture->mipLevel < 2 || texture->mipLevel > MIP_GENERATOR_MAX_MIPS ||
+      texture->layerCount > MIP_GENERATOR_MAX_LAYERS ||
+      (texture->mipBlock == invalidIndex && !createMipViews(texture))) {
+    generateBlit(cmd, texture);
+    return;
+  }
+
+  VkImageSubresourceRange subresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = texture->mipLevel,
+      .baseArrayLayer = 0,
+      .layerCount = texture->layerCount,
+  };
+
+  VkImageMemoryBarrier2 preBarrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .pNext = nullptr,
+      .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                       VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = texture->image,
+      .subresourceRange = subresourceRange,
+  };
+
+  VkDependencyInfo dependencyInfo = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .pNext = nullptr,
+      .dependencyFlags = 0,
+      .imageMemoryBarrierCount = 1,
+      .pImageMemoryBarriers = &preBarrier,
+  };
+
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+  Pipeline *pipeline = gpu->getPipeline(pipelineHandle);
+
+  PushConstants pc = {
+      .data0 = storageBase + texture->mipBlock * MIP_GENERATOR_MAX_MIPS,
+      .data1 = texture->mipLevel,
+      .data2 = counterBufferHandle.index,
+      .data3 = texture->mipBlock * MIP_GENERATOR_MAX_LAYERS,
+      .data4 = texture->srgb,
+      .data5 = texture->width,
+      .data6 = texture->height,
+  };
+
+  vkCmdBindPipeline(cmd, pipeline->bindPoint, pipeline->pipeline);
+  vkCmdPushConstants(cmd, pipeline->pipelineLayout, VK_SHADER_STAGE_ALL, 0,
+                     sizeof(PushConstants), &pc);
+  vkCmdBindDescriptorSets(cmd, pipeline->bindPoint, pipeline->pipelineLayout, 0,
+                          gpu->bindlessDescriptorSets.size(),
+                          gpu->bindlessDescriptorSets.data(), 0, nullptr);
+
+  // one workgroup per 64x64 tile of mip 0
+  vkCmdDispatch(cmd, (texture->width + 63) / 64, (texture->height + 63) / 64,
+                texture->layerCount);
+
+  VkImageMemoryBarrier2 postBarrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .pNext = nullptr,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+      .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = texture->image,
+      .subresourceRange = subresourceRange,
+  };
+
+  dependencyInfo.pImageMemoryBarriers = &postBarrier;
+
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+  // the views are only needed until this dispatch has run
+  std::erase_if(pendingReleases,
+                [&](const auto &entry) { return entry.texture == texture; });
+  pendingReleases.push_back({texture, gpu->absoluteFrame + 1});
+}
+
+bool MipGenerator::createMipViews(Texture *texture) {
+  if (freeBlocks.empty()) {
+    if (!warnedNoBlocks) {
+      spdlog::warn("MipGenerator: All {} mip view blocks are in use, "
+                   "generating mips with blits",
+                   MIP_GENERATOR_MAX_TEXTURES);
+      warnedNoBlocks = true;
+    }
+    return false;
+  }
+
+  texture->mipBlock = freeBlocks.back();
+  freeBlocks.pop_back();
+
+  texture->mipViews.resize(texture->mipLevel);
+  std::vector<VkDescriptorImageInfo> imageInfos(texture->mipLevel);
+  for (uint32_t mip = 0; mip < texture->mipLevel; mip++) {
+    VkImageViewCreateInfo viewCI = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .image = texture->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format = texture->format,
+        .components = VkHelper::identityRGBA(),
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = mip,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = texture->layerCount,
+            },
+    };
+
+    vkCreateImageView(gpu->device, &viewCI, nullptr, &texture->mipViews[mip]);
+
+    imageInfos[mip] = {
+        .imageView = texture->mipViews[mip],
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+  }
+
+  VkWriteDescriptorSet write = {
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = gpu->bindlessDescriptorSets[STORAGE_IMAGES_SET],
+      .dstBinding = 0,
+      .dstArrayElement = storageBase + texture->mipBlock * MIP_GENERATOR_MAX_MIPS,
+      .descriptorCount = texture->mipLevel,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      .pImageInfo = imageInfos.data(),
+  };
+
+  vkUpdateDescriptorSets(gpu->device, 1, &write, 0, nullptr);
+
+  return true;
+}
+
+void MipGenerator::processReleases(uint64_t completedValue) {
+  std::erase_if(pendingReleases, [&](const auto &entry) {
+    if (entry.timelineValue > completedValue) {
+      return false;
+    }
+    destroyMipViews(entry.texture);
+    return true;
+  });
+}
+
+void MipGenerator::releaseMipViews(Texture *texture) {
+  std::erase_if(pendingReleases,
+                [&](const auto &entry) { return entry.texture == texture; });
+  destroyMipViews(texture);
+}
+
+void MipGenerator::destroyMipViews(Texture *texture) {
+  if (texture->mipBlock == invalidIndex) {
+    return;
+  }
+
+  for (auto &view : texture->mipViews) {
+    vkDestroyImageView(gpu->device, view, nullptr);
+  }
+  texture->mipViews.clear();
+
+  freeBlocks.push_back(texture->mipBlock);
+  texture->mipBlock = invalidIndex;
+  warnedNoBlocks = false;
+}
+
+void MipGenerator::generateBlit(VkCommandBuffer cmd, Texture *texture) {
+  if (texture->layerCount == 6) {
+    VkHelper::genCubemapMips(cmd, texture->image,
+                             {texture->width, texture->height});
+  } else {
+    VkHelper::genMips(cmd, texture->image, {texture->width, texture->height});
+  }
+}
+} // namespace Flare
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "GpuResources.h"
+
+#include <vector>
+
+namespace Flare {
+struct GpuDevice;
+
+// mip views of a generated texture, freed once the graphics timeline passes
+// timelineValue
+struct PendingMipRelease {
+  Texture *texture = nullptr;
+  uint64_t timelineValue = 0;
+};
+
+// bindless storage image slots reserved per texture, one per mip
+static constexpr uint32_t MIP_GENERATOR_MAX_MIPS = 16;
+static constexpr uint32_t MIP_GENERATOR_MAX_TEXTURES = 1024;
+static constexpr uint32_t MIP_GENERATOR_MAX_LAYERS = 6;
+
+// builds every mip of a 2d texture or cubemap in one compute dispatch, see
+// GenerateMips.comp. falls back to the blit chain when the format can't be
+// used as a storage image
+struct MipGenerator {
+  // storage image slots from storageBase up to storageCount are used for the
+  // mip views
+  void init(GpuDevice *gpuDevice, uint32_t storageBase, uint32_t storageCount);
+
+  void shutdown();
+
+  // textures with genMips in these formats are created with storage usage
+  bool supportsFormat(VkFormat format) const;
+
+  // every mip is expected in transfer dst with mip 0 filled in, they end up in
+  // shader read only. cmd has to be submitted to the main queue before the
+  // current frame is, its mip views are released after that frame completes
+  void generate(VkCommandBuffer cmd, Texture *texture);
+
+  // called from processDeferredDestructions
+  void processReleases(uint64_t completedValue);
+
+  // called when the texture is destroyed
+  void releaseMipViews(Texture *texture);
+
+  bool createMipViews(Texture *texture);
+
+  void destroyMipViews(Texture *texture);
+
+  void generateBlit(VkCommandBuffer cmd, Texture *texture);
+
+  GpuDevice *gpu = nullptr;
+
+  Handle<Pipeline> pipelineHandle;
+  bool readWithoutFormat = false;
+
+  uint32_t storageBase = 0;
+  std::vector<uint32_t> freeBlocks;
+  std::vector<PendingMipRelease> pendingReleases;
+  bool warnedNoBlocks = false;
+
+  // one counter per layer and block, the last workgroup resets its counter
+  Handle<Buffer> counterBufferHandle;
+};
+} // namespace Flare
@@ -2,7 +2,9 @@
 #include "GpuDevice.h"
 #include "ImGuiFileDialog.h"
 
+#include <algorithm>
 #include <imgui.h>
+#include <tracy/Tracy.hpp>
 
 namespace Flare {
 
@@ -58,16 +60,25 @@ Handle<ModelPrefab> ModelManager::loadPrefab(std::filesystem::path path) {
   gltf.init(path, gpu);
 
   modelPrefab->indexOffset = indices.size();
-  modelPrefab->vertexOffset = positions.size();
+  modelPrefab->vertexOffset = quantizedVertices
+                                  ? quantizedVertexData.positions.size()
+                                  : positions.size();
   modelPrefab->materialOffset = materials.size();
   modelPrefab->transformOffset = transforms.size();
+  modelPrefab->textureOffset = textureIndices.size();
+  modelPrefab->texturesVersion = gltf.texturesVersion;
 
   indices.insert(indices.end(), gltf.indices.begin(), gltf.indices.end());
-  positions.insert(positions.end(), gltf.positions.begin(),
-                   gltf.positions.end());
-  normals.insert(normals.end(), gltf.normals.begin(), gltf.normals.end());
-  tangents.insert(tangents.end(), gltf.tangents.begin(), gltf.tangents.end());
-  uvs.insert(uvs.end(), gltf.uvs.begin(), gltf.uvs.end());
+  if (quantizedVertices) {
+    appendQuantizedVertices(gltf, quantizedVertexData);
+  } else {
+    positions.insert(positions.end(), gltf.positions.begin(),
+                     gltf.positions.end());
+    normals.insert(normals.end(), gltf.normals.begin(), gltf.normals.end());
+    tangents.insert(tangents.end(), gltf.tangents.begin(),
+                    gltf.tangents.end());
+    uvs.insert(uvs.end(), gltf.uvs.begin(), gltf.uvs.end());
+  }
   materials.reserve(materials.size() + gltf.materials.size());
   for (const auto &material : gltf.materials) {
     Material mat = material;
@@ -123,28 +134,26 @@ ModelManager::addInstance(Handle<ModelPrefab> prefabHandle) {
   return handle;
 }
 void ModelManager::destroyModelBuffers() {
-  vkDeviceWaitIdle(gpu->device); // TODO: sync
-
   if (indexBufferHandle.isValid()) {
-    gpu->destroyBuffer(indexBufferHandle);
+    gpu->destroyBufferDeferred(indexBufferHandle);
   }
   if (positionBufferHandle.isValid()) {
-    gpu->destroyBuffer(positionBufferHandle);
+    gpu->destroyBufferDeferred(positionBufferHandle);
   }
   if (normalBufferHandle.isValid()) {
-    gpu->destroyBuffer(normalBufferHandle);
+    gpu->destroyBufferDeferred(normalBufferHandle);
   }
   if (tangentBufferHandle.isValid()) {
-    gpu->destroyBuffer(tangentBufferHandle);
+    gpu->destroyBufferDeferred(tangentBufferHandle);
   }
   if (uvBufferHandle.isValid()) {
-    gpu->destroyBuffer(uvBufferHandle);
+    gpu->destroyBufferDeferred(uvBufferHandle);
   }
   if (textureIndexBufferHandle.isValid()) {
-    gpu->destroyBuffer(textureIndexBufferHandle);
+    gpu->destroyBufferDeferred(textureIndexBufferHandle);
   }
   if (materialBufferHandle.isValid()) {
-    gpu->destroyBuffer(materialBufferHandle);
+    gpu->destroyBufferDeferred(materialBufferHandle);
   }
 }
 void ModelManager::buildBuffers() {
@@ -166,6 +175,11 @@ void ModelManager::buildBuffers() {
           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
       .name = "positions",
   };
+  if (quantizedVertices) {
+    positionsCI.initialData = quantizedVertexData.positions.data();
+    positionsCI.size =
+        sizeof(glm::uvec2) * quantizedVertexData.positions.size();
+  }
   positionBufferHandle = gpu->createBuffer(positionsCI);
 
   BufferCI normalsCI = {
@@ -175,6 +189,10 @@ void ModelManager::buildBuffers() {
           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
       .name = "normals",
   };
+  if (quantizedVertices) {
+    normalsCI.initialData = quantizedVertexData.normals.data();
+    normalsCI.size = sizeof(uint32_t) * quantizedVertexData.normals.size();
+  }
   normalBufferHandle = gpu->createBuffer(normalsCI);
 
   BufferCI tangentsCI = {
@@ -184,6 +202,10 @@ void ModelManager::buildBuffers() {
           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
       .name = "tangents",
   };
+  if (quantizedVertices) {
+    tangentsCI.initialData = quantizedVertexData.tangents.data();
+    tangentsCI.size = sizeof(uint32_t) * quantizedVertexData.tangents.size();
+  }
   tangentBufferHandle = gpu->createBuffer(tangentsCI);
 
   BufferCI uvsCI = {
@@ -193,6 +215,10 @@ void ModelManager::buildBuffers() {
           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
       .name = "uv",
   };
+  if (quantizedVertices) {
+    uvsCI.initialData = quantizedVertexData.uvs.data();
+    uvsCI.size = sizeof(uint32_t) * quantizedVertexData.uvs.size();
+  }
   uvBufferHandle = gpu->createBuffer(uvsCI);
 
   BufferCI textureIndicesCI = {
@@ -212,7 +238,29 @@ void ModelManager::buildBuffers() {
   materialBufferHandle = gpu->createBuffer(materialsCI);
 }
 
+void ModelManager::updateTextureIndices() {
+  bool changed = false;
+  for (auto &[path, handle] : loadedPrefabs) {
+    ModelPrefab *prefab = modelPrefabs.get(handle);
+    const GltfScene &gltf = prefab->gltfModel;
+    if (prefab->texturesVersion == gltf.texturesVersion) {
+      continue;
+    }
+
+    std::copy(gltf.gltfTextures.begin(), gltf.gltfTextures.end(),
+              textureIndices.begin() + prefab->textureOffset);
+    prefab->texturesVersion = gltf.texturesVersion;
+    changed = true;
+  }
+
+  if (changed && textureIndexBufferHandle.isValid()) {
+    gpu->queueBufferUpload(textureIndexBufferHandle, textureIndices.data());
+  }
+}
+
 void ModelManager::newFrame() {
+  ZoneScoped;
+
   if (!queuedPrefabPaths.empty()) {
     std::filesystem::path path = queuedPrefabPaths.back();
     queuedPrefabPaths.pop_back();
@@ -220,6 +268,8 @@ void ModelManager::newFrame() {
     loadPrefab(path);
   }
 
+  updateTextureIndices();
+
   indirectDrawDataRingBuffer.moveToNextBuffer();
   indirectDrawDatas.clear();
 
@@ -339,7 +389,7 @@ void ModelManager::drawImguiMenu() {
     IGFD::FileDialogConfig config;
     config.path = ".";
     ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File",
-                                            ".gltf,.glb", config);
+                                            ".gltf,.glb,.flaremesh", config);
   }
 
   if (ImGuiFileDialog::Instance()->Display("ChooseFileDlgKey")) {
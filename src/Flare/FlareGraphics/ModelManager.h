@@ -3,6 +3,7 @@
 #include "GltfScene.h"
 #include "GpuResources.h"
 #include "RingBuffer.h"
+#include "VertexQuantization.h"
 
 namespace Flare {
 struct GpuDevice;
@@ -13,6 +14,9 @@ struct ModelPrefab {
   uint32_t vertexOffset;
   uint32_t materialOffset;
   uint32_t transformOffset;
+  uint32_t textureOffset;
+  // gltfModel.texturesVersion last copied into textureIndices
+  uint32_t texturesVersion;
 };
 
 struct ModelInstance {
@@ -36,6 +40,9 @@ struct ModelManager {
 
   void buildBuffers();
 
+  // copies texture indices of prefabs whose images finished loading
+  void updateTextureIndices();
+
   void newFrame();
 
   void drawImguiMenu();
@@ -52,6 +59,10 @@ struct ModelManager {
 
   GpuDevice *gpu;
 
+  // uploads QuantizedVertices instead of the float streams, GBufferPass and
+  // ShadowPass pick it up in their init. set before init
+  bool quantizedVertices = false;
+
   int selectedPrefabIndex = -1;
   std::vector<std::filesystem::path> queuedPrefabPaths;
   std::unordered_map<std::filesystem::path, Handle<ModelPrefab>> loadedPrefabs;
@@ -76,6 +87,9 @@ struct ModelManager {
   std::vector<glm::vec2> uvs;
   Handle<Buffer> uvBufferHandle;
 
+  // with quantizedVertices, the float streams above stay empty
+  QuantizedVertices quantizedVertexData;
+
   std::vector<TextureIndex> textureIndices;
   Handle<Buffer> textureIndexBufferHandle;
 
@@ -1,6 +1,7 @@
 #include "DrawBoundsPass.h"
 #include "../GpuDevice.h"
 #include "../VkHelper.h"
+#include <tracy/Tracy.hpp>
 
 namespace Flare {
 void DrawBoundsPass::init(GpuDevice *gpuDevice) {
@@ -53,9 +54,14 @@ void DrawBoundsPass::setInputs(const DrawBoundsInputs &inputs) {
 }
 
 void DrawBoundsPass::render(VkCommandBuffer cmd) {
+  ZoneScoped;
+
   if (drawBoundsInputs.count == 0) {
     return;
   }
+  gpu->profiler.beginScope(cmd, "DrawBounds");
+  TracyVkZone(gpu->tracyMainContext, cmd, "DrawBounds");
+
   Pipeline *pipeline = gpu->getPipeline(pipelineHandle);
 
   VkRenderingAttachmentInfo colorAttachment = VkHelper::colorAttachment(
@@ -91,5 +97,7 @@ void DrawBoundsPass::render(VkCommandBuffer cmd) {
   }
 
   vkCmdEndRendering(cmd);
+
+  gpu->profiler.endScope(cmd);
 }
 } // namespace Flare
\ No newline at end of file
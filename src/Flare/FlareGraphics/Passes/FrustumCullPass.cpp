@@ -1,13 +1,16 @@
 #include "FrustumCullPass.h"
 
 #include "../GpuDevice.h"
+#include <tracy/Tracy.hpp>
 
 namespace Flare {
 void FrustumCullPass::init(GpuDevice *gpuDevice) {
   gpu = gpuDevice;
 
   pipelineCI.shaderStages = {
-      {"CoreShaders/FrustumCull.comp", VK_SHADER_STAGE_COMPUTE_BIT},
+      {"CoreShaders/FrustumCull.comp",
+       VK_SHADER_STAGE_COMPUTE_BIT,
+       {{0, workgroupSize}}},
   };
   pipelineHandle = gpu->createPipeline(pipelineCI);
 
@@ -18,10 +21,54 @@ void FrustumCullPass::init(GpuDevice *gpuDevice) {
       .bufferType = BufferType::eUniform,
   };
   frustumUniformRingBuffer.init(gpu, FRAMES_IN_FLIGHT, uniformCI);
+
+  BufferCI countCI = {
+      .size = sizeof(uint32_t),
+      .usageFlags = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+      .mapped = true,
+      .name = "culled count",
+  };
+  countRingBuffer.init(gpu, FRAMES_IN_FLIGHT, countCI);
 }
 
-void FrustumCullPass::addBarriers(VkCommandBuffer cmd, uint32_t computeFamily,
-                                  uint32_t mainFamily) {
+void FrustumCullPass::releaseOutputs(VkCommandBuffer computeCmd) {
+  if (gpu->computeFamily == gpu->mainFamily) {
+    return; // the timeline semaphore is enough within a family
+  }
+
+  addBarriers(computeCmd,
+              {
+                  .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                  .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                  .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+                  .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+                  .dstAccessMask = VK_ACCESS_2_NONE,
+                  .srcQueueFamilyIndex = gpu->computeFamily,
+                  .dstQueueFamilyIndex = gpu->mainFamily,
+              });
+}
+
+void FrustumCullPass::acquireOutputs(VkCommandBuffer cmd) {
+  if (gpu->computeFamily == gpu->mainFamily) {
+    return;
+  }
+
+  // src stage matches the stage present waits on the compute timeline at
+  addBarriers(cmd, {
+                       .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                       .srcStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                       .srcAccessMask = VK_ACCESS_2_NONE,
+                       .dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+                                       VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+                       .dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT |
+                                        VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                       .srcQueueFamilyIndex = gpu->computeFamily,
+                       .dstQueueFamilyIndex = gpu->mainFamily,
+                   });
+}
+
+void FrustumCullPass::addBarriers(VkCommandBuffer cmd,
+                                  const VkBufferMemoryBarrier2 &barrier) {
   if (!outputIndirectBufferHandle.isValid() ||
       !outputCountBufferHandle.isValid()) {
     return;
@@ -29,32 +76,15 @@ void FrustumCullPass::addBarriers(VkCommandBuffer cmd, uint32_t computeFamily,
   Buffer *outputIndirectDrawBuffer = gpu->getBuffer(outputIndirectBufferHandle);
   Buffer *outputCountBuffer = gpu->getBuffer(outputCountBufferHandle);
 
-  VkBufferMemoryBarrier2 barriers[] = {
-      {
-          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-          .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-          .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
-          .dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
-          .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-          .srcQueueFamilyIndex = computeFamily,
-          .dstQueueFamilyIndex = mainFamily,
-          .buffer = outputIndirectDrawBuffer->buffer,
-          .offset = 0,
-          .size = outputIndirectDrawBuffer->size,
-      },
-      {
-          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-          .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-          .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
-          .dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
-          .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-          .srcQueueFamilyIndex = computeFamily,
-          .dstQueueFamilyIndex = mainFamily,
-          .buffer = outputCountBuffer->buffer,
-          .offset = 0,
-          .size = outputCountBuffer->size,
-      },
-  };
+  VkBufferMemoryBarrier2 barriers[] = {barrier, barrier};
+
+  barriers[0].buffer = outputIndirectDrawBuffer->buffer;
+  barriers[0].offset = 0;
+  barriers[0].size = outputIndirectDrawBuffer->size;
+
+  barriers[1].buffer = outputCountBuffer->buffer;
+  barriers[1].offset = 0;
+  barriers[1].size = outputCountBuffer->size;
 
   VkDependencyInfo dep = {
       .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
@@ -72,12 +102,19 @@ void FrustumCullPass::shutdown() {
     gpu->destroyPipeline(pipelineHandle);
   }
   frustumUniformRingBuffer.shutdown();
+  countRingBuffer.shutdown();
 }
 
 void FrustumCullPass::cull(VkCommandBuffer cmd) {
+  ZoneScoped;
+
   if (maxDrawCount == 0) {
     return;
   }
+  gpu->profiler.beginScope(cmd, "FrustumCull");
+  TracyVkNamedZone(gpu->tracyComputeContext, cullZone, cmd, "FrustumCull",
+                   gpu->tracyComputeContext != nullptr);
+
   Pipeline *pipeline = gpu->getPipeline(pipelineHandle);
 
   pc.uniformOffset = frustumUniformRingBuffer.buffer().index;
@@ -88,7 +125,9 @@ void FrustumCullPass::cull(VkCommandBuffer cmd) {
   vkCmdBindDescriptorSets(cmd, pipeline->bindPoint, pipeline->pipelineLayout, 0,
                           gpu->bindlessDescriptorSets.size(),
                           gpu->bindlessDescriptorSets.data(), 0, nullptr);
-  vkCmdDispatch(cmd, (maxDrawCount / 256) + 1, 1, 1);
+  vkCmdDispatch(cmd, (maxDrawCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+  gpu->profiler.endScope(cmd);
 }
 
 FrustumPlanes FrustumCullPass::getFrustumPlanes(glm::mat4 mat, bool normalize) {
@@ -129,17 +168,17 @@ void FrustumCullPass::setInputs(const FrustumCullInputs &inputs) {
     viewProjection = inputs.viewProjection;
     frustumUniformRingBuffer.moveToNextBuffer();
     uniforms.frustumPlanes = getFrustumPlanes(viewProjection);
-    gpu->uploadBufferData(frustumUniformRingBuffer.buffer(), &uniforms);
+    gpu->queueBufferUpload(frustumUniformRingBuffer.buffer(), &uniforms);
   }
 
   maxDrawCount = inputs.maxDrawCount;
   outputIndirectBufferHandle = inputs.outputIndirectDrawBuffer;
-  outputCountBufferHandle = inputs.countBuffer;
+  outputCountBufferHandle = countRingBuffer.buffer();
 
   pc.mat = viewProjection;
   pc.data0 = inputs.inputIndirectDrawBuffer.index;
   pc.data1 = inputs.outputIndirectDrawBuffer.index;
-  pc.data2 = inputs.countBuffer.index;
+  pc.data2 = outputCountBufferHandle.index;
   pc.data3 = inputs.boundsBuffer.index;
   pc.data4 = maxDrawCount;
   pc.data5 = inputs.transformBuffer.index;
@@ -8,6 +8,8 @@
 namespace Flare {
 struct GpuDevice;
 
+static constexpr uint32_t FRUSTUM_CULL_WORKGROUP_SIZE = 256;
+
 struct FrustumPlanes {
   glm::vec4 left;
   glm::vec4 right;
@@ -25,7 +27,6 @@ struct FrustumCullInputs {
   glm::mat4 viewProjection;
   Handle<Buffer> inputIndirectDrawBuffer;
   Handle<Buffer> outputIndirectDrawBuffer;
-  Handle<Buffer> countBuffer;
   Handle<Buffer> boundsBuffer;
   Handle<Buffer> transformBuffer;
   uint32_t maxDrawCount;
@@ -40,8 +41,15 @@ struct FrustumCullPass {
 
   void cull(VkCommandBuffer cmd);
 
-  void addBarriers(VkCommandBuffer cmd, uint32_t computeFamily,
-                   uint32_t mainFamily);
+  // culling runs on the compute queue, these transfer ownership of the culled
+  // draws and count to the main queue. release is recorded after cull on the
+  // compute command buffer, acquire before the draws on the main one
+  void releaseOutputs(VkCommandBuffer computeCmd);
+
+  void acquireOutputs(VkCommandBuffer cmd);
+
+  // fills in the buffer ranges of the template barrier for both outputs
+  void addBarriers(VkCommandBuffer cmd, const VkBufferMemoryBarrier2 &barrier);
 
   void shutdown();
 
@@ -52,9 +60,14 @@ struct FrustumCullPass {
 
   PipelineCI pipelineCI;
   Handle<Pipeline> pipelineHandle;
+  // specialized into FrustumCull.comp, set before init
+  uint32_t workgroupSize = FRUSTUM_CULL_WORKGROUP_SIZE;
 
   FrustumCullUniforms uniforms;
   RingBuffer frustumUniformRingBuffer;
+  // visible draw count written by the cull, separate from the unculled count
+  // the shadow pass draws with. advanced by the caller once per frame
+  RingBuffer countRingBuffer;
   PushConstants pc;
 
   uint32_t maxDrawCount = 0;
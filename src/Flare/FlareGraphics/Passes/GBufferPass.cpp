@@ -1,11 +1,16 @@
 #include "GBufferPass.h"
 
 #include "../GpuDevice.h"
+#include "../ModelManager.h"
+#include "../RenderGraph.h"
 #include "../VkHelper.h"
+#include <tracy/Tracy.hpp>
 
 namespace Flare {
-void GBufferPass::init(GpuDevice *gpuDevice) {
+void GBufferPass::init(GpuDevice *gpuDevice,
+                       const ModelManager &modelManager) {
   gpu = gpuDevice;
+  bool quantizedVertices = modelManager.quantizedVertices;
 
   BufferCI uniformCI = {
       .size = sizeof(GBufferUniforms),
@@ -17,8 +22,11 @@ void GBufferPass::init(GpuDevice *gpuDevice) {
   };
   gBufferUniformRingBuffer.init(gpu, FRAMES_IN_FLIGHT, uniformCI);
 
+  // constant id matches QuantizedVertex.glsl
   pipelineCI.shaderStages = {
-      {"CoreShaders/GBuffer.vert", VK_SHADER_STAGE_VERTEX_BIT},
+      {"CoreShaders/GBuffer.vert",
+       VK_SHADER_STAGE_VERTEX_BIT,
+       {{0, quantizedVertices}}},
       {"CoreShaders/GBuffer.frag", VK_SHADER_STAGE_FRAGMENT_BIT},
   };
   pipelineCI.rendering.colorFormats = {
@@ -33,56 +41,62 @@ void GBufferPass::init(GpuDevice *gpuDevice) {
       .depthTestEnable = true,
       .depthWriteEnable = true,
   };
+  // quantized streams are laid out as in QuantizedVertices
+  uint32_t positionStride =
+      quantizedVertices ? sizeof(glm::uvec2) : sizeof(glm::vec4);
+  VkFormat positionFormat = quantizedVertices
+                                ? VK_FORMAT_R16G16B16A16_SNORM
+                                : VK_FORMAT_R32G32B32A32_SFLOAT;
+  uint32_t uvStride = quantizedVertices ? sizeof(uint32_t) : sizeof(glm::vec2);
+  VkFormat uvFormat =
+      quantizedVertices ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+  uint32_t directionStride =
+      quantizedVertices ? sizeof(uint32_t) : sizeof(glm::vec4);
+  VkFormat directionFormat = quantizedVertices
+                                 ? VK_FORMAT_R16G16_SNORM
+                                 : VK_FORMAT_R32G32B32A32_SFLOAT;
+
   pipelineCI
       .vertexInput
       // position
       .addBinding({.binding = 0,
-                   .stride = sizeof(glm::vec4),
+                   .stride = positionStride,
                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX})
       .addAttribute({.location = 0,
                      .binding = 0,
-                     .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                     .format = positionFormat,
                      .offset = 0})
       // uv
       .addBinding({.binding = 1,
-                   .stride = sizeof(glm::vec2),
+                   .stride = uvStride,
                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX})
-      .addAttribute({.location = 1,
-                     .binding = 1,
-                     .format = VK_FORMAT_R32G32_SFLOAT,
-                     .offset = 0})
+      .addAttribute(
+          {.location = 1, .binding = 1, .format = uvFormat, .offset = 0})
       // normal
       .addBinding({.binding = 2,
-                   .stride = sizeof(glm::vec4),
+                   .stride = directionStride,
                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX})
       .addAttribute({.location = 2,
                      .binding = 2,
-                     .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                     .format = directionFormat,
                      .offset = 0})
       // tangent
       .addBinding({.binding = 3,
-                   .stride = sizeof(glm::vec4),
+                   .stride = directionStride,
                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX})
       .addAttribute({.location = 3,
                      .binding = 3,
-                     .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                     .format = directionFormat,
                      .offset = 0});
   pipelineHandle = gpu->createPipeline(pipelineCI);
-
-  generateRenderTargets();
 }
 
 void GBufferPass::shutdown() {
-  destroyRenderTargets();
   gpu->destroyPipeline(pipelineHandle);
   gBufferUniformRingBuffer.shutdown();
 }
 
-void GBufferPass::generateRenderTargets() {
-  if (loaded) {
-    destroyRenderTargets();
-  }
-
+void GBufferPass::declareTargets(RenderGraph &graph) {
   TextureCI depthTargetCI = {
       .width = gpu->swapchainExtent.width,
       .height = gpu->swapchainExtent.height,
@@ -92,7 +106,7 @@ void GBufferPass::generateRenderTargets() {
       .viewType = VK_IMAGE_VIEW_TYPE_2D,
       .name = "gbuffer depth",
   };
-  depthTargetHandle = gpu->createTexture(depthTargetCI);
+  depthTarget = graph.createTexture(depthTargetCI);
 
   TextureCI albedoTargetCI = {
       .width = gpu->swapchainExtent.width,
@@ -104,7 +118,7 @@ void GBufferPass::generateRenderTargets() {
       .name = "gbuffer albedo",
       .offscreenDraw = true,
   };
-  albedoTargetHandle = gpu->createTexture(albedoTargetCI);
+  albedoTarget = graph.createTexture(albedoTargetCI);
 
   TextureCI normalTargetCI = {
       .width = gpu->swapchainExtent.width,
@@ -116,7 +130,7 @@ void GBufferPass::generateRenderTargets() {
       .name = "gbuffer normal",
       .offscreenDraw = true,
   };
-  normalTargetHandle = gpu->createTexture(normalTargetCI);
+  normalTarget = graph.createTexture(normalTargetCI);
 
   TextureCI occlusionMetallicRoughnessCI = {
       .width = gpu->swapchainExtent.width,
@@ -128,8 +142,8 @@ void GBufferPass::generateRenderTargets() {
       .name = "gbuffer occlusion metallic roughness",
       .offscreenDraw = true,
   };
-  occlusionMetallicRoughnessTargetHandle =
-      gpu->createTexture(occlusionMetallicRoughnessCI);
+  occlusionMetallicRoughnessTarget =
+      graph.createTexture(occlusionMetallicRoughnessCI);
 
   TextureCI emissiveCI = {
       .width = gpu->swapchainExtent.width,
@@ -141,12 +155,24 @@ void GBufferPass::generateRenderTargets() {
       .name = "gbuffer emissive",
       .offscreenDraw = true,
   };
-  emissiveTargetHandle = gpu->createTexture(emissiveCI);
+  emissiveTarget = graph.createTexture(emissiveCI);
+}
 
-  loaded = true;
+void GBufferPass::resolveTargets(const RenderGraph &graph) {
+  depthTargetHandle = graph.getTexture(depthTarget);
+  albedoTargetHandle = graph.getTexture(albedoTarget);
+  normalTargetHandle = graph.getTexture(normalTarget);
+  occlusionMetallicRoughnessTargetHandle =
+      graph.getTexture(occlusionMetallicRoughnessTarget);
+  emissiveTargetHandle = graph.getTexture(emissiveTarget);
 }
 
 void GBufferPass::render(VkCommandBuffer cmd) {
+  ZoneScoped;
+
+  gpu->profiler.beginScope(cmd, "GBuffer");
+  TracyVkZone(gpu->tracyMainContext, cmd, "GBuffer");
+
   Pipeline *pipeline = gpu->getPipeline(pipelineHandle);
 
   std::array<VkRenderingAttachmentInfo, 4> colorAttachments = {
@@ -165,10 +191,6 @@ void GBufferPass::render(VkCommandBuffer cmd) {
       VkHelper::renderingInfo(gpu->swapchainExtent, colorAttachments.size(),
                               colorAttachments.data(), &depthAttachment);
 
-  VkHelper::transitionImage(cmd, gpu->getTexture(albedoTargetHandle)->image,
-                            VK_IMAGE_LAYOUT_UNDEFINED,
-                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-
   vkCmdBeginRendering(cmd, &renderingInfo);
   if (meshDrawBuffers.drawCount > 0) {
     vkCmdBindPipeline(cmd, pipeline->bindPoint, pipeline->pipeline);
@@ -202,17 +224,8 @@ void GBufferPass::render(VkCommandBuffer cmd) {
         meshDrawBuffers.drawCount, sizeof(IndirectDrawData));
   }
   vkCmdEndRendering(cmd);
-  VkHelper::transitionImage(cmd, gpu->getTexture(albedoTargetHandle)->image,
-                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-}
 
-void GBufferPass::destroyRenderTargets() {
-  gpu->destroyTexture(depthTargetHandle);
-  gpu->destroyTexture(albedoTargetHandle);
-  gpu->destroyTexture(normalTargetHandle);
-  gpu->destroyTexture(occlusionMetallicRoughnessTargetHandle);
-  gpu->destroyTexture(emissiveTargetHandle);
+  gpu->profiler.endScope(cmd);
 }
 
 void GBufferPass::setInputs(const GBufferInputs &inputs) {
@@ -221,13 +234,15 @@ void GBufferPass::setInputs(const GBufferInputs &inputs) {
   uniforms.prevViewProjection = uniforms.viewProjection;
   uniforms.viewProjection = inputs.viewProjection;
 
+  gBufferUniformRingBuffer.moveToNextBuffer();
+
   pc.uniformOffset = gBufferUniformRingBuffer.buffer().index;
   pc.data0 = meshDrawBuffers.indirectDraws.index;
   pc.data1 = meshDrawBuffers.transforms.index;
   pc.data2 = meshDrawBuffers.materials.index;
   pc.data3 = meshDrawBuffers.textures.index;
+  pc.data4 = meshDrawBuffers.bounds.index;
 
-  gBufferUniformRingBuffer.moveToNextBuffer();
-  gpu->uploadBufferData(gBufferUniformRingBuffer.buffer(), &uniforms);
+  gpu->queueBufferUpload(gBufferUniformRingBuffer.buffer(), &uniforms);
 }
 } // namespace Flare
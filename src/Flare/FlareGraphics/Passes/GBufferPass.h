@@ -5,6 +5,9 @@
 
 namespace Flare {
 struct GpuDevice;
+struct ModelManager;
+struct RenderGraph;
+struct RenderGraphResource;
 
 struct GBufferUniforms {
   glm::mat4 viewProjection = glm::mat4(1.f);
@@ -17,21 +20,29 @@ struct GBufferInputs {
 };
 
 struct GBufferPass {
-  void init(GpuDevice *gpuDevice);
+  // the vertex format follows modelManager, which has to be configured first
+  void init(GpuDevice *gpuDevice, const ModelManager &modelManager);
 
   void render(VkCommandBuffer cmd);
 
-  void destroyRenderTargets();
-
   void shutdown();
 
-  void generateRenderTargets();
+  // the targets are transient graph textures sized to the swapchain, their
+  // memory is aliased by the graph
+  void declareTargets(RenderGraph &graph);
+
+  // picks up the physical textures once the graph is compiled
+  void resolveTargets(const RenderGraph &graph);
 
   void setInputs(const GBufferInputs &inputs);
 
   GpuDevice *gpu = nullptr;
 
-  bool loaded = false;
+  Handle<RenderGraphResource> depthTarget;
+  Handle<RenderGraphResource> albedoTarget;
+  Handle<RenderGraphResource> normalTarget;
+  Handle<RenderGraphResource> occlusionMetallicRoughnessTarget;
+  Handle<RenderGraphResource> emissiveTarget;
 
   Handle<Texture> depthTargetHandle;
   Handle<Texture> albedoTargetHandle;
@@ -1,19 +1,38 @@
 #include "LightingPass.h"
 #include "../GpuDevice.h"
 #include "../VkHelper.h"
+#include <tracy/Tracy.hpp>
+
+#include <array>
+#include <bit>
 
 namespace Flare {
 void LightingPass::init(GpuDevice *gpuDevice) {
   gpu = gpuDevice;
 
+  // constant ids match LightingPass.frag: pcf range, pcf scale, shadows
   pipelineCI.shaderStages = {
       {"CoreShaders/FullscreenTriangle.vert", VK_SHADER_STAGE_VERTEX_BIT},
-      {"CoreShaders/LightingPass.frag", VK_SHADER_STAGE_FRAGMENT_BIT},
+      {"CoreShaders/LightingPass.frag",
+       VK_SHADER_STAGE_FRAGMENT_BIT,
+       {
+           {0, static_cast<uint32_t>(LIGHTING_PCF_RANGE)},
+           {1, std::bit_cast<uint32_t>(LIGHTING_PCF_SCALE)},
+           {2, 1},
+       }},
   };
   pipelineCI.rendering.colorFormats = {
       gpu->drawTextureFormat,
   };
-  pipelineHandle = gpu->createPipeline(pipelineCI);
+
+  PipelineCI noShadowPipelineCI = pipelineCI;
+  noShadowPipelineCI.shaderStages[1].specializationConstants[2].value = 0;
+
+  std::array<PipelineCI, 2> pipelineCIs = {pipelineCI, noShadowPipelineCI};
+  std::vector<Handle<Pipeline>> pipelineHandles =
+      gpu->createPipelines(pipelineCIs);
+  pipelineHandle = pipelineHandles[0];
+  noShadowPipelineHandle = pipelineHandles[1];
 
   BufferCI uniformCI = {
       .size = sizeof(LightingPassUniform),
@@ -28,11 +47,18 @@ void LightingPass::init(GpuDevice *gpuDevice) {
 
 void LightingPass::shutdown() {
   gpu->destroyPipeline(pipelineHandle);
+  gpu->destroyPipeline(noShadowPipelineHandle);
   uniformRingBuffer.shutdown();
 }
 
 void LightingPass::render(VkCommandBuffer cmd) {
-  Pipeline *pipeline = gpu->getPipeline(pipelineHandle);
+  ZoneScoped;
+
+  gpu->profiler.beginScope(cmd, "Lighting");
+  TracyVkZone(gpu->tracyMainContext, cmd, "Lighting");
+
+  Pipeline *pipeline =
+      gpu->getPipeline(shadows ? pipelineHandle : noShadowPipelineHandle);
 
   VkRenderingAttachmentInfo colorAttachment =
       VkHelper::colorAttachment(gpu->getTexture(targetHandle)->imageView);
@@ -58,10 +84,13 @@ void LightingPass::render(VkCommandBuffer cmd) {
   vkCmdDraw(cmd, 3, 1, 0, 0); // fullscreen triangle
 
   vkCmdEndRendering(cmd);
+
+  gpu->profiler.endScope(cmd);
 }
 
 void LightingPass::setInputs(const LightingPassInputs &inputs) {
   targetHandle = inputs.drawTexture;
+  shadows = inputs.shadows;
 
   uniformRingBuffer.moveToNextBuffer();
 
@@ -83,6 +112,6 @@ void LightingPass::setInputs(const LightingPassInputs &inputs) {
   uniforms.prefilteredCubeIndex = inputs.prefilteredCube.index;
   uniforms.brdfLutIndex = inputs.brdfLut.index;
 
-  gpu->uploadBufferData(uniformRingBuffer.buffer(), &uniforms);
+  gpu->queueBufferUpload(uniformRingBuffer.buffer(), &uniforms);
 }
 } // namespace Flare
\ No newline at end of file
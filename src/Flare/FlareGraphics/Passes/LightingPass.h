@@ -6,6 +6,10 @@
 namespace Flare {
 struct GpuDevice;
 
+// pcf takes (2 * range + 1)^2 shadow map taps, scale is in texels
+static constexpr int32_t LIGHTING_PCF_RANGE = 1;
+static constexpr float LIGHTING_PCF_SCALE = 1.5f;
+
 struct LightingPassInputs {
   Handle<Texture> drawTexture;
 
@@ -24,6 +28,9 @@ struct LightingPassInputs {
   Handle<Texture> irradianceMap;
   Handle<Texture> prefilteredCube;
   Handle<Texture> brdfLut;
+
+  // picks the pipeline variant without shadow lookups when false
+  bool shadows = true;
 };
 
 // stores indices of input textures
@@ -55,7 +62,10 @@ struct LightingPass {
 
   PipelineCI pipelineCI;
   Handle<Pipeline> pipelineHandle;
+  // same shaders specialized with shadows off
+  Handle<Pipeline> noShadowPipelineHandle;
   Handle<Texture> targetHandle;
+  bool shadows = true;
 
   PushConstants pc{};
 
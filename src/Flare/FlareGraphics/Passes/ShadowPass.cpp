@@ -1,11 +1,15 @@
 #include "ShadowPass.h"
 
 #include "../GpuDevice.h"
+#include "../ModelManager.h"
 #include "../VkHelper.h"
+#include <tracy/Tracy.hpp>
 
 namespace Flare {
-void ShadowPass::init(GpuDevice *gpuDevice) {
+void ShadowPass::init(GpuDevice *gpuDevice,
+                      const ModelManager &modelManager) {
   gpu = gpuDevice;
+  bool quantizedVertices = modelManager.quantizedVertices;
 
   TextureCI textureCI = {
       .width = SHADOW_RESOLUTION,
@@ -31,10 +35,13 @@ void ShadowPass::init(GpuDevice *gpuDevice) {
   };
   samplerHandle = gpu->createSampler(samplerCI);
 
+  // constant id matches QuantizedVertex.glsl
   pipelineCI = {
       .shaderStages =
           {
-              {"CoreShaders/ShadowPass.vert", VK_SHADER_STAGE_VERTEX_BIT},
+              {"CoreShaders/ShadowPass.vert",
+               VK_SHADER_STAGE_VERTEX_BIT,
+               {{0, quantizedVertices}}},
               {"CoreShaders/ShadowPass.frag", VK_SHADER_STAGE_FRAGMENT_BIT},
           },
       .rasterization =
@@ -69,12 +76,14 @@ void ShadowPass::shutdown() {
 }
 
 void ShadowPass::render(VkCommandBuffer cmd) {
+  ZoneScoped;
+
+  gpu->profiler.beginScope(cmd, "Shadow");
+  TracyVkZone(gpu->tracyMainContext, cmd, "Shadow");
+
   Texture *texture = gpu->getTexture(depthTextureHandle);
   Pipeline *pipeline = gpu->getPipeline(pipelineHandle);
 
-  VkHelper::transitionImage(cmd, texture->image, VK_IMAGE_LAYOUT_UNDEFINED,
-                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-
   VkRenderingAttachmentInfo depthAttachment =
       VkHelper::depthAttachment(texture->imageView);
 
@@ -109,9 +118,7 @@ void ShadowPass::render(VkCommandBuffer cmd) {
 
   vkCmdEndRendering(cmd);
 
-  VkHelper::transitionImage(cmd, texture->image,
-                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+  gpu->profiler.endScope(cmd);
 }
 
 void ShadowPass::setInputs(const ShadowInputs &inputs) {
@@ -119,6 +126,7 @@ void ShadowPass::setInputs(const ShadowInputs &inputs) {
   pc.data1 = inputs.positionBuffer.index;
   pc.data2 = inputs.transformBuffer.index;
   pc.data3 = inputs.lightBuffer.index;
+  pc.data4 = inputs.boundsBuffer.index;
 
   indexBufferHandle = inputs.indexBuffer;
   indirectDrawBufferHandle = inputs.indirectDrawBuffer;
@@ -5,12 +5,14 @@
 
 namespace Flare {
 struct GpuDevice;
+struct ModelManager;
 
 static constexpr uint32_t SHADOW_RESOLUTION = 2048;
 
 struct ShadowInputs {
   Handle<Buffer> positionBuffer;
   Handle<Buffer> transformBuffer;
+  Handle<Buffer> boundsBuffer;
   Handle<Buffer> lightBuffer;
 
   Handle<Buffer> indexBuffer;
@@ -20,7 +22,8 @@ struct ShadowInputs {
 };
 
 struct ShadowPass {
-  void init(GpuDevice *gpuDevice);
+  // the vertex format follows modelManager, which has to be configured first
+  void init(GpuDevice *gpuDevice, const ModelManager &modelManager);
 
   void shutdown();
 
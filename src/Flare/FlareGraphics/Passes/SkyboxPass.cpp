@@ -6,6 +6,7 @@
 #include "glm/ext/matrix_clip_space.hpp"
 #include <numbers>
 #include <stb_image.h>
+#include <tracy/Tracy.hpp>
 
 namespace Flare {
 
@@ -76,22 +77,23 @@ void SkyboxPass::init(GpuDevice *gpuDevice) {
   };
   indexBufferHandle = gpu->createBuffer(indexBufferCI);
 
-  PipelineCI offscreenPipelineCI;
-  offscreenPipelineCI.rendering.colorFormats.push_back(
+  PipelineCI brdfLutPipelineCI;
+  brdfLutPipelineCI.rendering.colorFormats.push_back(
       VK_FORMAT_R32G32B32A32_SFLOAT);
-
-  offscreenPipelineCI.shaderStages = {
+  brdfLutPipelineCI.shaderStages = {
       ShaderStage{"CoreShaders/FullscreenTriangle.vert",
                   VK_SHADER_STAGE_VERTEX_BIT},
       ShaderStage{"CoreShaders/BrdfLut.frag", VK_SHADER_STAGE_FRAGMENT_BIT},
   };
-  brdfLutPipelineHandle = gpu->createPipeline(offscreenPipelineCI);
 
-  offscreenPipelineCI.shaderStages = {
+  PipelineCI cubemapPipelineCI;
+  cubemapPipelineCI.rendering.colorFormats.push_back(
+      VK_FORMAT_R32G32B32A32_SFLOAT);
+  cubemapPipelineCI.shaderStages = {
       ShaderStage{"CoreShaders/Cubemap.vert", VK_SHADER_STAGE_VERTEX_BIT},
       ShaderStage{"CoreShaders/Cubemap.frag", VK_SHADER_STAGE_FRAGMENT_BIT},
   };
-  offscreenPipelineCI.vertexInput
+  cubemapPipelineCI.vertexInput
       .addBinding({.binding = 0,
                    .stride = sizeof(glm::vec4),
                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX})
@@ -99,21 +101,20 @@ void SkyboxPass::init(GpuDevice *gpuDevice) {
                      .binding = 0,
                      .format = VK_FORMAT_R32G32B32A32_SFLOAT,
                      .offset = 0});
-  cubemapPipelineHandle = gpu->createPipeline(offscreenPipelineCI);
 
-  offscreenPipelineCI.shaderStages = {
+  PipelineCI irradianceMapPipelineCI = cubemapPipelineCI;
+  irradianceMapPipelineCI.shaderStages = {
       ShaderStage{"CoreShaders/Cubemap.vert", VK_SHADER_STAGE_VERTEX_BIT},
       ShaderStage{"CoreShaders/IrradianceMap.frag",
                   VK_SHADER_STAGE_FRAGMENT_BIT},
   };
-  irradianceMapPipelineHandle = gpu->createPipeline(offscreenPipelineCI);
 
-  offscreenPipelineCI.shaderStages = {
+  PipelineCI prefilteredCubePipelineCI = cubemapPipelineCI;
+  prefilteredCubePipelineCI.shaderStages = {
       ShaderStage{"CoreShaders/Cubemap.vert", VK_SHADER_STAGE_VERTEX_BIT},
       ShaderStage{"CoreShaders/PrefilteredCube.frag",
                   VK_SHADER_STAGE_FRAGMENT_BIT},
   };
-  prefilteredCubePipelineHandle = gpu->createPipeline(offscreenPipelineCI);
 
   PipelineCI skyboxPipelineCI;
   skyboxPipelineCI.shaderStages = {
@@ -136,7 +137,19 @@ void SkyboxPass::init(GpuDevice *gpuDevice) {
                      .binding = 0,
                      .format = VK_FORMAT_R32G32B32A32_SFLOAT,
                      .offset = 0});
-  skyboxPipelineHandle = gpu->createPipeline(skyboxPipelineCI);
+
+  std::array<PipelineCI, 5> pipelineCIs = {
+      brdfLutPipelineCI,         cubemapPipelineCI, irradianceMapPipelineCI,
+      prefilteredCubePipelineCI, skyboxPipelineCI,
+  };
+  std::vector<Handle<Pipeline>> pipelineHandles =
+      gpu->createPipelines(pipelineCIs);
+
+  brdfLutPipelineHandle = pipelineHandles[0];
+  cubemapPipelineHandle = pipelineHandles[1];
+  irradianceMapPipelineHandle = pipelineHandles[2];
+  prefilteredCubePipelineHandle = pipelineHandles[3];
+  skyboxPipelineHandle = pipelineHandles[4];
 }
 
 void SkyboxPass::shutdown() {
@@ -219,6 +232,11 @@ void SkyboxPass::loadImage(std::filesystem::path path) {
 }
 
 void SkyboxPass::render(VkCommandBuffer cmd) {
+  ZoneScoped;
+
+  gpu->profiler.beginScope(cmd, "Skybox");
+  TracyVkZone(gpu->tracyMainContext, cmd, "Skybox");
+
   Pipeline *skyboxPipeline = gpu->getPipeline(skyboxPipelineHandle);
 
   VkRenderingAttachmentInfo colorAttachment = VkHelper::colorAttachment(
@@ -254,6 +272,8 @@ void SkyboxPass::render(VkCommandBuffer cmd) {
   vkCmdDrawIndexed(cmd, 36, 1, 0, 0, 0);
 
   vkCmdEndRendering(cmd);
+
+  gpu->profiler.endScope(cmd);
 }
 
 void SkyboxPass::renderFacesOffscreenAndCopyToCubemap(
@@ -331,8 +351,7 @@ void SkyboxPass::renderFacesOffscreenAndCopyToCubemap(
   }
 
   VkCommandBuffer cmd = gpu->getCommandBuffer();
-  VkHelper::genCubemapMips(cmd, targetTexture->image,
-                           {targetTexture->width, targetTexture->height});
+  gpu->mipGenerator.generate(cmd, targetTexture);
   gpu->submitImmediate(cmd);
 }
 
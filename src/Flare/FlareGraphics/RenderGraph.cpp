@@ -0,0 +1,737 @@
+#include "RenderGraph.h"
+
+#include "GpuDevice.h"
+
+#include <algorithm>
+#include <tracy/Tracy.hpp>
+
+namespace Flare {
+static RenderGraphAccessInfo getAccessInfo(RenderGraphAccess access) {
+  switch (access) {
+  case RenderGraphAccess::eColorAttachment:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .write = true,
+    };
+  case RenderGraphAccess::eDepthAttachment:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                 VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .write = true,
+    };
+  case RenderGraphAccess::eFragmentSampled:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        .layout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+    };
+  case RenderGraphAccess::eComputeSampled:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        .layout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+    };
+  case RenderGraphAccess::eComputeStorageRead:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+  case RenderGraphAccess::eComputeStorageWrite:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                  VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+        .write = true,
+    };
+  case RenderGraphAccess::eVertexStorageRead:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+        .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+  case RenderGraphAccess::eIndirectRead:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+        .access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+    };
+  case RenderGraphAccess::eTransferSrc:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .access = VK_ACCESS_2_TRANSFER_READ_BIT,
+        .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    };
+  case RenderGraphAccess::eTransferDst:
+    return {
+        .stage = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .access = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .write = true,
+    };
+  case RenderGraphAccess::ePresent:
+    // the present semaphore is signalled at all commands, which the
+    // transition is ordered before
+    return {
+        .stage = VK_PIPELINE_STAGE_2_NONE,
+        .access = VK_ACCESS_2_NONE,
+        .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    };
+  }
+  return {};
+}
+
+static bool sameTextureCI(const TextureCI &l, const TextureCI &r) {
+  return l.width == r.width && l.height == r.height && l.depth == r.depth &&
+         l.format == r.format && l.type == r.type &&
+         l.viewType == r.viewType && l.genMips == r.genMips &&
+         l.cubemap == r.cubemap && l.offscreenDraw == r.offscreenDraw &&
+         l.storage == r.storage;
+}
+
+static bool lifetimesOverlap(const RenderGraphTransient &l,
+                             const RenderGraphTransient &r) {
+  if (l.firstPass == invalidIndex || r.firstPass == invalidIndex) {
+    return false;
+  }
+  return l.firstPass <= r.lastPass && r.firstPass <= l.lastPass;
+}
+
+static bool memoryOverlaps(const RenderGraphTransient &l,
+                           const RenderGraphTransient &r) {
+  if (!l.aliased || !r.aliased) {
+    return false;
+  }
+  return l.offset < r.offset + r.size && r.offset < l.offset + l.size;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static void recordBarriers(VkCommandBuffer cmd,
+                           const std::vector<VkImageMemoryBarrier2> &images,
+                           const std::vector<VkBufferMemoryBarrier2> &buffers) {
+  if (images.empty() && buffers.empty()) {
+    return;
+  }
+
+  VkDependencyInfo dependencyInfo = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .pNext = nullptr,
+      .bufferMemoryBarrierCount = static_cast<uint32_t>(buffers.size()),
+      .pBufferMemoryBarriers = buffers.data(),
+      .imageMemoryBarrierCount = static_cast<uint32_t>(images.size()),
+      .pImageMemoryBarriers = images.data(),
+  };
+
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+RenderGraphPass &RenderGraphPass::read(Handle<RenderGraphResource> resource,
+                                       RenderGraphAccess access) {
+  reads.push_back({resource, access});
+  return *this;
+}
+
+RenderGraphPass &RenderGraphPass::write(Handle<RenderGraphResource> resource,
+                                        RenderGraphAccess access) {
+  writes.push_back({resource, access});
+  return *this;
+}
+
+RenderGraphPass &RenderGraphPass::setSideEffect() {
+  sideEffect = true;
+  return *this;
+}
+
+void RenderGraph::init(GpuDevice *gpuDevice) { gpu = gpuDevice; }
+
+void RenderGraph::shutdown() {
+  destroyTransients(false);
+  reset();
+  resetStates();
+}
+
+void RenderGraph::reset() {
+  resources.clear();
+  passes.clear();
+  resourceStates.clear();
+  finalImageBarriers.clear();
+  finalBufferBarriers.clear();
+}
+
+void RenderGraph::resetStates() {
+  imageStates.clear();
+  bufferStates.clear();
+}
+
+Handle<RenderGraphResource>
+RenderGraph::importTexture(const std::string &name, Handle<Texture> texture) {
+  resources.push_back({
+      .name = name,
+      .type = RenderGraphResourceType::eTexture,
+      .texture = texture,
+  });
+  return {.index = static_cast<uint32_t>(resources.size() - 1)};
+}
+
+Handle<RenderGraphResource>
+RenderGraph::importImage(const std::string &name, VkImage image,
+                         VkPipelineStageFlags2 waitStage,
+                         VkImageAspectFlags aspect) {
+  resources.push_back({
+      .name = name,
+      .type = RenderGraphResourceType::eImage,
+      .image = image,
+      .aspect = aspect,
+      .waitStage = waitStage,
+  });
+  return {.index = static_cast<uint32_t>(resources.size() - 1)};
+}
+
+Handle<RenderGraphResource> RenderGraph::importBuffer(const std::string &name,
+                                                      Handle<Buffer> buffer) {
+  resources.push_back({
+      .name = name,
+      .type = RenderGraphResourceType::eBuffer,
+      .buffer = buffer,
+  });
+  return {.index = static_cast<uint32_t>(resources.size() - 1)};
+}
+
+Handle<RenderGraphResource> RenderGraph::createTexture(const TextureCI &ci) {
+  // transients are matched to last frame's by name
+  for (const auto &resource : resources) {
+    if (resource.type == RenderGraphResourceType::eTransient &&
+        resource.name == ci.name) {
+      spdlog::error("RenderGraph: Transient {} declared twice", ci.name);
+    }
+  }
+
+  resources.push_back({
+      .name = ci.name,
+      .type = RenderGraphResourceType::eTransient,
+      .transientCI = ci,
+  });
+  return {.index = static_cast<uint32_t>(resources.size() - 1)};
+}
+
+void RenderGraph::markOutput(Handle<RenderGraphResource> resource,
+                             std::optional<RenderGraphAccess> finalAccess) {
+  RenderGraphResource *graphResource = getResource(resource);
+  if (!graphResource) {
+    return;
+  }
+  graphResource->output = true;
+  graphResource->finalAccess = finalAccess;
+}
+
+RenderGraphPass &
+RenderGraph::addPass(const std::string &name,
+                     std::function<void(VkCommandBuffer)> execute) {
+  RenderGraphPass &pass = passes.emplace_back();
+  pass.name = name;
+  pass.execute = std::move(execute);
+  return pass;
+}
+
+RenderGraphResource *
+RenderGraph::getResource(Handle<RenderGraphResource> resource) {
+  if (!resource.isValid() || resource.index >= resources.size()) {
+    spdlog::error("RenderGraph: Invalid resource handle");
+    return nullptr;
+  }
+  return &resources[resource.index];
+}
+
+Handle<Texture>
+RenderGraph::getTexture(Handle<RenderGraphResource> resource) const {
+  if (!resource.isValid() || resource.index >= resources.size()) {
+    spdlog::error("RenderGraph: Invalid resource handle");
+    return {};
+  }
+
+  const RenderGraphResource &graphResource = resources[resource.index];
+  if (graphResource.type == RenderGraphResourceType::eTransient &&
+      graphResource.transientIndex != invalidIndex) {
+    return transients[graphResource.transientIndex].texture;
+  }
+  return graphResource.texture;
+}
+
+VkImage RenderGraph::getImage(Handle<RenderGraphResource> resource) const {
+  if (!resource.isValid() || resource.index >= resources.size()) {
+    spdlog::error("RenderGraph: Invalid resource handle");
+    return VK_NULL_HANDLE;
+  }
+  return resources[resource.index].image;
+}
+
+void RenderGraph::compile() {
+  ZoneScoped;
+
+  cullPasses();
+  computeLifetimes();
+
+  if (!matchTransients()) {
+    destroyTransients(true);
+    createTransients();
+  }
+
+  computeBarriers();
+}
+
+void RenderGraph::cullPasses() {
+  for (auto &resource : resources) {
+    resource.needed = resource.output;
+  }
+
+  // walk back from the outputs, a kept pass needs everything it touches since
+  // attachments may be loaded rather than cleared
+  for (auto pass = passes.rbegin(); pass != passes.rend(); pass++) {
+    pass->culled =
+        !pass->sideEffect &&
+        std::none_of(pass->writes.begin(), pass->writes.end(),
+                     [&](const RenderGraphResourceUse &use) {
+                       return resources[use.resource.index].needed;
+                     });
+    if (pass->culled) {
+      continue;
+    }
+
+    for (const auto &use : pass->reads) {
+      resources[use.resource.index].needed = true;
+    }
+    for (const auto &use : pass->writes) {
+      resources[use.resource.index].needed = true;
+    }
+  }
+}
+
+void RenderGraph::computeLifetimes() {
+  for (uint32_t i = 0; i < passes.size(); i++) {
+    if (passes[i].culled) {
+      continue;
+    }
+
+    auto extend = [&](const RenderGraphResourceUse &use) {
+      RenderGraphResource &resource = resources[use.resource.index];
+      if (resource.firstPass == invalidIndex) {
+        resource.firstPass = i;
+      }
+      resource.lastPass = i;
+    };
+    std::for_each(passes[i].reads.begin(), passes[i].reads.end(), extend);
+    std::for_each(passes[i].writes.begin(), passes[i].writes.end(), extend);
+  }
+}
+
+bool RenderGraph::matchTransients() {
+  size_t transientCount = 0;
+  for (auto &resource : resources) {
+    if (resource.type != RenderGraphResourceType::eTransient) {
+      continue;
+    }
+    transientCount++;
+
+    auto transient = std::find_if(
+        transients.begin(), transients.end(),
+        [&](const RenderGraphTransient &t) { return t.name == resource.name; });
+    if (transient == transients.end() ||
+        !sameTextureCI(transient->ci, resource.transientCI)) {
+      return false;
+    }
+
+    resource.transientIndex =
+        static_cast<uint32_t>(transient - transients.begin());
+    transient->firstPass = resource.firstPass;
+    transient->lastPass = resource.lastPass;
+  }
+
+  if (transientCount != transients.size()) {
+    return false;
+  }
+
+  // the placement only holds while transients sharing memory stay apart in
+  // time
+  for (size_t i = 0; i < transients.size(); i++) {
+    for (size_t j = i + 1; j < transients.size(); j++) {
+      if (memoryOverlaps(transients[i], transients[j]) &&
+          lifetimesOverlap(transients[i], transients[j])) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void RenderGraph::createTransients() {
+  ZoneScoped;
+
+  transientHeapStages = VK_PIPELINE_STAGE_2_NONE;
+  transientHeapAccess = VK_ACCESS_2_NONE;
+
+  uint32_t memoryTypeBits = UINT32_MAX;
+  VkDeviceSize heapAlignment = 1;
+  std::vector<VkDeviceSize> alignments;
+
+  for (auto &resource : resources) {
+    if (resource.type != RenderGraphResourceType::eTransient) {
+      continue;
+    }
+
+    VkMemoryRequirements requirements =
+        gpu->getTextureMemoryRequirements(resource.transientCI);
+    memoryTypeBits &= requirements.memoryTypeBits;
+    heapAlignment = std::max(heapAlignment, requirements.alignment);
+    alignments.push_back(requirements.alignment);
+
+    resource.transientIndex = static_cast<uint32_t>(transients.size());
+    transients.push_back({
+        .name = resource.name,
+        .ci = resource.transientCI,
+        .size = requirements.size,
+        .firstPass = resource.firstPass,
+        .lastPass = resource.lastPass,
+    });
+  }
+
+  if (transients.empty()) {
+    return;
+  }
+
+  // largest first, each at the lowest offset clear of every placed transient
+  // it is alive alongside
+  std::vector<size_t> order(transients.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t l, size_t r) {
+    return transients[l].size > transients[r].size;
+  });
+
+  VkDeviceSize heapSize = 0;
+  std::vector<size_t> placed;
+  for (size_t index : order) {
+    RenderGraphTransient &transient = transients[index];
+
+    std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+    for (size_t other : placed) {
+      if (lifetimesOverlap(transient, transients[other])) {
+        taken.emplace_back(transients[other].offset,
+                           transients[other].offset + transients[other].size);
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+
+    VkDeviceSize offset = 0;
+    for (const auto &[begin, end] : taken) {
+      if (offset + transient.size <= begin) {
+        break;
+      }
+      offset = std::max(offset, alignUp(end, alignments[index]));
+    }
+
+    transient.offset = offset;
+    heapSize = std::max(heapSize, offset + transient.size);
+    placed.push_back(index);
+  }
+
+  bool aliased = memoryTypeBits != 0;
+  if (aliased) {
+    VkMemoryRequirements heapRequirements = {
+        .size = heapSize,
+        .alignment = heapAlignment,
+        .memoryTypeBits = memoryTypeBits,
+    };
+    VmaAllocationCreateInfo allocCI = {
+        .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    };
+    aliased = vmaAllocateMemory(gpu->allocator, &heapRequirements, &allocCI,
+                                &transientHeap, nullptr) == VK_SUCCESS;
+  }
+  if (!aliased) {
+    spdlog::warn("RenderGraph: Transients can't share memory, allocating "
+                 "them separately");
+    transientHeap = nullptr;
+  }
+
+  for (auto &transient : transients) {
+    TextureCI ci = transient.ci;
+    if (aliased) {
+      ci.aliasAllocation = transientHeap;
+      ci.aliasOffset = transient.offset;
+    }
+    transient.aliased = aliased;
+    transient.texture = gpu->createTexture(ci);
+  }
+}
+
+void RenderGraph::destroyTransients(bool deferred) {
+  for (const auto &transient : transients) {
+    if (!transient.texture.isValid()) {
+      continue;
+    }
+    if (deferred) {
+      gpu->destroyTextureDeferred(transient.texture);
+    } else {
+      gpu->destroyTexture(transient.texture);
+    }
+  }
+  transients.clear();
+
+  if (transientHeap) {
+    if (deferred) {
+      gpu->freeAllocationDeferred(transientHeap);
+    } else {
+      vmaFreeMemory(gpu->allocator, transientHeap);
+    }
+    transientHeap = nullptr;
+  }
+}
+
+void RenderGraph::computeBarriers() {
+  ZoneScoped;
+
+  resourceStates.assign(resources.size(), {});
+
+  for (size_t i = 0; i < resources.size(); i++) {
+    RenderGraphResource &resource = resources[i];
+    RenderGraphResourceState &state = resourceStates[i];
+
+    switch (resource.type) {
+    case RenderGraphResourceType::eTexture: {
+      Texture *texture = gpu->getTexture(resource.texture);
+      resource.image = texture->image;
+      resource.aspect = texture->format == VK_FORMAT_D32_SFLOAT
+                            ? VK_IMAGE_ASPECT_DEPTH_BIT
+                            : VK_IMAGE_ASPECT_COLOR_BIT;
+      if (auto it = imageStates.find(resource.image); it != imageStates.end()) {
+        state = it->second;
+      }
+      break;
+    }
+    case RenderGraphResourceType::eImage:
+      state.writeStages = resource.waitStage;
+      break;
+    case RenderGraphResourceType::eTransient:
+      resource.image =
+          gpu->getTexture(transients[resource.transientIndex].texture)->image;
+      resource.aspect = resource.transientCI.format == VK_FORMAT_D32_SFLOAT
+                            ? VK_IMAGE_ASPECT_DEPTH_BIT
+                            : VK_IMAGE_ASPECT_COLOR_BIT;
+      // last frame's users of the heap, whichever image they went through
+      state.writeStages = transientHeapStages;
+      state.writeAccess = transientHeapAccess;
+      break;
+    case RenderGraphResourceType::eBuffer:
+      resource.vkBuffer = gpu->getBuffer(resource.buffer)->buffer;
+      if (auto it = bufferStates.find(resource.vkBuffer);
+          it != bufferStates.end()) {
+        state = it->second;
+      }
+      break;
+    }
+  }
+
+  for (auto &transient : transients) {
+    transient.usedStages = VK_PIPELINE_STAGE_2_NONE;
+    transient.writtenAccess = VK_ACCESS_2_NONE;
+  }
+
+  for (uint32_t passIndex = 0; passIndex < passes.size(); passIndex++) {
+    RenderGraphPass &pass = passes[passIndex];
+    pass.imageBarriers.clear();
+    pass.bufferBarriers.clear();
+    if (pass.culled) {
+      continue;
+    }
+
+    // a resource used more than once in a pass gets a single barrier
+    std::vector<std::pair<uint32_t, RenderGraphAccessInfo>> uses;
+    auto merge = [&](const RenderGraphResourceUse &use) {
+      RenderGraphAccessInfo info = getAccessInfo(use.access);
+      auto existing = std::find_if(uses.begin(), uses.end(), [&](auto &entry) {
+        return entry.first == use.resource.index;
+      });
+      if (existing == uses.end()) {
+        uses.emplace_back(use.resource.index, info);
+        return;
+      }
+      if (existing->second.layout != info.layout) {
+        spdlog::error("RenderGraph: Pass {} uses {} in two layouts", pass.name,
+                      resources[use.resource.index].name);
+      }
+      existing->second.stage |= info.stage;
+      existing->second.access |= info.access;
+      existing->second.write |= info.write;
+    };
+    std::for_each(pass.reads.begin(), pass.reads.end(), merge);
+    std::for_each(pass.writes.begin(), pass.writes.end(), merge);
+
+    for (const auto &[resourceIndex, info] : uses) {
+      const RenderGraphResource &resource = resources[resourceIndex];
+
+      if (resource.type == RenderGraphResourceType::eTransient) {
+        RenderGraphTransient &transient = transients[resource.transientIndex];
+
+        // wait for transients that had this memory earlier in the frame
+        if (resource.firstPass == passIndex) {
+          for (const auto &other : transients) {
+            if (&other != &transient && memoryOverlaps(transient, other) &&
+                other.firstPass != invalidIndex && other.lastPass < passIndex) {
+              resourceStates[resourceIndex].writeStages |= other.usedStages;
+              resourceStates[resourceIndex].writeAccess |= other.writtenAccess;
+            }
+          }
+        }
+
+        transient.usedStages |= info.stage;
+        if (info.write) {
+          transient.writtenAccess |= info.access;
+        }
+      }
+
+      addBarrier(resourceIndex, info, pass.imageBarriers, pass.bufferBarriers);
+    }
+  }
+
+  for (uint32_t i = 0; i < resources.size(); i++) {
+    if (resources[i].finalAccess) {
+      addBarrier(i, getAccessInfo(*resources[i].finalAccess),
+                 finalImageBarriers, finalBufferBarriers);
+    }
+  }
+
+  transientHeapStages = VK_PIPELINE_STAGE_2_NONE;
+  transientHeapAccess = VK_ACCESS_2_NONE;
+  for (const auto &transient : transients) {
+    transientHeapStages |= transient.usedStages;
+    transientHeapAccess |= transient.writtenAccess;
+  }
+}
+
+void RenderGraph::addBarrier(uint32_t resourceIndex,
+                             const RenderGraphAccessInfo &info,
+                             std::vector<VkImageMemoryBarrier2> &imageBarriers,
+                             std::vector<VkBufferMemoryBarrier2> &bufferBarriers) {
+  const RenderGraphResource &resource = resources[resourceIndex];
+  RenderGraphResourceState &state = resourceStates[resourceIndex];
+
+  bool isImage = resource.type != RenderGraphResourceType::eBuffer;
+  bool layoutChange = isImage && state.layout != info.layout;
+
+  VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+  bool needsBarrier = layoutChange;
+
+  if (info.write || layoutChange) {
+    // waits for earlier reads too, nothing may still be using the contents
+    srcStages = state.writeStages | state.readStages;
+    srcAccess = state.writeAccess;
+  } else if ((info.stage & ~state.readStages) ||
+             (info.access & ~state.readAccess)) {
+    // reads already made visible to these stages need nothing
+    srcStages = state.writeStages;
+    srcAccess = state.writeAccess;
+  }
+  needsBarrier |= srcStages != VK_PIPELINE_STAGE_2_NONE;
+
+  if (needsBarrier && isImage) {
+    imageBarriers.push_back({
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = srcStages,
+        .srcAccessMask = srcAccess,
+        .dstStageMask = info.stage,
+        .dstAccessMask = info.access,
+        .oldLayout = state.layout,
+        .newLayout = info.layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = resource.image,
+        .subresourceRange =
+            {
+                .aspectMask = resource.aspect,
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS,
+            },
+    });
+  } else if (needsBarrier) {
+    bufferBarriers.push_back({
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = srcStages,
+        .srcAccessMask = srcAccess,
+        .dstStageMask = info.stage,
+        .dstAccessMask = info.access,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = resource.vkBuffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    });
+  }
+
+  if (info.write) {
+    state.writeStages = info.stage;
+    state.writeAccess = info.access;
+    state.readStages = VK_PIPELINE_STAGE_2_NONE;
+    state.readAccess = VK_ACCESS_2_NONE;
+  } else if (layoutChange) {
+    // the transition counts as a write later readers have to wait for
+    state.writeStages = info.stage;
+    state.writeAccess = VK_ACCESS_2_NONE;
+    state.readStages = info.stage;
+    state.readAccess = info.access;
+  } else {
+    state.readStages |= info.stage;
+    state.readAccess |= info.access;
+  }
+  if (isImage) {
+    state.layout = info.layout;
+  }
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd) {
+  ZoneScoped;
+
+  // each pass records its barriers at the start of its own secondary command
+  // buffer, passes still execute in declaration order
+  std::vector<std::function<void(VkCommandBuffer)>> recorders;
+  for (auto &pass : passes) {
+    if (pass.culled) {
+      continue;
+    }
+    recorders.emplace_back([&pass](VkCommandBuffer passCmd) {
+      recordBarriers(passCmd, pass.imageBarriers, pass.bufferBarriers);
+      pass.execute(passCmd);
+    });
+  }
+  gpu->recordParallel(cmd, recorders);
+
+  recordBarriers(cmd, finalImageBarriers, finalBufferBarriers);
+
+  // only resources imported this frame are kept, a destroyed image's handle
+  // may come back for a new one
+  imageStates.clear();
+  bufferStates.clear();
+  for (size_t i = 0; i < resources.size(); i++) {
+    if (resources[i].type == RenderGraphResourceType::eTexture) {
+      imageStates[resources[i].image] = resourceStates[i];
+    } else if (resources[i].type == RenderGraphResourceType::eBuffer) {
+      bufferStates[resources[i].vkBuffer] = resourceStates[i];
+    }
+  }
+}
+} // namespace Flare
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "GpuResources.h"
+
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Flare {
+struct GpuDevice;
+
+enum class RenderGraphAccess {
+  eColorAttachment,
+  eDepthAttachment,
+  eFragmentSampled,
+  eComputeSampled,
+  eComputeStorageRead,
+  eComputeStorageWrite,
+  eVertexStorageRead,
+  eIndirectRead,
+  eTransferSrc,
+  eTransferDst,
+  ePresent,
+};
+
+struct RenderGraphAccessInfo {
+  VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 access = VK_ACCESS_2_NONE;
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  bool write = false;
+};
+
+enum class RenderGraphResourceType {
+  eTexture,   // imported Handle<Texture>
+  eImage,     // imported VkImage, e.g. the swapchain
+  eTransient, // created and aliased by the graph
+  eBuffer,    // imported Handle<Buffer>
+};
+
+struct RenderGraphResource {
+  std::string name;
+  RenderGraphResourceType type = RenderGraphResourceType::eTexture;
+
+  Handle<Texture> texture;
+  Handle<Buffer> buffer;
+  VkImage image = VK_NULL_HANDLE;
+  VkBuffer vkBuffer = VK_NULL_HANDLE;
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+  VkPipelineStageFlags2 waitStage = VK_PIPELINE_STAGE_2_NONE;
+
+  TextureCI transientCI;
+  uint32_t transientIndex = invalidIndex;
+
+  std::optional<RenderGraphAccess> finalAccess;
+  bool output = false;
+  bool needed = false;
+
+  // first and last kept pass, only meaningful for transients
+  uint32_t firstPass = invalidIndex;
+  uint32_t lastPass = 0;
+};
+
+struct RenderGraphResourceUse {
+  Handle<RenderGraphResource> resource;
+  RenderGraphAccess access;
+};
+
+struct RenderGraphPass {
+  RenderGraphPass &read(Handle<RenderGraphResource> resource,
+                        RenderGraphAccess access);
+
+  RenderGraphPass &write(Handle<RenderGraphResource> resource,
+                         RenderGraphAccess access);
+
+  // kept even if nothing reads what it writes
+  RenderGraphPass &setSideEffect();
+
+  std::string name;
+  std::function<void(VkCommandBuffer)> execute;
+  std::vector<RenderGraphResourceUse> reads;
+  std::vector<RenderGraphResourceUse> writes;
+  bool sideEffect = false;
+  bool culled = false;
+
+  std::vector<VkImageMemoryBarrier2> imageBarriers;
+  std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+};
+
+// what a resource was last used for, carried across frames for imported
+// resources
+struct RenderGraphResourceState {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+  VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 readAccess = VK_ACCESS_2_NONE;
+};
+
+// a physical texture backing transients, kept across frames while the graph
+// declares compatible transients
+struct RenderGraphTransient {
+  std::string name;
+  TextureCI ci;
+  Handle<Texture> texture;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  bool aliased = false;
+
+  uint32_t firstPass = invalidIndex;
+  uint32_t lastPass = 0;
+
+  VkPipelineStageFlags2 usedStages = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 writtenAccess = VK_ACCESS_2_NONE;
+};
+
+// rebuilt every frame: declare resources and passes, compile to cull passes
+// and place transients, then execute to record barriers and passes
+struct RenderGraph {
+  void init(GpuDevice *gpuDevice);
+
+  void shutdown();
+
+  void reset();
+
+  // forgets what imported resources were last used for, needed when they are
+  // recreated in place, e.g. on resize
+  void resetStates();
+
+  Handle<RenderGraphResource> importTexture(const std::string &name,
+                                            Handle<Texture> texture);
+
+  // contents are discarded, the first use waits on waitStage, e.g. the stage
+  // the swapchain acquire semaphore is waited on
+  Handle<RenderGraphResource> importImage(const std::string &name,
+                                          VkImage image,
+                                          VkPipelineStageFlags2 waitStage,
+                                          VkImageAspectFlags aspect =
+                                              VK_IMAGE_ASPECT_COLOR_BIT);
+
+  Handle<RenderGraphResource> importBuffer(const std::string &name,
+                                           Handle<Buffer> buffer);
+
+  // memory is shared with other transients whose lifetimes don't overlap
+  Handle<RenderGraphResource> createTexture(const TextureCI &ci);
+
+  // keeps the passes producing the resource, finalAccess is transitioned to
+  // after the last pass
+  void markOutput(Handle<RenderGraphResource> resource,
+                  std::optional<RenderGraphAccess> finalAccess = std::nullopt);
+
+  RenderGraphPass &addPass(const std::string &name,
+                           std::function<void(VkCommandBuffer)> execute);
+
+  void compile();
+
+  void execute(VkCommandBuffer cmd);
+
+  // valid after compile
+  Handle<Texture> getTexture(Handle<RenderGraphResource> resource) const;
+
+  VkImage getImage(Handle<RenderGraphResource> resource) const;
+
+  RenderGraphResource *getResource(Handle<RenderGraphResource> resource);
+
+  void cullPasses();
+
+  void computeLifetimes();
+
+  // matches declared transients to the cached physical textures, false if
+  // they need to be recreated
+  bool matchTransients();
+
+  void createTransients();
+
+  void destroyTransients(bool deferred);
+
+  void computeBarriers();
+
+  // moves the resource to the state info describes, appending a barrier only
+  // if the previous use requires one
+  void addBarrier(uint32_t resourceIndex, const RenderGraphAccessInfo &info,
+                  std::vector<VkImageMemoryBarrier2> &imageBarriers,
+                  std::vector<VkBufferMemoryBarrier2> &bufferBarriers);
+
+  GpuDevice *gpu = nullptr;
+
+  std::vector<RenderGraphResource> resources;
+  // deque so references returned by addPass stay valid
+  std::deque<RenderGraphPass> passes;
+
+  std::vector<RenderGraphTransient> transients;
+  VmaAllocation transientHeap = nullptr;
+  // stages the previous frame touched the transients with, their memory may
+  // be reused by different images this frame
+  VkPipelineStageFlags2 transientHeapStages = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 transientHeapAccess = VK_ACCESS_2_NONE;
+
+  std::vector<RenderGraphResourceState> resourceStates;
+  std::vector<VkImageMemoryBarrier2> finalImageBarriers;
+  std::vector<VkBufferMemoryBarrier2> finalBufferBarriers;
+
+  std::unordered_map<VkImage, RenderGraphResourceState> imageStates;
+  std::unordered_map<VkBuffer, RenderGraphResourceState> bufferStates;
+};
+} // namespace Flare
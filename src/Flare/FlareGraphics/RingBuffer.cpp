@@ -35,7 +35,7 @@ void RingBuffer::moveToNextBuffer() {
 
 void RingBuffer::createBuffer(BufferCI &ci) {
   if (bufferRing[ringIndex].isValid()) {
-    gpuDevice->destroyBuffer(bufferRing[ringIndex]);
+    gpuDevice->destroyBufferDeferred(bufferRing[ringIndex]);
   }
   bufferRing[ringIndex] = gpuDevice->createBuffer(ci);
 }
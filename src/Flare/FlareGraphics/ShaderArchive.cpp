@@ -0,0 +1,141 @@
+#include "ShaderArchive.h"
+
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include <cstring>
+#include <fstream>
+
+namespace Flare {
+bool writeShaderArchive(const std::filesystem::path &path,
+                        std::span<const ShaderArchiveInput> shaders) {
+  ShaderArchiveHeader header = {
+      .magic = SHADER_ARCHIVE_MAGIC,
+      .version = SHADER_ARCHIVE_VERSION,
+      .entryCount = static_cast<uint32_t>(shaders.size()),
+      .reserved = 0,
+  };
+
+  std::vector<ShaderArchiveEntry> entries(shaders.size());
+
+  size_t offset = sizeof(ShaderArchiveHeader) +
+                  entries.size() * sizeof(ShaderArchiveEntry);
+  for (size_t i = 0; i < shaders.size(); i++) {
+    entries[i].nameOffset = static_cast<uint32_t>(offset);
+    entries[i].nameSize = static_cast<uint32_t>(shaders[i].name.size());
+    offset += shaders[i].name.size();
+  }
+  offset = (offset + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+  for (size_t i = 0; i < shaders.size(); i++) {
+    entries[i].spirvOffset = static_cast<uint32_t>(offset);
+    entries[i].spirvSize =
+        static_cast<uint32_t>(shaders[i].spirv.size() * sizeof(uint32_t));
+    offset += entries[i].spirvSize;
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    spdlog::error("ShaderArchive: Failed to open {} for writing",
+                  path.string());
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(entries.data()),
+             entries.size() * sizeof(ShaderArchiveEntry));
+  for (const auto &shader : shaders) {
+    file.write(shader.name.data(), shader.name.size());
+  }
+
+  size_t padding = entries.empty() ? 0
+                                   : entries[0].spirvOffset -
+                                         (entries.back().nameOffset +
+                                          entries.back().nameSize);
+  const char zeros[sizeof(uint32_t)] = {};
+  file.write(zeros, padding);
+
+  for (const auto &shader : shaders) {
+    file.write(reinterpret_cast<const char *>(shader.spirv.data()),
+               shader.spirv.size() * sizeof(uint32_t));
+  }
+
+  return file.good();
+}
+
+bool ShaderArchive::open(const std::filesystem::path &path) {
+  ZoneScoped;
+
+  close();
+
+  if (!std::filesystem::exists(path)) {
+    return false;
+  }
+
+  if (!file.open(path)) {
+    return false;
+  }
+  const uint8_t *mappedData = file.data;
+  size_t mappedSize = file.size;
+
+  ShaderArchiveHeader header;
+  if (mappedSize < sizeof(header)) {
+    spdlog::error("ShaderArchive: {} is truncated", path.string());
+    close();
+    return false;
+  }
+  memcpy(&header, mappedData, sizeof(header));
+
+  if (header.magic != SHADER_ARCHIVE_MAGIC ||
+      header.version != SHADER_ARCHIVE_VERSION ||
+      sizeof(header) + static_cast<size_t>(header.entryCount) *
+                           sizeof(ShaderArchiveEntry) >
+          mappedSize) {
+    spdlog::error("ShaderArchive: {} isn't a valid shader archive",
+                  path.string());
+    close();
+    return false;
+  }
+
+  const auto *entries =
+      reinterpret_cast<const ShaderArchiveEntry *>(mappedData + sizeof(header));
+  shaders.reserve(header.entryCount);
+  for (uint32_t i = 0; i < header.entryCount; i++) {
+    const ShaderArchiveEntry &entry = entries[i];
+    if (static_cast<size_t>(entry.nameOffset) + entry.nameSize > mappedSize ||
+        static_cast<size_t>(entry.spirvOffset) + entry.spirvSize >
+            mappedSize ||
+        entry.spirvOffset % sizeof(uint32_t) != 0 ||
+        entry.spirvSize % sizeof(uint32_t) != 0) {
+      spdlog::error("ShaderArchive: {} has an invalid entry", path.string());
+      close();
+      return false;
+    }
+
+    std::string name(reinterpret_cast<const char *>(mappedData) +
+                         entry.nameOffset,
+                     entry.nameSize);
+    shaders[name] = {
+        reinterpret_cast<const uint32_t *>(mappedData + entry.spirvOffset),
+        entry.spirvSize / sizeof(uint32_t)};
+  }
+
+  spdlog::info("ShaderArchive: Mapped {} shaders from {}", shaders.size(),
+               path.string());
+
+  return true;
+}
+
+void ShaderArchive::close() {
+  shaders.clear();
+  file.close();
+}
+
+std::span<const uint32_t>
+ShaderArchive::find(const std::filesystem::path &path) const {
+  auto it = shaders.find(path.generic_string());
+  if (it == shaders.end()) {
+    return {};
+  }
+  return it->second;
+}
+} // namespace Flare
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace Flare {
+static constexpr uint32_t SHADER_ARCHIVE_MAGIC = 0x4b505346; // "FSPK"
+static constexpr uint32_t SHADER_ARCHIVE_VERSION = 1;
+
+// file layout: header, entryCount entries, then names and spirv. offsets are
+// from the start of the file, spirv is 4 byte aligned
+struct ShaderArchiveHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+};
+
+struct ShaderArchiveEntry {
+  uint32_t nameOffset;
+  uint32_t nameSize;
+  uint32_t spirvOffset;
+  uint32_t spirvSize;
+};
+
+struct ShaderArchiveInput {
+  // shader path as used in PipelineCI, e.g. CoreShaders/GBuffer.frag
+  std::string name;
+  std::vector<uint32_t> spirv;
+};
+
+bool writeShaderArchive(const std::filesystem::path &path,
+                        std::span<const ShaderArchiveInput> shaders);
+
+// memory maps a packed archive, spirv is handed out without copying and stays
+// valid until close
+struct ShaderArchive {
+  bool open(const std::filesystem::path &path);
+
+  void close();
+
+  bool isOpen() const { return file.isOpen(); }
+
+  // empty if the archive doesn't contain the shader
+  std::span<const uint32_t> find(const std::filesystem::path &path) const;
+
+  MappedFile file;
+
+  std::unordered_map<std::string, std::span<const uint32_t>> shaders;
+};
+} // namespace Flare
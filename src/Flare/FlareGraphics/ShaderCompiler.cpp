@@ -1,20 +1,93 @@
 #include "ShaderCompiler.h"
+#include "Hash.h"
 #include <shaderc/shaderc.hpp>
 #include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
 
 #include <array>
+#include <cstdio>
 #include <fstream>
 
+// set by cmake from the vulkan sdk version and the shaderc library
+#ifndef FLARE_SHADERC_ID
+#define FLARE_SHADERC_ID "unknown"
+#endif
+
 namespace Flare {
-void ShaderCompiler::init() {
+std::string normalizeShaderPath(const fs::path &path) {
+  return path.lexically_normal().generic_string();
+}
+
+bool getShaderKind(const fs::path &path, shaderc_shader_kind &shaderKind) {
+  if (path.extension() == ".vert") {
+    shaderKind = shaderc_glsl_vertex_shader;
+  } else if (path.extension() == ".frag") {
+    shaderKind = shaderc_glsl_fragment_shader;
+  } else if (path.extension() == ".comp") {
+    shaderKind = shaderc_glsl_compute_shader;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void ShaderCompiler::init(const fs::path &cacheDirectory,
+                          const fs::path &archivePath) {
+  if (!allowCompile) {
+    if (!archive.open(archivePath)) {
+      spdlog::error("ShaderCompiler: Shader archive {} is required",
+                    archivePath.string());
+    }
+    return;
+  }
+
   createGlobalSession(globalSession.writeRef());
 
-  shadercOptions.SetIncluder(std::make_unique<ShaderIncluder>());
+  auto shaderIncluder = std::make_unique<ShaderIncluder>();
+  includer = shaderIncluder.get();
+  shadercOptions.SetIncluder(std::move(shaderIncluder));
+
+  this->cacheDirectory = cacheDirectory;
+  std::error_code ec;
+  fs::create_directories(cacheDirectory, ec);
+  if (ec) {
+    spdlog::error("ShaderCompiler: Failed to create shader cache {}: {}",
+                  cacheDirectory.string(), ec.message());
+  }
+
+  unsigned int spvVersion = 0;
+  unsigned int spvRevision = 0;
+  shaderc_get_spv_version(&spvVersion, &spvRevision);
+  optionsKey = "cache " + std::to_string(SHADER_CACHE_VERSION) +
+               " shaderc " + FLARE_SHADERC_ID + " spv " +
+               std::to_string(spvVersion) + "." + std::to_string(spvRevision) +
+               " default options";
 }
 
-void ShaderCompiler::shutdown() {}
+void ShaderCompiler::shutdown() { archive.close(); }
+
+std::span<const uint32_t>
+ShaderCompiler::getSpirv(const fs::path &path,
+                         std::vector<uint32_t> &compiled) {
+  if (!allowCompile) {
+    std::span<const uint32_t> archived = archive.find(path);
+    if (!archived.empty()) {
+      return archived;
+    }
+  }
+
+  compiled = compileGLSL(path);
+  return compiled;
+}
 
 std::vector<uint32_t> ShaderCompiler::compileSlang(const fs::path &path) {
+  if (!allowCompile) {
+    spdlog::error("ShaderCompiler: Can't compile {}, shader compilation is "
+                  "disabled",
+                  path.string());
+    return {};
+  }
+
   if (!fs::exists(path)) {
     spdlog::error("ShaderCompiler: {} doesn't exist", path.string());
     return {};
@@ -122,36 +195,26 @@ void ShaderCompiler::diagnose(slang::IBlob *diagnosticsBlob) {
 }
 
 std::vector<uint32_t> ShaderCompiler::compileGLSL(const fs::path &path) {
-  std::vector<uint32_t> spirv;
-
-  fs::path spvPath = path;
-  spvPath += ".spv";
-
-  //      use cached spirv if exists and newer than glsl
-  if (fs::exists(spvPath) &&
-      fs::last_write_time(spvPath) >= fs::last_write_time(path)) {
-    std::ifstream spvFile(spvPath, std::ios::binary | std::ios::ate);
-    if (!spvFile.is_open()) {
-      spdlog::error("Failed to open cached SPIR-V file: {}", spvPath.string());
-      return {};
-    }
-
-    size_t fileSize = spvFile.tellg();
-    spvFile.seekg(0);
-
-    spirv.resize(fileSize / sizeof(uint32_t));
-    spvFile.read(reinterpret_cast<char *>(spirv.data()), fileSize);
-    spvFile.close();
+  ZoneScoped;
+  std::string pathString = path.string();
+  ZoneText(pathString.c_str(), pathString.size());
+
+  if (!allowCompile) {
+    spdlog::error("ShaderCompiler: {} isn't in the shader archive and shader "
+                  "compilation is disabled",
+                  pathString);
+    return {};
+  }
 
-    spdlog::info("Loaded SPIR-V from {} ({} bytes)", spvPath.string(),
-                 fileSize);
-    return spirv;
+  shaderc_shader_kind shaderKind;
+  if (!getShaderKind(path, shaderKind)) {
+    spdlog::error("Unsupported glsl shader type");
+    return {};
   }
 
-  // otherwise compile
   std::ifstream shaderFile(path);
   if (!shaderFile.is_open()) {
-    spdlog::error("Failed to open {}", path.string());
+    spdlog::error("Failed to open {}", pathString);
     return {};
   }
 
@@ -161,20 +224,45 @@ std::vector<uint32_t> ShaderCompiler::compileGLSL(const fs::path &path) {
 
   shaderFile.close();
 
-  shaderc_shader_kind shaderKind;
-  if (path.extension() == ".vert") {
-    shaderKind = shaderc_glsl_vertex_shader;
-  } else if (path.extension() == ".frag") {
-    shaderKind = shaderc_glsl_fragment_shader;
-  } else if (path.extension() == ".comp") {
-    shaderKind = shaderc_glsl_compute_shader;
-  } else {
-    spdlog::error("Unsupported glsl shader type");
+  // preprocessing pulls in every include, so the hash covers them too
+  shaderc::PreprocessedSourceCompilationResult preprocessed =
+      shadercCompiler.PreprocessGlsl(shaderCode, shaderKind,
+                                     pathString.c_str(), shadercOptions);
+  if (preprocessed.GetCompilationStatus() !=
+      shaderc_compilation_status_success) {
+    spdlog::error("Shader preprocessing failed: {}",
+                  preprocessed.GetErrorMessage());
     return {};
   }
 
+  std::string preprocessedCode(preprocessed.cbegin(), preprocessed.cend());
+  fs::path spvPath = getCachePath(path, shaderKind, preprocessedCode);
+
+  std::vector<uint32_t> spirv;
+
+  std::ifstream cachedFile(spvPath, std::ios::binary | std::ios::ate);
+  if (cachedFile.is_open()) {
+    size_t fileSize = cachedFile.tellg();
+    cachedFile.seekg(0);
+
+    if (fileSize >= sizeof(uint32_t) && fileSize % sizeof(uint32_t) == 0) {
+      spirv.resize(fileSize / sizeof(uint32_t));
+      cachedFile.read(reinterpret_cast<char *>(spirv.data()), fileSize);
+    }
+    cachedFile.close();
+
+    if (!spirv.empty() && spirv[0] == SPIRV_MAGIC_NUMBER) {
+      spdlog::info("Loaded SPIR-V from {} ({} bytes)", spvPath.string(),
+                   fileSize);
+      return spirv;
+    }
+
+    spdlog::warn("Ignoring invalid cached SPIR-V {}", spvPath.string());
+    spirv.clear();
+  }
+
   shaderc::SpvCompilationResult result = shadercCompiler.CompileGlslToSpv(
-      shaderCode, shaderKind, path.string().c_str(), shadercOptions);
+      shaderCode, shaderKind, pathString.c_str(), shadercOptions);
 
   if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
     spdlog::error("Shader compilation failed: {}", result.GetErrorMessage());
@@ -185,54 +273,142 @@ std::vector<uint32_t> ShaderCompiler::compileGLSL(const fs::path &path) {
 
   assert(spirv[0] == SPIRV_MAGIC_NUMBER);
 
-  spdlog::info("ShaderCompiler: Compiled {} ({} bytes)", path.string(),
+  spdlog::info("ShaderCompiler: Compiled {} ({} bytes)", pathString,
                spirv.size() * sizeof(uint32_t));
 
-  std::ofstream spvFile(spvPath, std::ios::binary);
+  // written under a temporary name so another process never reads a partial
+  // file
+  fs::path tmpPath = spvPath;
+  tmpPath += ".tmp";
+  std::ofstream spvFile(tmpPath, std::ios::binary);
   if (!spvFile.is_open()) {
     spdlog::error("Failed to save compiled SPIR-V file: {}", spvPath.string());
   } else {
     spvFile.write(reinterpret_cast<const char *>(spirv.data()),
                   spirv.size() * sizeof(uint32_t));
     spvFile.close();
+
+    std::error_code ec;
+    fs::rename(tmpPath, spvPath, ec);
+    if (ec) {
+      spdlog::error("Failed to save compiled SPIR-V file: {}",
+                    spvPath.string());
+      fs::remove(tmpPath, ec);
+    }
   }
 
   return spirv;
 }
 
+std::vector<std::string> ShaderCompiler::getIncludes(const fs::path &path) {
+  std::vector<std::string> includes;
+  if (!includer) {
+    return includes;
+  }
+
+  std::lock_guard<std::mutex> lock(includer->mutex);
+
+  std::vector<std::string> stack = {normalizeShaderPath(path)};
+  std::unordered_set<std::string> visited;
+  while (!stack.empty()) {
+    std::string file = std::move(stack.back());
+    stack.pop_back();
+
+    auto it = includer->includeGraph.find(file);
+    if (it == includer->includeGraph.end()) {
+      continue;
+    }
+    for (const auto &include : it->second) {
+      if (visited.insert(include).second) {
+        includes.push_back(include);
+        stack.push_back(include);
+      }
+    }
+  }
+
+  return includes;
+}
+
+fs::path ShaderCompiler::getCachePath(
+    const fs::path &path, shaderc_shader_kind shaderKind,
+    const std::string &preprocessedCode) const {
+  uint64_t hash = hashBytes(optionsKey.data(), optionsKey.size());
+  hash = hashBytes(&shaderKind, sizeof(shaderKind), hash);
+  hash = hashBytes(preprocessedCode.data(), preprocessedCode.size(), hash);
+
+  std::array<char, 17> hex;
+  snprintf(hex.data(), hex.size(), "%016llx",
+           static_cast<unsigned long long>(hash));
+
+  // the file name is kept for readability, the hash makes it unique
+  return cacheDirectory /
+         (path.filename().string() + "." + hex.data() + ".spv");
+}
+
+struct IncludeData {
+  std::string name;
+  std::shared_ptr<const std::string> content;
+};
+
 shaderc_include_result *ShaderIncluder::GetInclude(
     const char *requested_source, shaderc_include_type type,
     const char *requesting_source, size_t include_depth) {
-  std::ifstream includeFile(requested_source);
-  if (!includeFile.is_open()) {
+  std::string name = std::string(requested_source);
+
+  std::error_code ec;
+  fs::file_time_type writeTime = fs::last_write_time(name, ec);
+  if (ec) {
     spdlog::error("Failed to include {}", requested_source);
     return nullptr;
   }
 
-  std::string name = std::string(requested_source);
+  auto container = new IncludeData;
+  container->name = name;
 
-  std::stringstream buf;
-  buf << includeFile.rdbuf();
-  std::string shaderCode = buf.str();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    includeGraph[normalizeShaderPath(requesting_source)].insert(
+        normalizeShaderPath(name));
 
-  includeFile.close();
+    auto it = includeFiles.find(name);
+    if (it != includeFiles.end() && it->second.writeTime == writeTime) {
+      container->content = it->second.content;
+    }
+  }
 
-  auto container = new std::array<std::string, 2>;
-  (*container)[0] = name;
-  (*container)[1] = shaderCode;
+  if (!container->content) {
+    std::ifstream includeFile(name);
+    if (!includeFile.is_open()) {
+      spdlog::error("Failed to include {}", requested_source);
+      delete container;
+      return nullptr;
+    }
+
+    std::stringstream buf;
+    buf << includeFile.rdbuf();
+    container->content = std::make_shared<const std::string>(buf.str());
+
+    includeFile.close();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    includeFiles[name] = {
+        .writeTime = writeTime,
+        .content = container->content,
+    };
+  }
 
   auto data = new shaderc_include_result;
   data->user_data = container;
-  data->source_name = (*container)[0].data();
-  data->source_name_length = (*container)[0].size();
-  data->content = (*container)[1].data();
-  data->content_length = (*container)[1].size();
+  data->source_name = container->name.data();
+  data->source_name_length = container->name.size();
+  data->content = container->content->data();
+  data->content_length = container->content->size();
 
   return data;
 }
 
 void ShaderIncluder::ReleaseInclude(shaderc_include_result *data) {
-  delete static_cast<std::array<std::string, 2> *>(data->user_data);
+  delete static_cast<IncludeData *>(data->user_data);
   delete data;
 }
 } // namespace Flare
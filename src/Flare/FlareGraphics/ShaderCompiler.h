@@ -1,18 +1,39 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <shaderc/shaderc.hpp>
 #include <slang-com-helper.h>
 #include <slang-com-ptr.h>
 #include <slang.h>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "GpuResources.h"
+#include "ShaderArchive.h"
 
 namespace fs = std::filesystem;
 
 namespace Flare {
 constexpr uint32_t SPIRV_MAGIC_NUMBER = 0x07230203;
+// bump when the cache key or file layout changes
+constexpr uint32_t SHADER_CACHE_VERSION = 2;
 
+// relative to the working directory with forward slashes, how shader files
+// are compared
+std::string normalizeShaderPath(const fs::path &path);
+
+bool getShaderKind(const fs::path &path, shaderc_shader_kind &shaderKind);
+
+struct IncludeFile {
+  fs::file_time_type writeTime;
+  std::shared_ptr<const std::string> content;
+};
+
+// include files are read once and reused until their write time changes,
+// shared between the threads compiling shaders
 struct ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
   shaderc_include_result *GetInclude(const char *requested_source,
                                      shaderc_include_type type,
@@ -20,21 +41,54 @@ struct ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
                                      size_t include_depth) override;
 
   void ReleaseInclude(shaderc_include_result *data) override;
+
+  std::mutex mutex;
+  std::unordered_map<std::string, IncludeFile> includeFiles;
+  // direct includes of every file compiled or included so far
+  std::unordered_map<std::string, std::unordered_set<std::string>>
+      includeGraph;
 };
 
 struct ShaderCompiler {
-  void init();
+  // the archive is only opened when allowCompile is false
+  void init(const fs::path &cacheDirectory, const fs::path &archivePath);
 
   void shutdown();
 
+  // spirv straight from the mapped archive in shipping builds, otherwise
+  // compiled into compiled. the archive can be older than the sources, the
+  // cache in compileGLSL can't
+  std::span<const uint32_t> getSpirv(const fs::path &path,
+                                     std::vector<uint32_t> &compiled);
+
   std::vector<uint32_t> compileSlang(const fs::path &path);
 
+  // spirv is cached in cacheDirectory under a hash of the preprocessed
+  // source, so editing an included file invalidates every shader using it
   std::vector<uint32_t> compileGLSL(const fs::path &path);
 
+  fs::path getCachePath(const fs::path &path, shaderc_shader_kind shaderKind,
+                        const std::string &preprocessedCode) const;
+
+  // files path includes, directly or through other includes. paths are
+  // normalized with normalizeShaderPath
+  std::vector<std::string> getIncludes(const fs::path &path);
+
   void diagnose(slang::IBlob *diagnosticsBlob);
 
   Slang::ComPtr<slang::IGlobalSession> globalSession;
   shaderc::Compiler shadercCompiler;
   shaderc::CompileOptions shadercOptions;
+  // owned by shadercOptions
+  ShaderIncluder *includer = nullptr;
+
+  ShaderArchive archive;
+  // shipping builds only load from the archive and never run shaderc or slang
+  bool allowCompile = true;
+
+  fs::path cacheDirectory;
+  // describes everything set on shadercOptions, the spirv version and the
+  // shaderc build, hashed into every cache key
+  std::string optionsKey;
 };
 } // namespace Flare
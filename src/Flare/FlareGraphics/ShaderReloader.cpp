@@ -0,0 +1,322 @@
+#include "ShaderReloader.h"
+#include "GpuDevice.h"
+
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include <chrono>
+#include <span>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Flare {
+// editors write a file in several steps, changes are collected until the
+// files have been quiet for this long
+static constexpr int SHADER_RELOAD_DEBOUNCE_MS = 50;
+static constexpr int SHADER_RELOAD_POLL_MS = 250;
+
+void ShaderReloader::init(GpuDevice *gpuDevice) {
+  gpu = gpuDevice;
+  if (!enabled) {
+    return;
+  }
+
+#ifdef __linux__
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd < 0) {
+    spdlog::error("ShaderReloader: Failed to initialize inotify");
+    enabled = false;
+    return;
+  }
+#endif
+
+  stopping = false;
+  thread = std::thread(&ShaderReloader::run, this);
+}
+
+void ShaderReloader::shutdown() {
+  stopping = true;
+  if (thread.joinable()) {
+    thread.join();
+  }
+
+#ifdef __linux__
+  if (inotifyFd >= 0) {
+    close(inotifyFd);
+    inotifyFd = -1;
+  }
+#endif
+
+  for (auto &reloaded : reloadedPipelines) {
+    destroyReloaded(reloaded);
+  }
+  reloadedPipelines.clear();
+  watchedPipelines.clear();
+}
+
+void ShaderReloader::watch(Handle<Pipeline> handle, const PipelineCI &ci) {
+  if (!enabled || !handle.isValid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  watchedPipelines[handle.index] = {
+      .ci = ci,
+      .generation = nextGeneration++,
+  };
+  for (const auto &shaderStage : ci.shaderStages) {
+    newShaders.push_back(normalizeShaderPath(shaderStage.path));
+  }
+}
+
+void ShaderReloader::unwatch(Handle<Pipeline> handle) {
+  if (!enabled) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  watchedPipelines.erase(handle.index);
+}
+
+void ShaderReloader::update() {
+  if (!enabled) {
+    return;
+  }
+
+  std::vector<ReloadedPipeline> reloaded;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    reloaded.swap(reloadedPipelines);
+  }
+
+  for (auto &entry : reloaded) {
+    bool current = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = watchedPipelines.find(entry.handle.index);
+      current = it != watchedPipelines.end() &&
+                it->second.generation == entry.generation;
+    }
+
+    // the pipeline was destroyed or recreated while rebuilding
+    if (!current) {
+      destroyReloaded(entry);
+      continue;
+    }
+
+    // frames in flight keep using the old pipeline through a handle of its
+    // own until it's destroyed
+    Handle<Pipeline> oldHandle = gpu->pipelines.obtain();
+    if (!oldHandle.isValid()) {
+      destroyReloaded(entry);
+      continue;
+    }
+
+    Pipeline *pipeline = gpu->getPipeline(entry.handle);
+    *gpu->getPipeline(oldHandle) = *pipeline;
+    *pipeline = entry.pipeline;
+    gpu->destroyPipelineDeferred(oldHandle);
+  }
+}
+
+void ShaderReloader::run() {
+  while (!stopping) {
+    scanNewShaders();
+
+    std::unordered_set<std::string> changedFiles = waitForChanges();
+    if (!changedFiles.empty()) {
+      rebuild(changedFiles);
+    }
+  }
+}
+
+void ShaderReloader::scanNewShaders() {
+  std::vector<std::string> shaders;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    shaders.swap(newShaders);
+  }
+
+  for (const auto &shader : shaders) {
+    if (watchedFiles.contains(shader)) {
+      continue;
+    }
+
+    watchFile(shader);
+    for (const auto &include : gpu->shaderCompiler.getIncludes(shader)) {
+      watchFile(include);
+    }
+  }
+}
+
+void ShaderReloader::watchFile(const std::string &file) {
+  if (!watchedFiles.insert(file).second) {
+    return;
+  }
+
+#ifdef __linux__
+  // directories are watched since editors often save by replacing the file
+  std::string directory = std::filesystem::path(file).parent_path().string();
+  if (directory.empty()) {
+    directory = ".";
+  }
+
+  int wd = inotify_add_watch(inotifyFd, directory.c_str(),
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (wd < 0) {
+    spdlog::error("ShaderReloader: Failed to watch {}", directory);
+    return;
+  }
+  watchedDirectories[wd] = directory;
+#else
+  std::error_code ec;
+  writeTimes[file] = std::filesystem::last_write_time(file, ec);
+#endif
+}
+
+std::unordered_set<std::string> ShaderReloader::waitForChanges() {
+  std::unordered_set<std::string> changedFiles;
+
+#ifdef __linux__
+  pollfd pfd = {
+      .fd = inotifyFd,
+      .events = POLLIN,
+      .revents = 0,
+  };
+
+  int timeout = SHADER_RELOAD_POLL_MS;
+  while (poll(&pfd, 1, timeout) > 0) {
+    alignas(inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+      for (char *ptr = buffer; ptr < buffer + size;) {
+        auto *event = reinterpret_cast<inotify_event *>(ptr);
+        ptr += sizeof(inotify_event) + event->len;
+
+        auto it = watchedDirectories.find(event->wd);
+        if (event->len == 0 || it == watchedDirectories.end()) {
+          continue;
+        }
+
+        std::string file = normalizeShaderPath(
+            std::filesystem::path(it->second) / event->name);
+        if (watchedFiles.contains(file)) {
+          changedFiles.insert(file);
+        }
+      }
+    }
+
+    if (changedFiles.empty() || stopping) {
+      break;
+    }
+    timeout = SHADER_RELOAD_DEBOUNCE_MS;
+  }
+#else
+  std::this_thread::sleep_for(
+      std::chrono::milliseconds(SHADER_RELOAD_POLL_MS));
+
+  for (auto &[file, writeTime] : writeTimes) {
+    std::error_code ec;
+    auto currentWriteTime = std::filesystem::last_write_time(file, ec);
+    if (!ec && currentWriteTime != writeTime) {
+      writeTime = currentWriteTime;
+      changedFiles.insert(file);
+    }
+  }
+
+  if (!changedFiles.empty()) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(SHADER_RELOAD_DEBOUNCE_MS));
+  }
+#endif
+
+  return changedFiles;
+}
+
+void ShaderReloader::rebuild(
+    const std::unordered_set<std::string> &changedFiles) {
+  ZoneScoped;
+
+  std::vector<std::pair<Handle<Pipeline>, WatchedPipeline>> pipelines;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &[index, watched] : watchedPipelines) {
+      pipelines.push_back({Handle<Pipeline>{.index = index}, watched});
+    }
+  }
+
+  // stages are compiled once even if several pipelines share them
+  std::unordered_map<std::string, std::vector<uint32_t>> spirvs;
+  std::unordered_map<std::string, bool> stageChanged;
+
+  for (auto &[handle, watched] : pipelines) {
+    bool changed = false;
+    for (const auto &shaderStage : watched.ci.shaderStages) {
+      std::string stage = normalizeShaderPath(shaderStage.path);
+
+      auto it = stageChanged.find(stage);
+      if (it == stageChanged.end()) {
+        bool affected = changedFiles.contains(stage);
+        for (const auto &include : gpu->shaderCompiler.getIncludes(stage)) {
+          affected |= changedFiles.contains(include);
+        }
+        it = stageChanged.emplace(stage, affected).first;
+      }
+      changed |= it->second;
+    }
+    if (!changed) {
+      continue;
+    }
+
+    std::vector<std::span<const uint32_t>> stageSpirvs;
+    bool compiled = true;
+    for (const auto &shaderStage : watched.ci.shaderStages) {
+      std::string stage = normalizeShaderPath(shaderStage.path);
+      if (!spirvs.contains(stage)) {
+        std::vector<uint32_t> &spirv = spirvs[stage];
+        gpu->shaderCompiler.getSpirv(shaderStage.path, spirv);
+
+        // a changed shader may include new files
+        for (const auto &include : gpu->shaderCompiler.getIncludes(stage)) {
+          watchFile(include);
+        }
+      }
+      if (spirvs[stage].empty()) {
+        compiled = false;
+      }
+      stageSpirvs.push_back(spirvs[stage]);
+    }
+
+    if (!compiled) {
+      spdlog::error("ShaderReloader: Keeping the old pipeline for {}",
+                    watched.ci.shaderStages[0].path.string());
+      continue;
+    }
+
+    ReloadedPipeline reloaded = {
+        .handle = handle,
+        .generation = watched.generation,
+    };
+    if (!gpu->buildPipeline(&reloaded.pipeline, watched.ci, stageSpirvs)) {
+      spdlog::error("ShaderReloader: Keeping the old pipeline for {}",
+                    watched.ci.shaderStages[0].path.string());
+      continue;
+    }
+
+    spdlog::info("ShaderReloader: Reloaded pipeline for {}",
+                 watched.ci.shaderStages[0].path.string());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    reloadedPipelines.push_back(reloaded);
+  }
+}
+
+void ShaderReloader::destroyReloaded(ReloadedPipeline &reloaded) {
+  // the layout is shared with every other pipeline
+  vkDestroyPipeline(gpu->device, reloaded.pipeline.pipeline, nullptr);
+}
+} // namespace Flare
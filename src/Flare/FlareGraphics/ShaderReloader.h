@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "GpuResources.h"
+
+namespace Flare {
+struct GpuDevice;
+
+struct WatchedPipeline {
+  PipelineCI ci;
+  // rebuilds started before the handle was watched again are dropped
+  uint64_t generation = 0;
+};
+
+struct ReloadedPipeline {
+  Handle<Pipeline> handle;
+  uint64_t generation = 0;
+  Pipeline pipeline;
+};
+
+// watches the shaders of every pipeline and the files they include. pipelines
+// whose shaders changed are rebuilt on a background thread and swapped in by
+// update at the start of a frame
+struct ShaderReloader {
+  void init(GpuDevice *gpuDevice);
+
+  void shutdown();
+
+  // called by GpuDevice for every pipeline it creates and destroys
+  void watch(Handle<Pipeline> handle, const PipelineCI &ci);
+
+  void unwatch(Handle<Pipeline> handle);
+
+  // swaps in the pipelines rebuilt since the last call, the replaced ones are
+  // destroyed once the frames using them complete
+  void update();
+
+  void run();
+
+  // records the includes of shaders watched since the last call and watches
+  // their directories
+  void scanNewShaders();
+
+  void watchFile(const std::string &file);
+
+  // blocks for a short while, returns the files written in the meantime
+  std::unordered_set<std::string> waitForChanges();
+
+  void rebuild(const std::unordered_set<std::string> &changedFiles);
+
+  void destroyReloaded(ReloadedPipeline &reloaded);
+
+  GpuDevice *gpu = nullptr;
+  bool enabled = false;
+
+  std::thread thread;
+  std::atomic_bool stopping = false;
+
+  std::mutex mutex;
+  // by pipeline handle index
+  std::unordered_map<uint32_t, WatchedPipeline> watchedPipelines;
+  std::vector<std::string> newShaders;
+  std::vector<ReloadedPipeline> reloadedPipelines;
+  uint64_t nextGeneration = 0;
+
+  // only touched by the reload thread
+  std::unordered_set<std::string> watchedFiles;
+#ifdef __linux__
+  int inotifyFd = -1;
+  std::unordered_map<int, std::string> watchedDirectories;
+#else
+  std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+#endif
+};
+} // namespace Flare
@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace Flare {
+// the pool is kept too, workers of another pool aren't counted as ours
+static thread_local const ThreadPool *currentPool = nullptr;
+static thread_local uint32_t currentThreadIndex = 0;
+
+void ThreadPool::init(uint32_t threadCount) {
+  if (threadCount == 0) {
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+  }
+
+  stopping = false;
+  workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back([this, i] {
+      currentPool = this;
+      currentThreadIndex = i + 1;
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(taskMutex);
+          taskCondition.wait(lock,
+                             [this] { return stopping || !tasks.empty(); });
+          if (stopping && tasks.empty()) {
+            return;
+          }
+          task = std::move(tasks.front());
+          tasks.pop();
+        }
+        task();
+      }
+    });
+  }
+}
+
+void ThreadPool::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(taskMutex);
+    stopping = true;
+  }
+  taskCondition.notify_all();
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+}
+
+uint32_t ThreadPool::threadIndex() const {
+  return currentPool == this ? currentThreadIndex : 0;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(taskMutex);
+    tasks.push(std::move(task));
+  }
+  taskCondition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t)> &func) {
+  if (count == 0) {
+    return;
+  }
+
+  // shared so helpers that start after the last index finished can still
+  // safely find nothing left to do
+  struct Batch {
+    std::atomic_size_t next = 0;
+    std::atomic_size_t done = 0;
+    size_t count = 0;
+    const std::function<void(size_t)> *func = nullptr;
+    std::mutex mutex;
+    std::condition_variable condition;
+  };
+
+  auto batch = std::make_shared<Batch>();
+  batch->count = count;
+  batch->func = &func;
+
+  auto work = [batch] {
+    for (size_t i = batch->next++; i < batch->count; i = batch->next++) {
+      (*batch->func)(i);
+      if (++batch->done == batch->count) {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        batch->condition.notify_all();
+      }
+    }
+  };
+
+  size_t helperCount = std::min(count - 1, workers.size());
+  for (size_t i = 0; i < helperCount; i++) {
+    enqueue(work);
+  }
+
+  // the caller works too, so nested calls from a worker can't deadlock
+  work();
+
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  batch->condition.wait(lock, [&] { return batch->done == batch->count; });
+}
+} // namespace Flare
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Flare {
+struct ThreadPool {
+  // threadCount 0 uses one worker per hardware thread minus the caller
+  void init(uint32_t threadCount = 0);
+
+  void shutdown();
+
+  void enqueue(std::function<void()> task);
+
+  // runs func(0..count-1) on the workers and the calling thread, returns once
+  // every index has finished
+  void parallelFor(size_t count, const std::function<void(size_t)> &func);
+
+  uint32_t workerCount() const {
+    return static_cast<uint32_t>(workers.size());
+  }
+
+  // 1 + worker index on a worker of this pool, 0 on any other thread
+  uint32_t threadIndex() const;
+
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex taskMutex;
+  std::condition_variable taskCondition;
+  bool stopping = false;
+};
+} // namespace Flare
@@ -0,0 +1,82 @@
+#include "VertexQuantization.h"
+#include "GltfScene.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <tracy/Tracy.hpp>
+
+namespace Flare {
+// same as octahedralEncode in NormalEncoding.glsl
+static glm::vec2 octahedralEncode(glm::vec3 n) {
+  float length = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+  if (length == 0.f) {
+    return glm::vec2(0.f);
+  }
+  n /= length;
+
+  if (n.z > 0.f) {
+    return glm::vec2(n);
+  }
+  glm::vec2 signNotZero(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+  return (1.f - glm::abs(glm::vec2(n.y, n.x))) * signNotZero;
+}
+
+void appendQuantizedVertices(const GltfScene &scene, QuantizedVertices &out) {
+  ZoneScoped;
+
+  size_t firstVertex = out.positions.size();
+  size_t vertexCount = scene.positions.size();
+  out.positions.resize(firstVertex + vertexCount, glm::uvec2(0));
+  out.normals.resize(firstVertex + vertexCount, 0);
+  out.tangents.resize(firstVertex + vertexCount, 0);
+  out.uvs.resize(firstVertex + vertexCount, 0);
+
+  // draws of the same primitive share its vertices and bounds, a primitive's
+  // vertices end where the next one's start
+  std::vector<const MeshDraw *> draws;
+  draws.reserve(scene.meshDraws.size());
+  for (const auto &meshDraw : scene.meshDraws) {
+    draws.push_back(&meshDraw);
+  }
+  std::sort(draws.begin(), draws.end(),
+            [](const MeshDraw *a, const MeshDraw *b) {
+              return a->vertexOffset < b->vertexOffset;
+            });
+
+  for (size_t i = 0; i < draws.size();) {
+    size_t first = draws[i]->vertexOffset;
+    const Bounds &bounds = draws[i]->bounds;
+
+    size_t next = i + 1;
+    while (next < draws.size() && draws[next]->vertexOffset == first) {
+      next++;
+    }
+    size_t last = std::min(
+        next < draws.size() ? draws[next]->vertexOffset : vertexCount,
+        vertexCount);
+
+    // flat meshes have a zero extent, their positions all quantize to 0
+    glm::vec3 invScale =
+        1.f / glm::max(glm::abs(bounds.extents), glm::vec3(FLT_MIN));
+
+    for (size_t v = first; v < last; v++) {
+      glm::vec3 position =
+          (glm::vec3(scene.positions[v]) - bounds.origin) * invScale;
+      float tangentSign = scene.tangents[v].w < 0.f ? -1.f : 1.f;
+
+      size_t index = firstVertex + v;
+      out.positions[index] = {
+          glm::packSnorm2x16(glm::vec2(position.x, position.y)),
+          glm::packSnorm2x16(glm::vec2(position.z, tangentSign)),
+      };
+      out.normals[index] = glm::packSnorm2x16(
+          octahedralEncode(glm::vec3(scene.normals[v])));
+      out.tangents[index] = glm::packSnorm2x16(
+          octahedralEncode(glm::vec3(scene.tangents[v])));
+      out.uvs[index] = glm::packHalf2x16(scene.uvs[v]);
+    }
+
+    i = next;
+  }
+}
+} // namespace Flare
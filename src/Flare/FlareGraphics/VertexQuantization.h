@@ -0,0 +1,23 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Flare {
+struct GltfScene;
+
+// compressed vertex streams, 20 bytes per vertex instead of 56. positions are
+// snorm16 relative to the bounds of their draw with the tangent sign in w,
+// normals and tangents are octahedral snorm16 and uvs are half floats.
+// decoded in GBuffer.vert and ShadowPass.vert
+struct QuantizedVertices {
+  std::vector<glm::uvec2> positions;
+  std::vector<uint32_t> normals;
+  std::vector<uint32_t> tangents;
+  std::vector<uint32_t> uvs;
+};
+
+// appends every vertex of the scene, vertices are quantized with the bounds of
+// the mesh draws using them
+void appendQuantizedVertices(const GltfScene &scene, QuantizedVertices &out);
+} // namespace Flare